@@ -16,6 +16,7 @@
 
 #include <gflags/gflags.h>
 #include <sstream>
+#include "bench_utils.h"
 #include "log.h"
 #include "test_utils.h"
 
@@ -27,6 +28,9 @@ DEFINE_int32(w, 100, "Width of images, 'w' in 'nchw'");
 DEFINE_string(c, "", "Input channels, for example, -c=64,64,32");
 DEFINE_string(dtype, "s8", "Data type");
 DEFINE_bool(post_relu, true, "Post ReLU after Concat");
+DEFINE_int32(streaming_store, -1,
+             "Non-temporal store of dst: -1 auto by dst size, 0 off, 1 on, "
+             "2 run both off and on");
 
 static mkldnn::engine eng = mkldnn::engine(mkldnn::engine::cpu, 0);
 
@@ -39,7 +43,10 @@ struct bench_params {
 void bench_mkldnn_concat(const std::vector<mkldnn::memory::dims>& srcs_dims,
                          const mkldnn::memory::dims& dst_dims,
                          mkldnn::memory::data_type dt,
-                         bool post_relu) {
+                         bool post_relu,
+                         const std::string& shape,
+                         size_t src_bytes,
+                         size_t dst_bytes) {
   using namespace mkldnn;
 
   std::unique_ptr<primitive> fwd_concat, fwd_relu;
@@ -83,49 +90,44 @@ void bench_mkldnn_concat(const std::vector<mkldnn::memory::dims>& srcs_dims,
     pp_relu.push_back(*fwd_relu);
   }
 
-  for (auto i = 0; i < FLAGS_burning_iter; ++i) {
-    deepfusion::testutils::clear_cache();
-    stream(stream::kind::eager).submit(pp_concat).wait();
-    if (post_relu) {
-      stream(stream::kind::eager).submit(pp_relu).wait();
-    }
-    deepfusion::testutils::clear_cache();
-  }
-
-  // cal time
-  double sum_concat = 0;
-  double sum_relu = 0;
-  for (auto i = 0; i < FLAGS_iter; ++i) {
-    deepfusion::testutils::clear_cache();
-    auto s1 = deepfusion::utils::get_current_ms();
-    stream(stream::kind::eager).submit(pp_concat).wait();
-    auto s2 = deepfusion::utils::get_current_ms();
-    sum_concat += (s2 - s1);
-    if (post_relu) {
-      stream(stream::kind::eager).submit(pp_relu).wait();
-      auto s3 = deepfusion::utils::get_current_ms();
-      sum_relu += (s3 - s2);
-    }
-    deepfusion::testutils::clear_cache();
+  using namespace deepfusion::benchutils;
+  auto r = run_bench(
+      [&]() { stream(stream::kind::eager).submit(pp_concat).wait(); },
+      FLAGS_burning_iter,
+      FLAGS_iter);
+  auto avg_concat = r.avg_ms;
+  size_t bytes = src_bytes + dst_bytes;
+  if (post_relu) {
+    auto r_relu = run_bench(
+        [&]() { stream(stream::kind::eager).submit(pp_relu).wait(); },
+        FLAGS_burning_iter,
+        FLAGS_iter);
+    r += r_relu;
+    bytes += 2 * dst_bytes;
   }
 
-  auto avg_concat = sum_concat / (double)FLAGS_iter;
-  auto avg_relu = sum_relu / (double)FLAGS_iter;
-  std::ostringstream oss;
-  oss << "MKL-DNN Concat" << (post_relu ? " + ReLU" : "") << " avg time ("
-      << avg_concat;
+  std::ostringstream note;
   if (post_relu) {
-    oss << " + " << avg_relu;
+    note << " (" << avg_concat << " + " << r.avg_ms - avg_concat << ")";
   }
-  oss << ") " << avg_concat + avg_relu << " ms";
-  info("%s", oss.str().c_str());
+  report(post_relu ? "MKL-DNN Concat + ReLU" : "MKL-DNN Concat",
+         shape,
+         deepfusion::testutils::from_mkldnn_dtype(dt),
+         r,
+         bytes,
+         0,
+         note.str());
 }
 
 void bench_deepfusion_concat(
     const std::vector<deepfusion::memory::nchw_dims>& srcs_dims,
     const deepfusion::memory::nchw_dims& dst_dims,
     deepfusion::memory::dtype dt,
-    bool post_relu) {
+    bool post_relu,
+    int streaming_store,
+    const std::string& shape,
+    size_t src_bytes,
+    size_t dst_bytes) {
   using namespace deepfusion;
 
   std::vector<std::unique_ptr<memory>> srcs(srcs_dims.size());
@@ -136,33 +138,33 @@ void bench_deepfusion_concat(
   }
   dst.reset(new memory(dst_dims, fmt, dt));
 
-  auto c = concat(srcs, dst, post_relu);
-
-  for (auto i = 0; i < FLAGS_burning_iter; ++i) {
-    testutils::clear_cache();
-    c->submit();
-    testutils::clear_cache();
+  std::vector<int> store_modes = {streaming_store};
+  if (streaming_store == 2) {
+    store_modes = {0, 1};
   }
+  for (int mode : store_modes) {
+    // the store mode is decided when creating the op
+    if (mode >= 0) {
+      utils::set_streaming_store_mode(mode);
+    }
+    auto c = concat(srcs, dst, post_relu);
 
-  double sum_concat = 0;
-  for (auto i = 0; i < FLAGS_iter; ++i) {
-    testutils::clear_cache();
-    auto s1 = utils::get_current_ms();
-    c->submit();
-    auto s2 = utils::get_current_ms();
-    sum_concat += (s2 - s1);
-    testutils::clear_cache();
-  }
+    auto r = benchutils::run_bench(
+        [&]() { c->submit(); }, FLAGS_burning_iter, FLAGS_iter);
 
-  std::ostringstream oss;
-  oss << "DeepFusion Concat" << (post_relu ? "_ReLU" : "")
-      << " avg time: " << sum_concat / (double)FLAGS_iter << " ms";
-  info("%s", oss.str().c_str());
+    std::string name =
+        post_relu ? "DeepFusion Concat_ReLU" : "DeepFusion Concat";
+    if (mode >= 0) {
+      name += mode == 1 ? " (streaming store)" : " (regular store)";
+    }
+    benchutils::report(name, shape, dt, r, src_bytes + dst_bytes);
+  }
 }
 
 void bench_both(const bench_params& p,
                 deepfusion::memory::dtype dt,
-                bool post_relu) {
+                bool post_relu,
+                int streaming_store) {
   auto srcs_dims = p.srcs_dims;
   deepfusion::memory::nchw_dims dst_dims;  // given as nchw
   std::vector<mkldnn::memory::dims> mkldnn_srcs_dims(srcs_dims.size());
@@ -176,6 +178,7 @@ void bench_both(const bench_params& p,
   oss << "Benchmark with data type " << deepfusion::testutils::dtype2str(dt)
       << (post_relu ? ", with ReLU" : " without ReLU");
   oss << "\nData sizes: In";
+  std::ostringstream shape;  // srcs in nchw, like 4x16x9x9+4x64x9x9
   for (size_t i = 0; i < srcs_dims.size(); i++) {
     const auto& dims = srcs_dims[i];
     check_eq(dims.size(), 4);
@@ -189,20 +192,37 @@ void bench_both(const bench_params& p,
     oss << "(" << dims[0] << ", " << dims[1] << ", " << dims[2] << ", "
         << dims[3] << ")@NCHW, ";
     mkldnn_srcs_dims[i] = deepfusion::testutils::to_mkldnn_dims(dims);
+    shape << (i > 0 ? "+" : "") << dims[0] << "x" << dims[1] << "x" << dims[2]
+          << "x" << dims[3];
   }
   oss << "==> Out(" << dst_dims[0] << ", " << dst_dims[1] << ", " << dst_dims[2]
       << ", " << dst_dims[3] << ")@NCHW";
   info("%s", oss.str().c_str());
   mkldnn_dst_dims = deepfusion::testutils::to_mkldnn_dims(dst_dims);
+  // every src is read and dst is written once
+  size_t dst_bytes = deepfusion::utils::array_product<int>(dst_dims.data(), 4) *
+                     deepfusion::utils::dtype_size(dt);
+  size_t src_bytes = dst_bytes;
   bench_mkldnn_concat(mkldnn_srcs_dims,
                       mkldnn_dst_dims,
                       deepfusion::testutils::to_mkldnn_dtype(dt),
-                      post_relu);
-  bench_deepfusion_concat(srcs_dims, dst_dims, dt, post_relu);
+                      post_relu,
+                      shape.str(),
+                      src_bytes,
+                      dst_bytes);
+  bench_deepfusion_concat(srcs_dims,
+                          dst_dims,
+                          dt,
+                          post_relu,
+                          streaming_store,
+                          shape.str(),
+                          src_bytes,
+                          dst_bytes);
 }
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
+  deepfusion::benchutils::init();
   // only run if given some input channels
   // for example:
   // bench_concat -n 3 -c 16,16,64 -h 4 -w 6 -dtype s8 -post_relu
@@ -218,8 +238,11 @@ int main(int argc, char** argv) {
       dims[2] = FLAGS_h;
       dims[3] = FLAGS_w;
     }
-    bench_both(test_case, deepfusion::testutils::str2dtype(FLAGS_dtype), FLAGS_post_relu);
-    return 0;
+    bench_both(test_case,
+               deepfusion::testutils::str2dtype(FLAGS_dtype),
+               FLAGS_post_relu,
+               FLAGS_streaming_store);
+    return deepfusion::benchutils::finish();
   }
 
   // nothing input, then run some default cases
@@ -228,6 +251,10 @@ int main(int argc, char** argv) {
       {{{4, 64, 64, 64}, {4, 96, 64, 64}}},        // 32x
       {{{4, 16, 9, 9}, {4, 64, 9, 9}}}             // 16x
   };
+  // dst far larger than LLC, compare regular and streaming store
+  bench_params large_cases[] = {
+      {{{32, 32, 300, 300}, {32, 32, 300, 300}}}
+  };
   deepfusion::memory::dtype dtypes[] = {deepfusion::memory::dtype::s8,
                                         deepfusion::memory::dtype::s32,
                                         deepfusion::memory::dtype::f32};
@@ -236,10 +263,15 @@ int main(int argc, char** argv) {
   for (size_t i = 0; i < param_sz; ++i) {
     for (auto post_relu : {true, false}) {
       for (size_t j = 0; j < dt_sz; ++j) {
-        bench_both(default_cases[i], dtypes[j], post_relu);
+        bench_both(default_cases[i], dtypes[j], post_relu, FLAGS_streaming_store);
       }
     }
   }
+  for (size_t i = 0; i < sizeof(large_cases) / sizeof(bench_params); ++i) {
+    for (size_t j = 0; j < dt_sz; ++j) {
+      bench_both(large_cases[i], dtypes[j], FLAGS_post_relu, 2);
+    }
+  }
 
-  return 0;
+  return deepfusion::benchutils::finish();
 }
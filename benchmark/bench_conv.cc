@@ -15,7 +15,10 @@
 *******************************************************************************/
 
 #include <gflags/gflags.h>
+#include <algorithm>
+#include <cmath>
 #include <sstream>
+#include "bench_utils.h"
 #include "log.h"
 #include "test_utils.h"
 
@@ -35,10 +38,149 @@ DEFINE_int32(oc, 0, "Output channels of first conv");
 DEFINE_int32(oc1x1, 0, "Output channels of 1x1 conv");
 DEFINE_string(dtype, "s8", "Data type");
 DEFINE_bool(post_relu, true, "Post ReLU after Conv");
+DEFINE_bool(f32, false, "F32 conv, with f32 src, weights and dst");
+DEFINE_bool(winograd, false, "Also run int8 winograd conv of 3x3 stride 1");
 
-static mkldnn::engine eng = mkldnn::engine(mkldnn::engine::cpu, 0);
+using bench_params = deepfusion::benchutils::conv_params;
+
+void bench_mkldnn_conv(const bench_params& p,
+                       deepfusion::memory::dtype dt,
+                       bool post_relu) {
+  using namespace deepfusion;
+  auto w = benchutils::make_mkldnn_conv(p, dt, post_relu, FLAGS_f32);
+  auto r = benchutils::run_bench(
+      [&]() { w->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+  std::string name = "MKL-DNN Conv";
+  name += FLAGS_f32 ? " F32" : "";
+  name += post_relu ? " + ReLU" : "";
+  name += p.oc1x1 > 0 ? " + Conv1x1" : "";
+  benchutils::report(name,
+                     p.shape(),
+                     dt,
+                     r,
+                     p.bytes(dt, FLAGS_f32),
+                     p.ops(),
+                     "",
+                     0,
+                     FLAGS_f32);
+}
+
+void bench_deepfusion_conv(const bench_params& p,
+                           deepfusion::memory::dtype dt,
+                           bool post_relu) {
+  using namespace deepfusion;
+  auto w = benchutils::make_conv(p, dt, post_relu, FLAGS_f32);
+  auto r = benchutils::run_bench(
+      [&]() { w->func->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+  benchutils::report(
+      w->name, w->shape, dt, r, w->bytes, w->ops, "", 0, w->f32_ops);
+}
+
+// winograd conv, with the max diff of its dst from direct conv on the same
+// memories
+void bench_deepfusion_winograd(const bench_params& p,
+                               deepfusion::memory::dtype dt,
+                               bool post_relu) {
+  using namespace deepfusion;
+  using dtype = memory::dtype;
+  auto w = benchutils::make_conv(
+      p, dt, post_relu, false, conv_algorithm::winograd);
+  const auto& m = w->mems;  // src, wei, bia and dst
+  std::unique_ptr<memory> dst(
+      new memory(m[3]->std_dims(), memory::format::nhwc, dt));
+  auto direct = conv(
+      m[0], m[1], m[2], {{p.sh, p.sw}}, {{p.ph, p.pw}}, dst, post_relu);
+  w->func->submit();
+  direct->submit();
+  auto value = [](const std::unique_ptr<memory>& mem, size_t i) -> double {
+    switch (mem->data_type()) {
+      case dtype::f32: return ((const f32*)mem->data())[i];
+      case dtype::s32: return ((const s32*)mem->data())[i];
+      case dtype::s8: return ((const s8*)mem->data())[i];
+      case dtype::u8: return ((const u8*)mem->data())[i];
+      default: return 0;
+    }
+  };
+  double max_diff = 0;
+  for (size_t i = 0; i < dst->size(); ++i) {
+    max_diff = std::max(max_diff, std::abs(value(m[3], i) - value(dst, i)));
+  }
+
+  auto r = benchutils::run_bench(
+      [&]() { w->func->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+  std::ostringstream note;
+  note << "max diff " << max_diff << " from direct";
+  benchutils::report(
+      w->name, w->shape, dt, r, w->bytes, w->ops, note.str());
+}
+
+void bench_all(const bench_params& p,
+               deepfusion::memory::dtype dt,
+               bool post_relu) {
+  std::ostringstream oss;
+  info("==========================================");
+  oss << "Benchmark with data type " << deepfusion::testutils::dtype2str(dt)
+      << (post_relu ? ", with ReLU" : " without ReLU");
+  oss << "\nData sizes: In(" << p.src_dims[0] << ", " << p.src_dims[1] << ", "
+      << p.src_dims[2] << ", " << p.src_dims[3] << ")@NCHW, Conv " << p.oc
+      << "x" << p.kh << "x" << p.kw << " stride " << p.sh << "x" << p.sw
+      << " padding " << p.ph << "x" << p.pw;
+  if (p.oc1x1 > 0) {
+    oss << ", Conv1x1 " << p.oc1x1;
+  }
+  info("%s", oss.str().c_str());
+  bench_mkldnn_conv(p, dt, post_relu);
+  bench_deepfusion_conv(p, dt, post_relu);
+  const bool is_3x3s1 = p.kh == 3 && p.kw == 3 && p.sh == 1 && p.sw == 1;
+  if (FLAGS_winograd && !FLAGS_f32 && p.oc1x1 == 0 && is_3x3s1) {
+    bench_deepfusion_winograd(p, dt, post_relu);
+  }
+}
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
-  return 0;
+  deepfusion::benchutils::init();
+  // only run if given the shape
+  // for example:
+  // bench_conv -bs 1 -ic 64 -ih 56 -iw 56 -oc 64 -kh 3 -kw 3 -sh 1 -sw 1
+  //            -ph 1 -pw 1 -oc1x1 0 -dtype s8 -post_relu
+  if (FLAGS_bs > 0) {
+    bench_params test_case = {{{FLAGS_bs, FLAGS_ic, FLAGS_ih, FLAGS_iw}},
+                              FLAGS_oc,
+                              FLAGS_kh,
+                              FLAGS_kw,
+                              FLAGS_sh,
+                              FLAGS_sw,
+                              FLAGS_ph,
+                              FLAGS_pw,
+                              FLAGS_oc1x1};
+    bench_all(test_case,
+              FLAGS_f32 ? deepfusion::memory::dtype::f32
+                        : deepfusion::testutils::str2dtype(FLAGS_dtype),
+              FLAGS_post_relu);
+    return deepfusion::benchutils::finish();
+  }
+
+  // nothing input, then run some default cases
+  bench_params default_cases[] = {
+      {{{1, 64, 56, 56}}, 64, 3, 3, 1, 1, 1, 1, 0},
+      {{{1, 128, 28, 28}}, 128, 3, 3, 1, 1, 1, 1, 0},
+      {{{1, 256, 14, 14}}, 256, 3, 3, 1, 1, 1, 1, 0},
+      {{{4, 32, 150, 150}}, 32, 3, 3, 1, 1, 1, 1, 0},
+      {{{1, 64, 56, 56}}, 128, 3, 3, 2, 2, 1, 1, 0},
+      {{{1, 16, 224, 224}}, 64, 7, 7, 2, 2, 3, 3, 0},
+      {{{1, 64, 56, 56}}, 64, 3, 3, 1, 1, 1, 1, 256}};
+  deepfusion::memory::dtype dtypes[] = {deepfusion::memory::dtype::u8,
+                                        deepfusion::memory::dtype::s32,
+                                        deepfusion::memory::dtype::f32};
+  for (const auto& p : default_cases) {
+    for (auto dt : dtypes) {
+      if (FLAGS_f32 && dt != deepfusion::memory::dtype::f32) {
+        continue;
+      }
+      bench_all(p, dt, FLAGS_post_relu);
+    }
+  }
+
+  return deepfusion::benchutils::finish();
 }
@@ -0,0 +1,105 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include <gflags/gflags.h>
+#include <sstream>
+#include "bench_utils.h"
+#include "log.h"
+#include "test_utils.h"
+
+DEFINE_int32(burning_iter, 50, "Burning iterations");
+DEFINE_int32(iter, 100, "Iterations for average");
+DEFINE_int32(bs, 0, "Batch size, number of images");
+DEFINE_int32(ic, 0, "Input channels");
+DEFINE_int32(ih, 1, "Input image height");
+DEFINE_int32(iw, 1, "Input image width");
+DEFINE_int32(oc, 0, "Output channels");
+DEFINE_string(dtype, "s8", "Data type of dst");
+DEFINE_bool(post_relu, false, "Post ReLU after InnerProduct");
+
+struct bench_params {
+  deepfusion::memory::nchw_dims src_dims;
+  int oc;
+};
+
+void bench_deepfusion_inner_product(const bench_params& p,
+                                    deepfusion::memory::dtype dt,
+                                    bool post_relu) {
+  using namespace deepfusion;
+  using format = memory::format;
+  const int bs = p.src_dims[0], ic = p.src_dims[1];
+  const int ih = p.src_dims[2], iw = p.src_dims[3];
+  memory::nchw_dims wei_dims = {{p.oc, ic, ih, iw}};
+  memory::nchw_dims dst_dims = {{bs, p.oc, 1, 1}};
+  std::unique_ptr<memory> src, wei, bia, dst;
+  src.reset(new memory(p.src_dims, format::nhwc, memory::dtype::u8));
+  wei.reset(new memory(wei_dims, format::OIhw4i16o4i, memory::dtype::s8));
+  bia.reset(new memory(memory::dims({p.oc}), format::x, memory::dtype::s32));
+  dst.reset(new memory(dst_dims, format::nhwc, dt));
+  testutils::fill_data<u8>((u8*)src->data(), src->size());
+  testutils::fill_data<s8>((s8*)wei->data(), wei->size());
+  testutils::fill_data<s32>((s32*)bia->data(), bia->size());
+
+  auto ip = inner_product(src, wei, bia, dst, post_relu);
+  auto r = benchutils::run_bench(
+      [&]() { ip->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+
+  std::ostringstream shape;  // like 1x2048x1x1_1000
+  shape << bs << "x" << ic << "x" << ih << "x" << iw << "_" << p.oc;
+  // the weights are most of the bytes at small batch
+  size_t bytes = src->size() + wei->size() + bia->size() * sizeof(s32) +
+                 dst->size() * utils::dtype_size(dt);
+  size_t ops = 2UL * bs * p.oc * ic * ih * iw;
+  benchutils::report(post_relu ? "DeepFusion InnerProduct_ReLU"
+                               : "DeepFusion InnerProduct",
+                     shape.str(),
+                     dt,
+                     r,
+                     bytes,
+                     ops);
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  deepfusion::benchutils::init();
+  // only run if given the shape
+  // for example:
+  // bench_inner_product -bs 1 -ic 2048 -oc 1000 -dtype f32
+  if (FLAGS_bs > 0) {
+    bench_params test_case = {{{FLAGS_bs, FLAGS_ic, FLAGS_ih, FLAGS_iw}},
+                              FLAGS_oc};
+    bench_deepfusion_inner_product(
+        test_case,
+        deepfusion::testutils::str2dtype(FLAGS_dtype),
+        FLAGS_post_relu);
+    return deepfusion::benchutils::finish();
+  }
+
+  // nothing input, then run some default cases, bs 1 for latency
+  bench_params default_cases[] = {{{{1, 2048, 1, 1}}, 1000},
+                                  {{{1, 512, 7, 7}}, 4096},
+                                  {{{1, 4096, 1, 1}}, 4096},
+                                  {{{32, 2048, 1, 1}}, 1000}};
+  deepfusion::memory::dtype dtypes[] = {deepfusion::memory::dtype::s8,
+                                        deepfusion::memory::dtype::f32};
+  for (const auto& p : default_cases) {
+    for (auto dt : dtypes) {
+      bench_deepfusion_inner_product(p, dt, FLAGS_post_relu);
+    }
+  }
+
+  return deepfusion::benchutils::finish();
+}
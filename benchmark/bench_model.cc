@@ -0,0 +1,165 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+
+#include <gflags/gflags.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "bench_utils.h"
+#include "log.h"
+#include "test_utils.h"
+
+DEFINE_int32(burning_iter, 20, "Burning iterations of each layer");
+DEFINE_int32(iter, 50, "Iterations of each layer");
+DEFINE_string(model, "", "Layer list file, for example, models/resnet50.txt");
+DEFINE_int32(bs, 0, "Override batch size of all layers if > 0");
+DEFINE_string(dtype, "u8", "Data type of dst");
+DEFINE_bool(post_relu, true, "Post ReLU after each layer");
+
+// One layer per line, as "<name> <conv|concat> <key>=<value> ...", '#' for
+// comment. The keys of conv are bs, ic, ih, iw, oc, kh, kw, sh, sw, ph, pw,
+// and oc1x1 if fused. The keys of concat are bs, h, w, c=<c0,c1,...>.
+// A layer repeated in the model can be given count=<n> once.
+struct layer {
+  std::string name, type;
+  int count;
+  deepfusion::benchutils::conv_params conv;
+  std::vector<deepfusion::memory::nchw_dims> concat_srcs;
+};
+
+bool parse_layer(const std::string& line, layer& l) {
+  std::istringstream iss(line);
+  std::map<std::string, std::string> kv;
+  if (!(iss >> l.name >> l.type)) {
+    return false;
+  }
+  std::string token;
+  while (iss >> token) {
+    auto pos = token.find('=');
+    if (pos == std::string::npos) {
+      return false;
+    }
+    kv[token.substr(0, pos)] = token.substr(pos + 1);
+  }
+  auto get = [&](const char* key, int def) {
+    return kv.count(key) ? std::stoi(kv[key]) : def;
+  };
+  int bs = FLAGS_bs > 0 ? FLAGS_bs : get("bs", 1);
+  l.count = get("count", 1);
+  if (l.type == "conv") {
+    l.conv = {{{bs, get("ic", 0), get("ih", 0), get("iw", 0)}},
+              get("oc", 0),
+              get("kh", 1),
+              get("kw", 1),
+              get("sh", 1),
+              get("sw", 1),
+              get("ph", 0),
+              get("pw", 0),
+              get("oc1x1", 0)};
+    return l.conv.src_dims[1] > 0 && l.conv.oc > 0;
+  } else if (l.type == "concat") {
+    if (!kv.count("c")) {
+      return false;
+    }
+    for (const auto& c : deepfusion::testutils::split(kv["c"])) {
+      l.concat_srcs.push_back({{bs, std::stoi(c), get("h", 0), get("w", 0)}});
+    }
+    return true;
+  }
+  return false;
+}
+
+std::vector<layer> load_model(const std::string& file) {
+  std::ifstream ifs(file);
+  if (!ifs) {
+    error_and_exit("Can not open model file %s", file.c_str());
+  }
+  std::vector<layer> layers;
+  std::string line;
+  int lineno = 0;
+  while (std::getline(ifs, line)) {
+    lineno++;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    layer l;
+    if (!parse_layer(line, l)) {
+      error_and_exit("Bad layer at %s:%d", file.c_str(), lineno);
+    }
+    layers.push_back(l);
+  }
+  return layers;
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  // for example:
+  // bench_model -model benchmark/models/resnet50.txt -bs 1 -dtype u8
+  using namespace deepfusion;
+  if (FLAGS_model.empty()) {
+    error_and_exit("Please give the layer list file by -model");
+  }
+  benchutils::init();
+  auto dt = testutils::str2dtype(FLAGS_dtype);
+  auto layers = load_model(FLAGS_model);
+  info("Model %s: %zu layers, dtype %s",
+       FLAGS_model.c_str(),
+       layers.size(),
+       testutils::dtype2str(dt));
+
+  // time of all layers, weighted by count
+  double total_mkldnn = 0, total_deepfusion = 0;
+  for (const auto& l : layers) {
+    std::unique_ptr<benchutils::mkldnn_workload> ref;
+    std::unique_ptr<benchutils::workload> w;
+    if (l.type == "conv") {
+      ref = benchutils::make_mkldnn_conv(l.conv, dt, FLAGS_post_relu);
+      w = benchutils::make_conv(l.conv, dt, FLAGS_post_relu);
+    } else {
+      ref = benchutils::make_mkldnn_concat(l.concat_srcs, dt, FLAGS_post_relu);
+      w = benchutils::make_concat(l.concat_srcs, dt, FLAGS_post_relu);
+    }
+    info("==========================================");
+    info("Layer %s: %s %s x%d",
+         l.name.c_str(),
+         l.type.c_str(),
+         w->shape.c_str(),
+         l.count);
+    auto r_ref = benchutils::run_bench(
+        [&]() { ref->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+    benchutils::report(
+        l.name + " MKL-DNN", w->shape, dt, r_ref, w->bytes, w->ops);
+    auto r = benchutils::run_bench(
+        [&]() { w->func->submit(); }, FLAGS_burning_iter, FLAGS_iter);
+    benchutils::report(
+        l.name + " DeepFusion", w->shape, dt, r, w->bytes, w->ops);
+    info("Layer %s speedup: %.2fx",
+         l.name.c_str(),
+         r_ref.percentile(50) / r.percentile(50));
+    total_mkldnn += l.count * r_ref.percentile(50);
+    total_deepfusion += l.count * r.percentile(50);
+  }
+  info("==========================================");
+  info("Total median time of %s: MKL-DNN %f ms, DeepFusion %f ms, "
+       "speedup %.2fx",
+       FLAGS_model.c_str(),
+       total_mkldnn,
+       total_deepfusion,
+       total_mkldnn / total_deepfusion);
+  return benchutils::finish();
+}
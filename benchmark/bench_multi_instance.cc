@@ -0,0 +1,203 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "bench_utils.h"
+#include "log.h"
+#include "test_utils.h"
+
+DEFINE_int32(burning_iter, 50, "Burning iterations of each instance");
+DEFINE_int32(iter, 100, "Iterations of each instance");
+DEFINE_int32(instances, 2, "Number of instances running concurrently");
+DEFINE_int32(threads, 0,
+             "OMP threads of each instance, 0 to split the cpus evenly");
+DEFINE_string(cpus, "",
+              "Cpus to split into instances in order, like 0-27, all cpus "
+              "allowed if empty");
+DEFINE_string(op, "conv", "Op of each instance, conv or concat");
+DEFINE_int32(bs, 1, "Batch size, number of images");
+DEFINE_int32(ih, 56, "Input image height");
+DEFINE_int32(iw, 56, "Input image width");
+DEFINE_int32(kh, 3, "Kernel height of conv");
+DEFINE_int32(kw, 3, "Kernel width of conv");
+DEFINE_int32(sh, 1, "Stride height of conv");
+DEFINE_int32(sw, 1, "Stride width of conv");
+DEFINE_int32(ph, 1, "Padding height of conv");
+DEFINE_int32(pw, 1, "Padding width of conv");
+DEFINE_int32(ic, 64, "Input channels of conv");
+DEFINE_int32(oc, 64, "Output channels of conv");
+DEFINE_int32(oc1x1, 0, "Output channels of fused 1x1 conv");
+DEFINE_string(c, "64,64", "Input channels of concat, for example, -c=64,64,32");
+DEFINE_string(dtype, "u8", "Data type of dst");
+DEFINE_bool(post_relu, true, "Post ReLU");
+
+// all instances wait here until everyone arrives
+class barrier {
+public:
+  explicit barrier(int n) : n_(n), count_(0), generation_(0) {}
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    int gen = generation_;
+    if (++count_ == n_) {
+      count_ = 0;
+      generation_++;
+      cv_.notify_all();
+    } else {
+      cv_.wait(lock, [&]() { return gen != generation_; });
+    }
+  }
+
+private:
+  int n_, count_, generation_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+struct instance_result {
+  deepfusion::benchutils::bench_result r;
+  double start_ms, end_ms;
+  std::string name, shape;
+  size_t bytes, ops;
+  int images;
+};
+
+std::unique_ptr<deepfusion::benchutils::workload> make_workload() {
+  using namespace deepfusion;
+  auto dt = testutils::str2dtype(FLAGS_dtype);
+  if (FLAGS_op == "concat") {
+    std::vector<memory::nchw_dims> srcs_dims;
+    for (const auto& c : testutils::split(FLAGS_c)) {
+      srcs_dims.push_back({{FLAGS_bs, std::stoi(c), FLAGS_ih, FLAGS_iw}});
+    }
+    return benchutils::make_concat(srcs_dims, dt, FLAGS_post_relu);
+  } else if (FLAGS_op == "conv") {
+    benchutils::conv_params p = {{{FLAGS_bs, FLAGS_ic, FLAGS_ih, FLAGS_iw}},
+                                 FLAGS_oc,
+                                 FLAGS_kh,
+                                 FLAGS_kw,
+                                 FLAGS_sh,
+                                 FLAGS_sw,
+                                 FLAGS_ph,
+                                 FLAGS_pw,
+                                 FLAGS_oc1x1};
+    return benchutils::make_conv(p, dt, FLAGS_post_relu);
+  }
+  error_and_exit("Unknown op %s", FLAGS_op.c_str());
+  return nullptr;
+}
+
+// Each instance is one std::thread with its own OMP thread team, which is
+// pinned to its own cpus. The ops and memories are created by the instance
+// itself, so that the pages are first touched on its cpus.
+void run_instance(std::vector<int> cpus,
+                  barrier& sync,
+                  instance_result& out) {
+  using namespace deepfusion;
+  omp_set_num_threads(cpus.size());
+  if (!benchutils::pin_omp_threads(cpus)) {
+    warning("Failed to pin instance threads");
+  }
+  auto w = make_workload();
+  out.name = w->name;
+  out.shape = w->shape;
+  out.bytes = w->bytes;
+  out.ops = w->ops;
+  out.images = w->images;
+
+  for (auto i = 0; i < FLAGS_burning_iter; ++i) {
+    w->func->submit();
+  }
+  sync.wait();  // start measurement together
+  out.r.iter_ms.resize(FLAGS_iter);
+  out.start_ms = utils::get_current_ms();
+  for (auto i = 0; i < FLAGS_iter; ++i) {
+    auto s1 = utils::get_current_ms();
+    w->func->submit();
+    out.r.iter_ms[i] = utils::get_current_ms() - s1;
+  }
+  out.end_ms = utils::get_current_ms();
+  out.r.avg_ms = (out.end_ms - out.start_ms) / FLAGS_iter;
+  for (auto& c : out.r.counters) {
+    c = -1;  // counters are not opened for instances
+  }
+  sync.wait();  // keep the load until all done
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  // for example, 4 instances x 7 threads on 28 cores:
+  // bench_multi_instance -instances 4 -threads 7 -cpus 0-27 -op conv -bs 1
+  using namespace deepfusion;
+  benchutils::init();
+  std::vector<int> cpus = benchutils::parse_cpu_list(FLAGS_cpus);
+  if (cpus.empty()) {
+    cpus = benchutils::allowed_cpus();
+  }
+  const int ninst = FLAGS_instances;
+  const int nthr = FLAGS_threads > 0 ? FLAGS_threads : cpus.size() / ninst;
+  if (ninst <= 0 || nthr <= 0) {
+    error_and_exit("Bad instances %d or threads %d", ninst, nthr);
+  }
+  if (ninst * nthr > (int)cpus.size()) {
+    warning("%d instances x %d threads oversubscribe %zu cpus",
+            ninst,
+            nthr,
+            cpus.size());
+  }
+  info("Run %d instances x %d threads of %s", ninst, nthr, FLAGS_op.c_str());
+
+  barrier sync(ninst);
+  std::vector<instance_result> results(ninst);
+  std::vector<std::thread> instances;
+  for (int i = 0; i < ninst; ++i) {
+    std::vector<int> inst_cpus;
+    for (int t = 0; t < nthr; ++t) {
+      inst_cpus.push_back(cpus[(i * nthr + t) % cpus.size()]);
+    }
+    instances.emplace_back(
+        run_instance, inst_cpus, std::ref(sync), std::ref(results[i]));
+  }
+  for (auto& t : instances) {
+    t.join();
+  }
+
+  // throughput of all instances in the common wall time
+  double start_ms = results[0].start_ms, end_ms = results[0].end_ms;
+  size_t images = 0;
+  auto dt = testutils::str2dtype(FLAGS_dtype);
+  for (int i = 0; i < ninst; ++i) {
+    const auto& res = results[i];
+    start_ms = std::min(start_ms, res.start_ms);
+    end_ms = std::max(end_ms, res.end_ms);
+    images += (size_t)res.images * FLAGS_iter;
+    std::ostringstream name;
+    name << res.name << " instance " << i << "/" << ninst << "x" << nthr;
+    // each instance is compared with the share of peaks of its threads
+    benchutils::report(
+        name.str(), res.shape, dt, res.r, res.bytes, res.ops, "", nthr);
+  }
+  info("Aggregate throughput: %.2f images/sec, %d instances x %d threads",
+       images / (end_ms - start_ms) * 1e3,
+       ninst,
+       nthr);
+  return benchutils::finish();
+}
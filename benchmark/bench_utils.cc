@@ -0,0 +1,945 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "bench_utils.h"
+#include <gflags/gflags.h>
+#include <sched.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "log.h"
+#include "src/jit_generator.h"
+
+DEFINE_string(output, "",
+              "Write results to the file, as CSV if it ends with .csv, "
+              "otherwise JSON");
+DEFINE_string(compare, "",
+              "Compare results with a previous output file, JSON or CSV");
+DEFINE_double(threshold, 0.05,
+              "Flag as regression if median time is slower by this ratio");
+DEFINE_bool(cold_cache, true,
+            "Flush cache around each iteration, otherwise run in hot cache");
+DEFINE_string(pin_cpus, "",
+              "Pin omp threads to cpus one by one, like 0-27, or 'all' for "
+              "all cpus allowed. Not pinned if empty");
+
+namespace deepfusion {
+namespace benchutils {
+
+// opened once, as it costs syscalls on every omp thread
+static utils::perf_counters &bench_counters() {
+  static utils::perf_counters counters;
+  return counters;
+}
+
+bench_result &bench_result::operator+=(const bench_result &rhs) {
+  avg_ms += rhs.avg_ms;
+  for (size_t i = 0; i < std::min(iter_ms.size(), rhs.iter_ms.size()); ++i) {
+    iter_ms[i] += rhs.iter_ms[i];
+  }
+  for (int k = 0; k < utils::perf_counters::n_kinds; ++k) {
+    if (counters[k] < 0 || rhs.counters[k] < 0) {
+      counters[k] = -1;
+    } else {
+      counters[k] += rhs.counters[k];
+    }
+  }
+  return *this;
+}
+
+double bench_result::ipc() const {
+  using pc = utils::perf_counters;
+  if (counters[pc::cycles] <= 0 || counters[pc::instructions] < 0) {
+    return 0;
+  }
+  return counters[pc::instructions] / counters[pc::cycles];
+}
+
+double bench_result::percentile(double p) const {
+  if (iter_ms.empty()) {
+    return avg_ms;
+  }
+  std::vector<double> sorted(iter_ms);
+  std::sort(sorted.begin(), sorted.end());
+  size_t rank = (size_t)std::ceil(p / 100 * sorted.size());
+  return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+double bench_result::stddev() const {
+  if (iter_ms.size() < 2) {
+    return 0;
+  }
+  double mean = 0, var = 0;
+  for (double t : iter_ms) {
+    mean += t;
+  }
+  mean /= iter_ms.size();
+  for (double t : iter_ms) {
+    var += (t - mean) * (t - mean);
+  }
+  return std::sqrt(var / (iter_ms.size() - 1));
+}
+
+std::vector<int> parse_cpu_list(const std::string &str) {
+  std::vector<int> cpus;
+  for (const auto &item : testutils::split(str)) {
+    auto pos = item.find('-');
+    int first = std::stoi(item.substr(0, pos));
+    int last =
+        pos == std::string::npos ? first : std::stoi(item.substr(pos + 1));
+    for (int c = first; c <= last; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return cpus;
+  }
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (CPU_ISSET(c, &allowed)) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+bool pin_omp_threads(std::vector<int> cpus) {
+  if (cpus.empty()) {
+    cpus = allowed_cpus();
+  }
+  if (cpus.empty()) {
+    return false;
+  }
+  bool ok = true;
+  #pragma omp parallel reduction(&& : ok)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+    ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+  }
+  return ok;
+}
+
+void init() {
+  if (!FLAGS_pin_cpus.empty()) {
+    auto cpus = FLAGS_pin_cpus == "all" ? std::vector<int>()
+                                        : parse_cpu_list(FLAGS_pin_cpus);
+    if (!pin_omp_threads(cpus)) {
+      warning("Failed to pin threads to cpus %s", FLAGS_pin_cpus.c_str());
+    }
+  }
+  info("Run %d threads in %s cache%s", omp_get_max_threads(),
+       FLAGS_cold_cache ? "cold" : "hot",
+       FLAGS_pin_cpus.empty() ? "" : ", pinned");
+  get_machine_peak();
+}
+
+bench_result run_bench(const std::function<void()> &fn,
+                       int burning_iter,
+                       int iter) {
+  auto &pc = bench_counters();
+  auto clear_cache = []() {
+    if (FLAGS_cold_cache) {
+      testutils::clear_cache();
+    }
+  };
+  for (auto i = 0; i < burning_iter; ++i) {
+    clear_cache();
+    fn();
+    clear_cache();
+  }
+
+  bench_result r;
+  r.iter_ms.resize(iter);
+  double sum = 0;
+  pc.reset();
+  for (auto i = 0; i < iter; ++i) {
+    clear_cache();
+    pc.start();
+    auto s1 = utils::get_current_ms();
+    fn();
+    auto s2 = utils::get_current_ms();
+    pc.stop();
+    r.iter_ms[i] = s2 - s1;
+    sum += (s2 - s1);
+    clear_cache();
+  }
+
+  r.avg_ms = sum / (double)iter;
+  for (int k = 0; k < utils::perf_counters::n_kinds; ++k) {
+    r.counters[k] = pc.available(k) ? (double)pc.value(k) / iter : -1;
+  }
+  return r;
+}
+
+// int8 multiply-add throughput, or f32 fma throughput if f32, with
+// independent accumulators to hide the latency, the same instructions as
+// conv kernels
+struct jit_peak_kernel : public jit::jit_generator {
+  const char *name() const override { return "jit_peak_kernel"; }
+  const char *source_file() const override { return __FILE__; }
+
+  explicit jit_peak_kernel(bool f32 = false)
+      : isa_(jit::isa_any), ops_per_loop_(0) {
+    using namespace Xbyak;
+    // vfmadd231ps has latency 4 on 2 ports
+    constexpr int nacc_fma = 10;
+    if (f32 && jit::mayiuse(jit::avx512_core)) {
+      isa_ = jit::avx512_core;
+      generate_fma<Zmm>(nacc_fma);
+      ops_per_loop_ = nacc_fma * 16 * 2;
+    } else if (f32 && jit::mayiuse(jit::avx2)) {
+      isa_ = jit::avx2;
+      generate_fma<Ymm>(nacc_fma);
+      ops_per_loop_ = nacc_fma * 8 * 2;
+    } else if (f32) {
+      ret();
+    } else if (jit::mayiuse(jit::avx512_core_vnni)) {
+      isa_ = jit::avx512_core_vnni;
+      // vpdpbusd has latency 5 on 2 ports
+      constexpr int nacc = 12;
+      generate<Zmm>(nacc, true);
+      ops_per_loop_ = nacc * 64 * 2;
+    } else if (jit::mayiuse(jit::avx512_core)) {
+      isa_ = jit::avx512_core;
+      constexpr int nacc = 8;
+      generate<Zmm>(nacc, false);
+      ops_per_loop_ = nacc * 64 * 2;
+    } else if (jit::mayiuse(jit::avx2)) {
+      isa_ = jit::avx2;
+      constexpr int nacc = 4;
+      generate<Ymm>(nacc, false);
+      ops_per_loop_ = nacc * 32 * 2;
+    } else {
+      ret();
+    }
+    ker_ = (decltype(ker_))this->getCode();
+  }
+
+  // acc: 0 ~ nacc-1, tmp: nacc ~ 2*nacc-1, then inputs
+  template <typename Vmm>
+  void generate(int nacc, bool vnni) {
+    const int idx_a = 2 * nacc, idx_b = idx_a + 1, idx_one = idx_b + 1;
+    Vmm vmm_a(idx_a), vmm_b(idx_b), vmm_one(idx_one);
+    Xbyak::Reg64 reg_loops = jit::abi_param1;
+    Xbyak::Label l_loop;
+    preamble();
+    vpxor(Xbyak::Xmm(idx_a), Xbyak::Xmm(idx_a), Xbyak::Xmm(idx_a));
+    vpxor(Xbyak::Xmm(idx_b), Xbyak::Xmm(idx_b), Xbyak::Xmm(idx_b));
+    vpxor(Xbyak::Xmm(idx_one), Xbyak::Xmm(idx_one), Xbyak::Xmm(idx_one));
+    L(l_loop);
+    for (int i = 0; i < nacc; ++i) {
+      Vmm acc(i), tmp(nacc + i);
+      if (vnni) {
+        vpdpbusd(acc, vmm_a, vmm_b);
+      } else {
+        vpmaddubsw(tmp, vmm_a, vmm_b);
+        vpmaddwd(tmp, tmp, vmm_one);
+        vpaddd(acc, acc, tmp);
+      }
+    }
+    dec(reg_loops);
+    jnz(l_loop);
+    vzeroupper();
+    postamble();
+  }
+
+  // acc: 0 ~ nacc-1, then inputs
+  template <typename Vmm>
+  void generate_fma(int nacc) {
+    const int idx_a = nacc, idx_b = idx_a + 1;
+    Vmm vmm_a(idx_a), vmm_b(idx_b);
+    Xbyak::Reg64 reg_loops = jit::abi_param1;
+    Xbyak::Label l_loop;
+    preamble();
+    for (int i = 0; i <= idx_b; ++i) {
+      vxorps(Xbyak::Xmm(i), Xbyak::Xmm(i), Xbyak::Xmm(i));
+    }
+    L(l_loop);
+    for (int i = 0; i < nacc; ++i) {
+      vfmadd231ps(Vmm(i), vmm_a, vmm_b);
+    }
+    dec(reg_loops);
+    jnz(l_loop);
+    vzeroupper();
+    postamble();
+  }
+
+  jit::cpu_isa_t isa_;
+  size_t ops_per_loop_;
+  void (*ker_)(size_t loops);
+};
+
+static const char *isa2str(jit::cpu_isa_t isa) {
+  switch (isa) {
+    case jit::avx2:
+      return "avx2";
+    case jit::avx512_core:
+      return "avx512_core";
+    case jit::avx512_core_vnni:
+      return "avx512_core_vnni";
+    default:
+      return "any";
+  }
+}
+
+static double measure_peak_gbps() {
+  const int nthr = omp_get_max_threads();
+  // far larger than LLC, so that it's from memory
+  const size_t size = std::max(
+      (size_t)jit::get_cache_size(3, false) * 8, (size_t)256 * 1024 * 1024);
+  auto src = (char *)utils::aligned_malloc(size, 4096);
+  auto dst = (char *)utils::aligned_malloc(size, 4096);
+  // touch all pages in parallel, as first touch
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < size; i += 4096) {
+    src[i] = dst[i] = 1;
+  }
+  double best_ms = 0;
+  for (int rep = 0; rep < 5; ++rep) {
+    auto s1 = utils::get_current_ms();
+    #pragma omp parallel num_threads(nthr)
+    {
+      size_t start = 0, end = 0;
+      utils::balance211(size, (size_t)nthr, (size_t)omp_get_thread_num(), start,
+                        end);
+      memcpy(dst + start, src + start, end - start);
+    }
+    auto ms = utils::get_current_ms() - s1;
+    if (rep == 0 || ms < best_ms) {
+      best_ms = ms;
+    }
+  }
+  utils::aligned_free(src);
+  utils::aligned_free(dst);
+  // read src and write dst
+  return 2 * size / best_ms * 1e-6;
+}
+
+static double measure_peak_gops(const jit_peak_kernel &ker) {
+  if (ker.ops_per_loop_ == 0) {
+    return 0;
+  }
+  const int nthr = omp_get_max_threads();
+  const size_t loops = 1 << 20;
+  double best_ms = 0;
+  for (int rep = 0; rep < 5; ++rep) {
+    auto s1 = utils::get_current_ms();
+    #pragma omp parallel num_threads(nthr)
+    { ker.ker_(loops); }
+    auto ms = utils::get_current_ms() - s1;
+    if (rep == 0 || ms < best_ms) {
+      best_ms = ms;
+    }
+  }
+  return (double)nthr * loops * ker.ops_per_loop_ / best_ms * 1e-6;
+}
+
+const machine_peak &get_machine_peak() {
+  static machine_peak peak = {0, 0, 0, nullptr, 0};
+  if (peak.isa == nullptr) {
+    jit_peak_kernel ker, ker_f32(true);
+    peak.gbps = measure_peak_gbps();
+    peak.gops = measure_peak_gops(ker);
+    peak.gflops = measure_peak_gops(ker_f32);
+    peak.isa = isa2str(ker.isa_);
+    peak.threads = omp_get_max_threads();
+    info("Machine peak with %d threads: %.1f GB/s, %.1f int8 GOPS, %.1f f32 "
+         "GFLOPS (%s)",
+         omp_get_max_threads(),
+         peak.gbps,
+         peak.gops,
+         peak.gflops,
+         peak.isa);
+  }
+  return peak;
+}
+
+std::string format_result(const bench_result &r,
+                          size_t bytes,
+                          size_t ops,
+                          int threads,
+                          bool f32_ops) {
+  std::ostringstream oss;
+  oss << "avg time: " << r.avg_ms << " ms";
+  if (r.iter_ms.size() > 1) {
+    oss << " (min " << r.percentile(0) << ", median " << r.percentile(50)
+        << ", p90 " << r.percentile(90) << ", p99 " << r.percentile(99)
+        << ", max " << r.percentile(100) << ", stddev " << r.stddev() << ")";
+  }
+  if (r.ipc() > 0) {
+    oss << ", IPC " << r.ipc();
+  }
+  if (r.avg_ms > 0) {
+    oss << ", " << bytes / r.avg_ms * 1e-6 << " GB/s";
+  }
+  // roofline: min(peak ops, peak bandwidth * ops / bytes), of the share of
+  // the threads run on, and of the f32 peak for f32 ops
+  const auto &peak = get_machine_peak();
+  const double share =
+      threads > 0 && peak.threads > 0 ? (double)threads / peak.threads : 1.;
+  const double peak_gops = (f32_ops ? peak.gflops : peak.gops) * share;
+  const double peak_gbps = peak.gbps * share;
+  if (r.avg_ms > 0 && ops > 0) {
+    double gops = ops / r.avg_ms * 1e-6;
+    oss << ", " << gops << " GOPS";
+    if (peak_gops > 0 && peak_gbps > 0) {
+      double roof = std::min(peak_gops, peak_gbps * ops / bytes);
+      bool memory_bound = peak_gbps * ops / bytes < peak_gops;
+      oss << ", " << 100 * gops / roof << "% of roofline ("
+          << (memory_bound ? "memory" : "compute") << " bound)";
+    }
+  } else if (r.avg_ms > 0 && peak_gbps > 0) {
+    oss << ", " << 100 * (bytes / r.avg_ms * 1e-6) / peak_gbps
+        << "% of peak bandwidth";
+  }
+  const int misses[] = {utils::perf_counters::l1d_misses,
+                        utils::perf_counters::l2_misses,
+                        utils::perf_counters::llc_misses};
+  for (int k : misses) {
+    if (r.counters[k] >= 0) {
+      oss << ", " << utils::perf_counters::name(k) << " " << r.counters[k];
+    }
+  }
+  return oss.str();
+}
+
+std::string conv_params::shape() const {
+  std::ostringstream oss;
+  oss << src_dims[0] << "x" << src_dims[1] << "x" << src_dims[2] << "x"
+      << src_dims[3] << "_" << oc << "x" << kh << "x" << kw << "_s" << sh
+      << "x" << sw << "_p" << ph << "x" << pw;
+  if (oc1x1 > 0) {
+    oss << "_1x1x" << oc1x1;
+  }
+  return oss.str();
+}
+
+size_t conv_params::bytes(memory::dtype dt, bool f32_conv) const {
+  const size_t bs = src_dims[0], ic = src_dims[1];
+  const size_t oh = utils::conv_output_size(src_dims[2], kh, sh, ph);
+  const size_t ow = utils::conv_output_size(src_dims[3], kw, sw, pw);
+  const size_t dst_oc = oc1x1 > 0 ? oc1x1 : oc;
+  // u8 src, s8 weights (or both f32) and f32 bias
+  const size_t in_size = f32_conv ? sizeof(f32) : sizeof(u8);
+  size_t out = (bs * ic * src_dims[2] * src_dims[3] + oc * ic * kh * kw) *
+                   in_size +
+               oc * sizeof(f32) + bs * dst_oc * oh * ow * utils::dtype_size(dt);
+  if (oc1x1 > 0) {
+    out += oc1x1 * oc * in_size + oc1x1 * sizeof(f32);
+  }
+  return out;
+}
+
+size_t conv_params::ops() const {
+  const size_t bs = src_dims[0], ic = src_dims[1];
+  const size_t oh = utils::conv_output_size(src_dims[2], kh, sh, ph);
+  const size_t ow = utils::conv_output_size(src_dims[3], kw, sw, pw);
+  // one multiply-add counts 2 ops
+  size_t out = 2 * bs * oh * ow * oc * ic * kh * kw;
+  if (oc1x1 > 0) {
+    out += 2 * bs * oh * ow * oc1x1 * oc;
+  }
+  return out;
+}
+
+std::unique_ptr<workload> make_conv(const conv_params &p,
+                                    memory::dtype dt,
+                                    bool post_relu,
+                                    bool f32_conv,
+                                    conv_algorithm algo) {
+  using format = memory::format;
+  using dtype = memory::dtype;
+
+  const int bs = p.src_dims[0], ic = p.src_dims[1];
+  const int oh = utils::conv_output_size(p.src_dims[2], p.kh, p.sh, p.ph);
+  const int ow = utils::conv_output_size(p.src_dims[3], p.kw, p.sw, p.pw);
+  const bool fuse_conv1x1 = p.oc1x1 > 0;
+  const int dst_oc = fuse_conv1x1 ? p.oc1x1 : p.oc;
+  memory::nchw_dims wei_dims = {{p.oc, ic, p.kh, p.kw}};
+  memory::nchw_dims dst_dims = {{bs, dst_oc, oh, ow}};
+
+  const auto src_dt = f32_conv ? dtype::f32 : dtype::u8;
+  const auto wei_dt = f32_conv ? dtype::f32 : dtype::s8;
+  const auto wei_fmt = f32_conv ? format::OIhw16i16o : format::OIhw4i16o4i;
+  // random data of s8 are fine for f32 too
+  auto fill = [](const std::unique_ptr<memory> &m) {
+    if (m->data_type() == dtype::f32) {
+      testutils::fill_data<f32>((f32 *)m->data(), m->size());
+    } else if (m->data_type() == dtype::u8) {
+      testutils::fill_data<u8>((u8 *)m->data(), m->size());
+    } else {
+      testutils::fill_data<s8>((s8 *)m->data(), m->size());
+    }
+  };
+
+  std::unique_ptr<workload> w(new workload);
+  std::unique_ptr<memory> src, wei, bia, wei1x1, bia1x1, dst;
+  src.reset(new memory(p.src_dims, format::nhwc, src_dt));
+  wei.reset(new memory(wei_dims, wei_fmt, wei_dt));
+  bia.reset(new memory(memory::dims({p.oc}), format::x, dtype::f32));
+  dst.reset(new memory(dst_dims, format::nhwc, dt));
+  fill(src);
+  fill(wei);
+  fill(bia);
+
+  if (fuse_conv1x1) {
+    memory::nchw_dims wei1x1_dims = {{p.oc1x1, p.oc, 1, 1}};
+    wei1x1.reset(new memory(wei1x1_dims, wei_fmt, wei_dt));
+    bia1x1.reset(new memory(memory::dims({p.oc1x1}), format::x, dtype::f32));
+    fill(wei1x1);
+    fill(bia1x1);
+    w->func = conv(src,
+                   wei,
+                   bia,
+                   {{p.sh, p.sw}},
+                   {{p.ph, p.pw}},
+                   wei1x1,
+                   bia1x1,
+                   dst,
+                   true,
+                   {1.f},
+                   round_mode::nearest,
+                   post_relu);
+  } else {
+    w->func = conv(src,
+                   wei,
+                   bia,
+                   {{p.sh, p.sw}},
+                   {{p.ph, p.pw}},
+                   dst,
+                   post_relu,
+                   {1.f},
+                   round_mode::nearest,
+                   algo);
+  }
+
+  w->name = "DeepFusion Conv";
+  w->name += f32_conv ? "_F32" : "";
+  w->name += post_relu ? "_ReLU" : "";
+  w->name += fuse_conv1x1 ? "_Conv1x1" : "";
+  w->name += algo == conv_algorithm::winograd ? "_Winograd" : "";
+  w->shape = p.shape();
+  w->bytes = p.bytes(dt, f32_conv);
+  w->ops = p.ops();
+  w->f32_ops = f32_conv;
+  w->dt = dt;
+  w->images = bs;
+  for (auto m : {&src, &wei, &bia, &wei1x1, &bia1x1, &dst}) {
+    if (*m) {
+      w->mems.push_back(std::move(*m));
+    }
+  }
+  return w;
+}
+
+std::unique_ptr<workload> make_concat(
+    const std::vector<memory::nchw_dims> &srcs_dims,
+    memory::dtype dt,
+    bool post_relu) {
+  std::unique_ptr<workload> w(new workload);
+  std::vector<std::unique_ptr<memory>> srcs(srcs_dims.size());
+  std::unique_ptr<memory> dst;
+  memory::nchw_dims dst_dims = srcs_dims[0];
+  dst_dims[1] = 0;
+  std::ostringstream shape;  // srcs in nchw, like 4x16x9x9+4x64x9x9
+  w->bytes = 0;
+  for (size_t i = 0; i < srcs.size(); ++i) {
+    const auto &dims = srcs_dims[i];
+    srcs[i].reset(new memory(dims, memory::format::nhwc, dt));
+    dst_dims[1] += dims[1];
+    w->bytes += srcs[i]->buffer_size();
+    shape << (i > 0 ? "+" : "") << dims[0] << "x" << dims[1] << "x" << dims[2]
+          << "x" << dims[3];
+  }
+  dst.reset(new memory(dst_dims, memory::format::nhwc, dt));
+  w->bytes += dst->buffer_size();
+  w->ops = 0;
+  w->f32_ops = false;
+  w->func = concat(srcs, dst, post_relu);
+  w->name = post_relu ? "DeepFusion Concat_ReLU" : "DeepFusion Concat";
+  w->shape = shape.str();
+  w->dt = dt;
+  w->images = dst_dims[0];
+  for (auto &m : srcs) {
+    w->mems.push_back(std::move(m));
+  }
+  w->mems.push_back(std::move(dst));
+  return w;
+}
+
+static mkldnn::engine &mkldnn_engine() {
+  static mkldnn::engine eng(mkldnn::engine::cpu, 0);
+  return eng;
+}
+
+void mkldnn_workload::submit() {
+  mkldnn::stream(mkldnn::stream::kind::eager).submit(pipeline).wait();
+}
+
+// add one conv with optional relu, src is the last memory of w
+static void append_mkldnn_conv(mkldnn_workload &w,
+                               const mkldnn::memory::desc &src_desc,
+                               const memory::nchw_dims &src_dims,
+                               int oc,
+                               int kh,
+                               int kw,
+                               int sh,
+                               int sw,
+                               int ph,
+                               int pw,
+                               mkldnn::memory::data_type wei_dt,
+                               mkldnn::memory::data_type dst_dt,
+                               bool relu) {
+  auto &eng = mkldnn_engine();
+  const int oh = utils::conv_output_size(src_dims[2], kh, sh, ph);
+  const int ow = utils::conv_output_size(src_dims[3], kw, sw, pw);
+  // right and bottom padding, to get exact output size
+  mkldnn::memory::dims pad_r = {(oh - 1) * sh - src_dims[2] + kh - ph,
+                                (ow - 1) * sw - src_dims[3] + kw - pw};
+  // let MKL-DNN pick its best weights format
+  auto wei_desc = mkldnn::memory::desc(
+      {oc, src_dims[1], kh, kw}, wei_dt, mkldnn::memory::format::any);
+  auto bia_desc = mkldnn::memory::desc(
+      {oc}, mkldnn::memory::data_type::f32, mkldnn::memory::format::x);
+  auto dst_desc = mkldnn::memory::desc(
+      {src_dims[0], oc, oh, ow}, dst_dt, mkldnn::memory::format::nhwc);
+  auto conv_desc =
+      mkldnn::convolution_forward::desc(mkldnn::prop_kind::forward_inference,
+                                        mkldnn::algorithm::convolution_direct,
+                                        src_desc,
+                                        wei_desc,
+                                        bia_desc,
+                                        dst_desc,
+                                        {sh, sw},
+                                        {ph, pw},
+                                        pad_r,
+                                        mkldnn::padding_kind::zero);
+  mkldnn::primitive_attr attr;
+  attr.set_int_output_round_mode(mkldnn::round_mode::round_nearest);
+  attr.set_output_scales(0, {1.f});
+  if (relu) {
+    mkldnn::post_ops ops;
+    ops.append_eltwise(1.f, mkldnn::algorithm::eltwise_relu, 0.f, 0.f);
+    attr.set_post_ops(ops);
+  }
+  auto pd = mkldnn::convolution_forward::primitive_desc(conv_desc, attr, eng);
+  auto src = w.mems.back();
+  auto wei = mkldnn::memory(pd.weights_primitive_desc());
+  auto bia = mkldnn::memory(pd.bias_primitive_desc());
+  auto dst = mkldnn::memory(pd.dst_primitive_desc());
+  w.pipeline.push_back(mkldnn::convolution_forward(pd, src, wei, bia, dst));
+  w.mems.push_back(wei);
+  w.mems.push_back(bia);
+  w.mems.push_back(dst);
+}
+
+std::unique_ptr<mkldnn_workload> make_mkldnn_conv(const conv_params &p,
+                                                  memory::dtype dt,
+                                                  bool post_relu,
+                                                  bool f32_conv) {
+  using mdt = mkldnn::memory::data_type;
+  std::unique_ptr<mkldnn_workload> w(new mkldnn_workload);
+  const auto src_dt = f32_conv ? mdt::f32 : mdt::u8;
+  const auto wei_dt = f32_conv ? mdt::f32 : mdt::s8;
+  auto src_desc = mkldnn::memory::desc(testutils::to_mkldnn_dims(p.src_dims),
+                                       src_dt,
+                                       mkldnn::memory::format::nhwc);
+  w->mems.push_back(mkldnn::memory(
+      mkldnn::memory::primitive_desc(src_desc, mkldnn_engine())));
+  auto dst_dt = testutils::to_mkldnn_dtype(dt);
+  if (p.oc1x1 > 0) {
+    // conv0 outputs u8 (or f32) with relu, as the fused one
+    append_mkldnn_conv(*w, src_desc, p.src_dims, p.oc, p.kh, p.kw, p.sh, p.sw,
+                       p.ph, p.pw, wei_dt, src_dt, true);
+    memory::nchw_dims mid_dims = {
+        {p.src_dims[0],
+         p.oc,
+         utils::conv_output_size(p.src_dims[2], p.kh, p.sh, p.ph),
+         utils::conv_output_size(p.src_dims[3], p.kw, p.sw, p.pw)}};
+    auto mid_desc = mkldnn::memory::desc(testutils::to_mkldnn_dims(mid_dims),
+                                         src_dt,
+                                         mkldnn::memory::format::nhwc);
+    append_mkldnn_conv(*w, mid_desc, mid_dims, p.oc1x1, 1, 1, 1, 1, 0, 0,
+                       wei_dt, dst_dt, post_relu);
+  } else {
+    append_mkldnn_conv(*w, src_desc, p.src_dims, p.oc, p.kh, p.kw, p.sh, p.sw,
+                       p.ph, p.pw, wei_dt, dst_dt, post_relu);
+  }
+  return w;
+}
+
+std::unique_ptr<mkldnn_workload> make_mkldnn_concat(
+    const std::vector<memory::nchw_dims> &srcs_dims,
+    memory::dtype dt,
+    bool post_relu) {
+  auto &eng = mkldnn_engine();
+  std::unique_ptr<mkldnn_workload> w(new mkldnn_workload);
+  auto mdt = testutils::to_mkldnn_dtype(dt);
+  auto fmt = mkldnn::memory::format::nhwc;
+  std::vector<mkldnn::memory::primitive_desc> srcs_pd;
+  std::vector<mkldnn::primitive::at> inputs;
+  deepfusion::memory::nchw_dims dst_dims = srcs_dims[0];
+  dst_dims[1] = 0;
+  for (const auto &dims : srcs_dims) {
+    auto mpd = mkldnn::memory::primitive_desc(
+        mkldnn::memory::desc(testutils::to_mkldnn_dims(dims), mdt, fmt), eng);
+    srcs_pd.push_back(mpd);
+    w->mems.push_back(mkldnn::memory(mpd));
+    inputs.push_back(w->mems.back());
+    dst_dims[1] += dims[1];
+  }
+  auto dst_desc =
+      mkldnn::memory::desc(testutils::to_mkldnn_dims(dst_dims), mdt, fmt);
+  auto concat_pd = mkldnn::concat::primitive_desc(dst_desc, 1, srcs_pd);
+  auto dst = mkldnn::memory(concat_pd.dst_primitive_desc());
+  w->pipeline.push_back(mkldnn::concat(concat_pd, inputs, dst));
+  if (post_relu) {
+    auto relu_pd = testutils::get_mkldnn_relu_pd(dst_desc, eng);
+    w->pipeline.push_back(mkldnn::eltwise_forward(*relu_pd, dst, dst));
+  }
+  w->mems.push_back(dst);
+  return w;
+}
+
+// one benchmark result, gbps and gops are of median time
+struct bench_record {
+  std::string name, shape, dtype;
+  int threads;
+  double min_ms, median_ms, p99_ms, gbps, gops;
+
+  std::string key() const {
+    std::ostringstream oss;
+    oss << name << "|" << shape << "|" << dtype << "|" << threads;
+    return oss.str();
+  }
+};
+
+static std::vector<bench_record> records;
+
+void report(const std::string &name,
+            const std::string &shape,
+            memory::dtype dt,
+            const bench_result &r,
+            size_t bytes,
+            size_t ops,
+            const std::string &note,
+            int threads,
+            bool f32_ops) {
+  info("%s%s %s", name.c_str(), note.c_str(),
+       format_result(r, bytes, ops, threads, f32_ops).c_str());
+  bench_record rec;
+  rec.name = name;
+  rec.shape = shape;
+  rec.dtype = testutils::dtype2str(dt);
+  rec.threads = threads > 0 ? threads : omp_get_max_threads();
+  rec.min_ms = r.percentile(0);
+  rec.median_ms = r.percentile(50);
+  rec.p99_ms = r.percentile(99);
+  rec.gbps = rec.median_ms > 0 ? bytes / rec.median_ms * 1e-6 : 0;
+  rec.gops = rec.median_ms > 0 ? ops / rec.median_ms * 1e-6 : 0;
+  records.push_back(rec);
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static const char *csv_header =
+    "name,shape,dtype,threads,min_ms,median_ms,p99_ms,gbps,gops";
+
+// names and shapes have no comma or quote, so need no escape
+static bool write_records(const std::string &file) {
+  std::ofstream ofs(file);
+  if (!ofs) {
+    warning("Can not open output file %s", file.c_str());
+    return false;
+  }
+  const bool csv = ends_with(file, ".csv");
+  if (csv) {
+    ofs << csv_header << "\n";
+  } else {
+    ofs << "[\n";
+  }
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto &r = records[i];
+    if (csv) {
+      ofs << r.name << "," << r.shape << "," << r.dtype << "," << r.threads
+          << "," << r.min_ms << "," << r.median_ms << "," << r.p99_ms << ","
+          << r.gbps << "," << r.gops << "\n";
+    } else {
+      // one record per line, which is also how it's loaded
+      ofs << "{\"name\":\"" << r.name << "\",\"shape\":\"" << r.shape
+          << "\",\"dtype\":\"" << r.dtype << "\",\"threads\":" << r.threads
+          << ",\"min_ms\":" << r.min_ms << ",\"median_ms\":" << r.median_ms
+          << ",\"p99_ms\":" << r.p99_ms << ",\"gbps\":" << r.gbps
+          << ",\"gops\":" << r.gops << "}"
+          << (i + 1 < records.size() ? "," : "") << "\n";
+    }
+  }
+  if (!csv) {
+    ofs << "]\n";
+  }
+  info("Wrote %zu results to %s", records.size(), file.c_str());
+  return true;
+}
+
+// value of "key": in one json line, without the quotes of string
+static std::string json_value(const std::string &line, const char *key) {
+  std::string pattern = std::string("\"") + key + "\":";
+  size_t pos = line.find(pattern);
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos += pattern.size();
+  if (line[pos] == '"') {
+    size_t end = line.find('"', pos + 1);
+    return line.substr(pos + 1, end - pos - 1);
+  }
+  size_t end = line.find_first_of(",}", pos);
+  return line.substr(pos, end - pos);
+}
+
+// the whole string should be a number, trailing spaces allowed
+static bool parse_number(const std::string &str, double &val) {
+  const char *begin = str.c_str();
+  char *end = nullptr;
+  val = strtod(begin, &end);
+  if (end == begin) {
+    return false;
+  }
+  while (isspace(*end)) ++end;
+  return *end == '\0';
+}
+
+static bool parse_number(const std::string &str, int &val) {
+  const char *begin = str.c_str();
+  char *end = nullptr;
+  long v = strtol(begin, &end, 10);
+  if (end == begin || v < INT_MIN || v > INT_MAX) {
+    return false;
+  }
+  while (isspace(*end)) ++end;
+  val = v;
+  return *end == '\0';
+}
+
+static bool load_records(const std::string &file,
+                         std::vector<bench_record> &out) {
+  std::ifstream ifs(file);
+  if (!ifs) {
+    warning("Can not open compare file %s", file.c_str());
+    return false;
+  }
+  const bool csv = ends_with(file, ".csv");
+  std::string line;
+  int lineno = 0;
+  while (std::getline(ifs, line)) {
+    ++lineno;
+    bench_record r;
+    // threads, min, median and p99 ms, GB/s and GOPS
+    std::vector<std::string> nums;
+    if (csv) {
+      if (line.empty() || line == csv_header) continue;
+      auto v = testutils::split(line);
+      if (v.size() != 9) continue;
+      r.name = v[0];
+      r.shape = v[1];
+      r.dtype = v[2];
+      nums.assign(v.begin() + 3, v.end());
+    } else {
+      if (line.find("\"name\":") == std::string::npos) continue;
+      r.name = json_value(line, "name");
+      r.shape = json_value(line, "shape");
+      r.dtype = json_value(line, "dtype");
+      for (const char *key :
+           {"threads", "min_ms", "median_ms", "p99_ms", "gbps", "gops"}) {
+        nums.push_back(json_value(line, key));
+      }
+    }
+    if (!utils::all_true(parse_number(nums[0], r.threads),
+                         parse_number(nums[1], r.min_ms),
+                         parse_number(nums[2], r.median_ms),
+                         parse_number(nums[3], r.p99_ms),
+                         parse_number(nums[4], r.gbps),
+                         parse_number(nums[5], r.gops))) {
+      warning("Skip bad record at %s:%d", file.c_str(), lineno);
+      continue;
+    }
+    out.push_back(r);
+  }
+  return true;
+}
+
+// compare median time of the same records
+static int compare_records(const std::string &file, double threshold) {
+  std::vector<bench_record> prev;
+  if (!load_records(file, prev)) {
+    return 1;
+  }
+  std::map<std::string, const bench_record *> prev_map;
+  for (const auto &r : prev) {
+    prev_map[r.key()] = &r;
+  }
+  int n_regressions = 0, n_compared = 0;
+  info("==========================================");
+  info("Compare with %s, threshold %.1f%%", file.c_str(), threshold * 100);
+  for (const auto &r : records) {
+    auto it = prev_map.find(r.key());
+    if (it == prev_map.end() || it->second->median_ms <= 0) {
+      continue;
+    }
+    n_compared++;
+    double ratio = r.median_ms / it->second->median_ms - 1;
+    bool regression = ratio > threshold;
+    n_regressions += regression;
+    info("%s %s %s %d threads: median %f ms vs %f ms (%+.1f%%)%s",
+         r.name.c_str(), r.shape.c_str(), r.dtype.c_str(), r.threads,
+         r.median_ms, it->second->median_ms, ratio * 100,
+         regression ? " REGRESSION" : "");
+  }
+  info("%d of %zu results compared, %d regressions", n_compared,
+       records.size(), n_regressions);
+  return n_regressions > 0 ? 1 : 0;
+}
+
+int finish() {
+  int ret = 0;
+  if (!FLAGS_output.empty() && !write_records(FLAGS_output)) {
+    ret = 1;
+  }
+  if (!FLAGS_compare.empty() &&
+      compare_records(FLAGS_compare, FLAGS_threshold) != 0) {
+    ret = 1;
+  }
+  return ret;
+}
+
+}
+}
@@ -0,0 +1,156 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "perf_counters.h"
+#include "test_utils.h"
+
+namespace deepfusion {
+namespace benchutils {
+
+// time of every iteration, and hardware counters of one iteration on average
+struct bench_result {
+  double avg_ms;
+  std::vector<double> iter_ms;
+  double counters[utils::perf_counters::n_kinds];  // < 0 if not available
+
+  bench_result &operator+=(const bench_result &rhs);
+  double ipc() const;
+  // p in [0, 100], by nearest rank
+  double percentile(double p) const;
+  double stddev() const;
+};
+
+// Apply the common command line flags, should be called at the beginning of
+// main after parsing flags: pin omp threads, and measure the machine peaks.
+void init();
+
+// cpu list like "0-3,8,10-11"
+std::vector<int> parse_cpu_list(const std::string &str);
+// cpus allowed of this process, in order
+std::vector<int> allowed_cpus();
+// pin the i-th omp thread to cpus[i % size], all cpus allowed if empty
+bool pin_omp_threads(std::vector<int> cpus);
+
+// run fn burning_iter times for warm up, then iter times for measurement,
+// cache is cleared around each iteration in cold cache mode
+bench_result run_bench(const std::function<void()> &fn,
+                       int burning_iter,
+                       int iter);
+
+// peaks of this machine on all omp threads, measured once at first call
+struct machine_peak {
+  double gbps;  // memory bandwidth of copy
+  double gops;  // int8 multiply-add, each counts 2 ops
+  double gflops;  // f32 fma, each counts 2 ops
+  const char *isa;
+  int threads;  // measured on
+};
+const machine_peak &get_machine_peak();
+
+// "avg time: x ms, IPC x, x GB/s, x GOPS, x% of roofline"
+// bytes is the memory read and written in one iteration, ops is the int8
+// ops, or f32 ops if f32_ops, which is 0 for pure memory bound op. threads is
+// of the run, 0 for all omp threads; a run on fewer threads is compared with
+// their share of the machine peaks.
+std::string format_result(const bench_result &r,
+                          size_t bytes,
+                          size_t ops = 0,
+                          int threads = 0,
+                          bool f32_ops = false);
+
+// Print the result, and keep it as one record of the output file.
+// The record is keyed by name, shape, dtype and threads, so name should not
+// contain any number measured, which can be given as note.
+void report(const std::string &name,
+            const std::string &shape,
+            memory::dtype dt,
+            const bench_result &r,
+            size_t bytes,
+            size_t ops = 0,
+            const std::string &note = "",
+            int threads = 0,
+            bool f32_ops = false);
+
+// one deepfusion op with its own memories, filled with random data
+struct workload {
+  std::vector<std::unique_ptr<memory>> mems;  // must outlive the op
+  std::unique_ptr<op> func;
+  std::string name;   // like "DeepFusion Conv_ReLU"
+  std::string shape;  // like 1x64x56x56_64x3x3_s1x1_p1x1
+  memory::dtype dt;   // dst data type
+  size_t bytes;       // memory read and written once
+  size_t ops;         // int8 ops, or f32 ops if f32_ops
+  bool f32_ops;       // of f32 conv, compared with the f32 peak
+  int images;         // batch size
+};
+
+struct conv_params {
+  memory::nchw_dims src_dims;  // nchw
+  int oc, kh, kw, sh, sw, ph, pw;
+  int oc1x1;  // 0 if not fuse conv1x1
+
+  // like 1x64x56x56_64x3x3_s1x1_p1x1, with _1x1x<oc1x1> if fused
+  std::string shape() const;
+  // memory read and written once, with dst of dt, and f32 src and weights
+  // if f32_conv
+  size_t bytes(memory::dtype dt, bool f32_conv = false) const;
+  size_t ops() const;
+};
+
+// u8 src, s8 weights and f32 bias, with dst of dt,
+// or all in f32 if f32_conv, dt should be f32 then
+// the algo hint is only for the conv without conv1x1 fused
+std::unique_ptr<workload> make_conv(
+    const conv_params &p,
+    memory::dtype dt,
+    bool post_relu,
+    bool f32_conv = false,
+    conv_algorithm algo = conv_algorithm::direct);
+// srcs and dst in nhwc, all of dt
+std::unique_ptr<workload> make_concat(
+    const std::vector<memory::nchw_dims> &srcs_dims,
+    memory::dtype dt,
+    bool post_relu);
+
+// the same op of MKL-DNN for comparison, run by submitting the pipeline
+struct mkldnn_workload {
+  std::vector<mkldnn::memory> mems;
+  std::vector<mkldnn::primitive> pipeline;
+  void submit();
+};
+
+// fused conv1x1 runs as 2 convs, all outputs in nhwc
+// src and weights are all in f32 if f32_conv, dt should be f32 then
+std::unique_ptr<mkldnn_workload> make_mkldnn_conv(const conv_params &p,
+                                                  memory::dtype dt,
+                                                  bool post_relu,
+                                                  bool f32_conv = false);
+// concat then relu in place if post_relu
+std::unique_ptr<mkldnn_workload> make_mkldnn_concat(
+    const std::vector<memory::nchw_dims> &srcs_dims,
+    memory::dtype dt,
+    bool post_relu);
+
+// Write the records to -output file, and compare them with -compare file.
+// Return non-zero if any regression found, which can be returned by main.
+int finish();
+
+}
+}
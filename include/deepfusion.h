@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <array>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace deepfusion {
@@ -28,6 +29,7 @@ typedef float f32;
 typedef int32_t s32;
 typedef int8_t s8;
 typedef uint8_t u8;
+typedef uint16_t bf16;  // the upper half of f32, for storage only
 
 // Disable the copy and assignment operator for a class.
 #ifndef DISABLE_COPY_AND_ASSIGN
@@ -48,6 +50,20 @@ enum round_mode {
   down,
 };
 
+// algorithm hint of conv, falls back to direct if not supported
+enum conv_algorithm {
+  direct = 0,
+  winograd,  // int8 F(2x2, 3x3), 3x3 stride 1 only
+};
+
+// the padding is not counted by max, and counted as zeros by avg including
+// padding
+enum pooling_algorithm {
+  pooling_max = 0,
+  pooling_avg_include_padding,
+  pooling_avg_exclude_padding,
+};
+
 struct memory {
 public:
   enum format {
@@ -58,6 +74,7 @@ public:
     nhwc,
     OIhw4i16o4i,
     gOIhw4i16o4i,
+    OIhw16i16o,  // weights of f32 conv
   };
   typedef std::vector<int> dims;
   typedef std::array<int, 2> pair_dims;
@@ -69,6 +86,24 @@ public:
     s32,
     s8,
     u8,
+    bf16,  // stored in half size, computed in f32
+  };
+
+  // where the pages of the buffer are placed on NUMA machines
+  enum numa_policy {
+    numa_default = 0,  // by the system, usually on the node of first writer
+    numa_local,        // on the node of the thread constructing the memory
+    numa_interleave,   // interleaved on all nodes page by page
+    numa_bind,         // on the given numa_node
+    numa_first_touch,  // touched by all omp threads, split as the ops do
+  };
+
+  // pages backing the buffer
+  enum page_mode {
+    page_default = 0,  // by DEEPFUSION_HUGE_PAGE, for buffers of 2MB at least
+    page_small,        // 4KB pages
+    page_thp,          // 2MB aligned, with madvise(MADV_HUGEPAGE)
+    page_hugetlb,      // 2MB pages reserved in hugetlbfs, fallback to thp
   };
 
   // TODO: enable more format init
@@ -77,11 +112,31 @@ public:
   explicit memory(const nchw_dims &dm,
                   const format fmt,
                   const dtype dt,
-                  int alignment = 4096);
+                  int alignment = 4096,
+                  numa_policy numa = numa_default,
+                  int numa_node = 0,
+                  page_mode page = page_default);
+  explicit memory(const dims &dm,
+                  const format fmt,
+                  const dtype dt,
+                  int alignment = 4096,
+                  numa_policy numa = numa_default,
+                  int numa_node = 0,
+                  page_mode page = page_default);
+  // Wrap a buffer owned by the caller, without allocation or copy. The buffer
+  // must outlive the memory and the ops using it. Any alignment works, but
+  // 64 bytes aligned is the fastest, as streaming store needs it.
+  explicit memory(const nchw_dims &dm,
+                  const format fmt,
+                  const dtype dt,
+                  void *data);
   explicit memory(const dims &dm,
                   const format fmt,
                   const dtype dt,
-                  int alignment = 4096);
+                  void *data);
+  // Map a weights file written by save_weights, read-only and shared by all
+  // processes mapping it through page cache. The data must not be written.
+  explicit memory(const std::string &weights_file);
   ~memory();
   size_t size();
   size_t buffer_size();
@@ -90,18 +145,69 @@ public:
   dtype data_type() { return dt_; }
   format dim_format() { return fmt_; }
   void *data() { return data_; }
+  bool owns_data() { return owned_; }
 
 private:
-  void allocate_buffer(int alignment);
+  void wrap_buffer(void *data);
+  void allocate_buffer(int alignment,
+                       numa_policy numa,
+                       int numa_node,
+                       page_mode page);
   void *data_;
   dims dims_;
   nchw_dims std_dims_;  // nchw or oihw
   format fmt_;
   dtype dt_;
+  size_t allocated_size_;
+  page_mode page_;  // actually used
+  void *map_;       // of weights file, NULL if allocated
+  size_t map_size_;
+  bool pooled_;     // allocated from memory pool
+  bool owned_;      // false if wrapping the buffer of caller
 
   DISABLE_COPY_AND_ASSIGN(memory);
 };
 
+// The buffers of memory are cached for reuse by default, in the free lists
+// of the thread destroying them, by size classes. Reused buffers do not fault
+// again. It's not used for the memories with numa policy or huge pages.
+// export DEEPFUSION_MEMORY_POOL_MB=<MB> to limit the bytes cached by each
+// thread, 256 by default, 0 to disable the pool.
+// export DEEPFUSION_MEMORY_POOL_TOTAL_MB=<MB> to limit the bytes cached by
+// all threads, 1024 by default.
+struct memory_pool_stats {
+  size_t hits;    // allocations reusing a cached buffer
+  size_t misses;  // allocations from system
+  size_t bytes_in_use;
+  size_t peak_bytes_in_use;
+  size_t bytes_held;  // cached by all threads for reuse
+};
+memory_pool_stats get_memory_pool_stats();
+// free the buffers cached by the calling thread
+void release_memory_pool();
+
+// Pack s8 weights in oihw to OIhw4i16o4i, the format of conv weights, and
+// write to a file, which can be mapped by memory(weights_file).
+// oc and ic should be multiple of 16.
+bool save_weights(const std::string &weights_file,
+                  const s8 *oihw,
+                  const memory::nchw_dims &dims);
+
+// Fold the batch norm after conv into the scales and bias of conv:
+//   s = gamma / sqrt(var + eps)
+//   scales' = scales * s, bias' = bias + (beta - mean * s) / scales'
+// scales of size 1 or oc are replaced by the oc scales', and folded_bia is
+// a new f32 memory of bias', so nothing is rounded. bia can be null, and is
+// not changed. gamma should not be 0.
+bool fold_batch_norm(const std::unique_ptr<memory> &bia,
+                     std::unique_ptr<memory> &folded_bia,
+                     std::vector<float> &scales,
+                     const std::vector<float> &mean,
+                     const std::vector<float> &var,
+                     const std::vector<float> &gamma,
+                     const std::vector<float> &beta,
+                     float eps = 1e-5f);
+
 class op {
 public:
   explicit op() {}
@@ -113,9 +219,14 @@ protected:
   DISABLE_COPY_AND_ASSIGN(op);
 };
 
+// concat and fuse relu
+// when scales given, each input is requantized by its own scale first,
+// then the inputs can have different data type with dst
 std::unique_ptr<op> concat(const std::vector<std::unique_ptr<memory>> &srcs,
                            std::unique_ptr<memory> &dst,
-                           bool post_relu = false);
+                           bool post_relu = false,
+                           std::vector<float> scales = {},
+                           round_mode rmode = round_mode::nearest);
 
 // only conv
 std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
@@ -126,6 +237,48 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                          std::unique_ptr<memory> &dst,
                          bool conv0_relu = false,
                          std::vector<float> conv0_scales = {1.f},
+                         round_mode conv0_round_mode = round_mode::nearest,
+                         conv_algorithm algo = conv_algorithm::direct);
+
+// max or avg pooling, src and dst in nhwc of the same data type
+// dst size can be rounded down (as conv) or up (as caffe), padding should be
+// less than kernel, the kernel of the whole image is global pooling
+std::unique_ptr<op> pooling(const std::unique_ptr<memory> &src,
+                            std::unique_ptr<memory> &dst,
+                            std::array<int, 2> sz_kernel,
+                            std::array<int, 2> sz_stride,
+                            std::array<int, 2> sz_padding,
+                            pooling_algorithm alg = pooling_max,
+                            round_mode rmode = round_mode::nearest);
+
+// int8 inner product (fully connected) and fuse relu
+// wei has the same h and w as src, dst is {bs, oc, 1, 1}
+// ic should be multiple of 16, AVX512 only. The weights are padded to
+// whole blocks of 16 oc when oc is not.
+std::unique_ptr<op> inner_product(const std::unique_ptr<memory> &src,
+                                  const std::unique_ptr<memory> &wei,
+                                  const std::unique_ptr<memory> &bia,
+                                  std::unique_ptr<memory> &dst,
+                                  bool relu = false,
+                                  std::vector<float> scales = {1.f},
+                                  round_mode rmode = round_mode::nearest);
+
+// conv, batch norm and relu, the batch norm is folded into the conv0 scales
+// and bias by fold_batch_norm when created, the folded ones are kept by the
+// op and bia is not changed
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         std::unique_ptr<memory> &dst,
+                         const std::vector<float> &bn_mean,
+                         const std::vector<float> &bn_var,
+                         const std::vector<float> &bn_gamma,
+                         const std::vector<float> &bn_beta,
+                         float bn_eps,
+                         bool conv0_relu = false,
+                         std::vector<float> conv0_scales = {1.f},
                          round_mode conv0_round_mode = round_mode::nearest);
 
 // conv and fuse conv1x1_relu
@@ -143,4 +296,33 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                          bool conv1_relu = false,
                          std::vector<float> conv1_scales = {1.f},
                          round_mode conv1_round_mode = round_mode::nearest);
+
+// dilated (atrous) conv, dilation 1 is dense conv
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         std::array<int, 2> sz_dilation,
+                         std::unique_ptr<memory> &dst,
+                         bool conv0_relu = false,
+                         std::vector<float> conv0_scales = {1.f},
+                         round_mode conv0_round_mode = round_mode::nearest);
+
+// dilated conv and fuse conv1x1_relu
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         std::array<int, 2> sz_dilation,
+                         const std::unique_ptr<memory> &wei1x1,
+                         const std::unique_ptr<memory> &bia1x1,
+                         std::unique_ptr<memory> &dst,
+                         bool conv0_relu = false,
+                         std::vector<float> conv0_scales = {1.f},
+                         round_mode conv0_round_mode = round_mode::nearest,
+                         bool conv1_relu = false,
+                         std::vector<float> conv1_scales = {1.f},
+                         round_mode conv1_round_mode = round_mode::nearest);
 }
@@ -15,7 +15,11 @@ export MKL_NUM_THREADS=28
 taskset -c 0-27 numactl -l ./build/benchmark/bench_concat
 #echo 1 > /proc/sys/kernel/numa_balancing
 
-# 2 socket
+# throughput of 4 instances x 7 threads on 1 socket, pinned by the benchmark
+# unset KMP_AFFINITY
+# numactl -l ./build/benchmark/bench_multi_instance -instances 4 -threads 7 -cpus 0-27
+
+# 2 socket, numactl -l is not needed for the memories with numa policy
 # export OMP_NUM_THREADS=56
 # export MKL_NUM_THREADS=56
 # taskset -c 0-55 numactl -l ./build/benchmark/bench_concat
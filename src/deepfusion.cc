@@ -18,6 +18,14 @@
 #include "deepfusion_utils.h"
 #include "op_concat.h"
 #include "op_conv.h"
+#include "op_conv_winograd.h"
+#include "op_inner_product.h"
+#include "op_pooling.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "weights_file.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace deepfusion {
@@ -42,6 +50,14 @@ memory::dims nchw2format(const memory::nchw_dims &dm,
       out[3] = dm[3];
       break;
     case format::OIhw4i16o4i:
+      // O is padded to whole blocks of 16, the padded ones are never stored
+      out.resize(4);
+      out[0] = utils::div_up(dm[0], 16) * 16;
+      out[1] = dm[1];
+      out[2] = dm[2];
+      out[3] = dm[3];
+      return out;
+    case format::OIhw16i16o:
       out.resize(4);
       out[0] = dm[0];
       out[1] = dm[1];
@@ -56,29 +72,198 @@ memory::dims nchw2format(const memory::nchw_dims &dm,
   return out;
 }
 
+// the std dims of 1-d format x is {c, 1, 1, 1}
+memory::nchw_dims format2nchw(const memory::dims &dm,
+                              const memory::format fmt) {
+  using format = memory::format;
+  memory::nchw_dims out = {{1, 1, 1, 1}};
+  switch (fmt) {
+    case format::x:
+      check_eq(dm.size(), 1);
+      out[0] = dm[0];
+      break;
+    case format::nhwc:
+      check_eq(dm.size(), 4);
+      out[0] = dm[0];
+      out[1] = dm[3];
+      out[2] = dm[1];
+      out[3] = dm[2];
+      break;
+    case format::nchw:
+    case format::OIhw4i16o4i:
+    case format::OIhw16i16o:
+      check_eq(dm.size(), 4);
+      for (size_t i = 0; i < 4; ++i) {
+        out[i] = dm[i];
+      }
+      break;
+    default:
+      // std dims of other formats are not used yet
+      break;
+  }
+  return out;
+}
+
 memory::memory(const nchw_dims &dm,
                const format fmt,
                const dtype dt,
-               int alignment)
-    : std_dims_(dm), fmt_(fmt), dt_(dt) {
+               int alignment,
+               numa_policy numa,
+               int numa_node,
+               page_mode page)
+    : std_dims_(dm),
+      fmt_(fmt),
+      dt_(dt),
+      map_(NULL),
+      map_size_(0),
+      pooled_(false),
+      owned_(true) {
   dims_ = nchw2format(dm, fmt);
-  allocate_buffer(alignment);
+  allocate_buffer(alignment, numa, numa_node, page);
 }
 
 memory::memory(const dims &dm,
                const format fmt,
                const dtype dt,
-               int alignment)
-    : dims_(dm), fmt_(fmt), dt_(dt) {
-  allocate_buffer(alignment);
+               int alignment,
+               numa_policy numa,
+               int numa_node,
+               page_mode page)
+    : dims_(dm),
+      fmt_(fmt),
+      dt_(dt),
+      map_(NULL),
+      map_size_(0),
+      pooled_(false),
+      owned_(true) {
+  std_dims_ = format2nchw(dm, fmt);
+  allocate_buffer(alignment, numa, numa_node, page);
 }
 
-memory::~memory() { utils::aligned_free(data_); }
+memory::memory(const nchw_dims &dm,
+               const format fmt,
+               const dtype dt,
+               void *data)
+    : std_dims_(dm),
+      fmt_(fmt),
+      dt_(dt),
+      allocated_size_(0),
+      page_(page_small),
+      map_(NULL),
+      map_size_(0),
+      pooled_(false),
+      owned_(false) {
+  dims_ = nchw2format(dm, fmt);
+  wrap_buffer(data);
+}
+
+memory::memory(const dims &dm, const format fmt, const dtype dt, void *data)
+    : dims_(dm),
+      fmt_(fmt),
+      dt_(dt),
+      allocated_size_(0),
+      page_(page_small),
+      map_(NULL),
+      map_size_(0),
+      pooled_(false),
+      owned_(false) {
+  std_dims_ = format2nchw(dm, fmt);
+  wrap_buffer(data);
+}
+
+memory::memory(const std::string &weights_file)
+    : allocated_size_(0),
+      page_(page_small),
+      map_(NULL),
+      map_size_(0),
+      pooled_(false),
+      owned_(true) {
+  utils::weights_file_header hdr;
+  const void *data = utils::map_weights_file(
+      weights_file.c_str(), hdr, map_, map_size_);
+  if (data == NULL) {
+    error_and_exit("failed to map weights file %s", weights_file.c_str());
+  }
+  data_ = const_cast<void *>(data);
+  fmt_ = (format)hdr.format;
+  dt_ = (dtype)hdr.dtype;
+  dims_.assign(hdr.dims, hdr.dims + hdr.ndims);
+  std_dims_ = format2nchw(dims_, fmt_);
+}
 
-void memory::allocate_buffer(int alignment) {
+memory::~memory() {
+  if (!owned_) {
+    return;
+  } else if (map_ != NULL) {
+    utils::unmap_weights_file(map_, map_size_);
+  } else if (pooled_) {
+    utils::pool_free(data_, allocated_size_);
+  } else {
+    utils::page_free(data_, allocated_size_, page_);
+  }
+}
+
+void memory::wrap_buffer(void *data) {
   assert(buffer_size() > 0);
-  data_ = utils::aligned_malloc(buffer_size(), alignment);
+  if (data == NULL) {
+    error_and_exit("can not wrap NULL buffer");
+  }
+  data_ = data;
+  // the kernels load and store unaligned, only streaming store is disabled
+  if (reinterpret_cast<uintptr_t>(data) % 64 != 0) {
+    debug("buffer %p wrapped is not 64 bytes aligned", data);
+  }
+}
+
+void memory::allocate_buffer(int alignment,
+                             numa_policy numa,
+                             int numa_node,
+                             page_mode page) {
+  assert(buffer_size() > 0);
+  size_t sz = buffer_size();
+  if (numa != numa_default) {
+    // whole pages only, do not share any page with other buffers
+    alignment = std::max(alignment, utils::page_size);
+    sz = utils::div_up(sz, utils::page_size) * utils::page_size;
+  }
+  if (page == page_default) {
+    // not worth a huge page for small buffers
+    page = sz >= utils::huge_page_size ? utils::huge_page_mode() : page_small;
+  }
+  // the pages with numa policy or huge pages are not reused by others
+  if (numa == numa_default && page == page_small &&
+      alignment <= utils::page_size && utils::memory_pool_limit() > 0) {
+    page_ = page_small;
+    pooled_ = true;
+    data_ = utils::pool_malloc(sz);
+    allocated_size_ = sz;
+    assert(data_ != NULL);
+    return;
+  }
+  page_ = page;
+  data_ = utils::page_malloc(sz, alignment, page_);
+  allocated_size_ = sz;
   assert(data_ != NULL);
+
+  switch (numa) {
+    case numa_default:
+      break;
+    case numa_first_touch: {
+      // ops split the work by rows of the outer two dims, e.g. n and h of nhwc
+      int rows = dims_.size() >= 2 ? dims_[0] * dims_[1] : 1;
+      utils::first_touch(data_, sz, rows);
+      break;
+    }
+    default:
+      if (numa == numa_bind && (numa_node < 0 ||
+                                numa_node >= utils::numa_num_nodes())) {
+        error_and_exit("bad numa node %d", numa_node);
+      }
+      if (!utils::numa_place(data_, sz, numa, numa_node)) {
+        warning("failed to set numa policy %d of memory", numa);
+      }
+      break;
+  }
 }
 
 size_t memory::size() {
@@ -87,14 +272,103 @@ size_t memory::size() {
 
 size_t memory::buffer_size() { return size() * utils::dtype_size(dt_); }
 
+bool save_weights(const std::string &weights_file,
+                  const s8 *oihw,
+                  const memory::nchw_dims &dims) {
+  const int oc = dims[0], ic = dims[1], kh = dims[2], kw = dims[3];
+  if (oc % 16 != 0 || ic % 16 != 0) {
+    warning("oc %d and ic %d should be multiple of 16", oc, ic);
+    return false;
+  }
+  utils::weights_file_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.format = memory::format::OIhw4i16o4i;
+  hdr.dtype = memory::dtype::s8;
+  hdr.ndims = 4;
+  for (int i = 0; i < 4; ++i) {
+    hdr.dims[i] = dims[i];
+  }
+  hdr.data_size = (size_t)oc * ic * kh * kw;
+  std::vector<s8> packed(hdr.data_size);
+  utils::pack_OIhw4i16o4i(oihw, packed.data(), oc, ic, kh, kw);
+  return utils::write_weights_file(weights_file.c_str(), hdr, packed.data());
+}
+
+bool fold_batch_norm(const std::unique_ptr<memory> &bia,
+                     std::unique_ptr<memory> &folded_bia,
+                     std::vector<float> &scales,
+                     const std::vector<float> &mean,
+                     const std::vector<float> &var,
+                     const std::vector<float> &gamma,
+                     const std::vector<float> &beta,
+                     float eps) {
+  using dtype = memory::dtype;
+  const int oc = mean.size();
+  if (!utils::all_true(oc > 0,
+                       var.size() == mean.size(),
+                       gamma.size() == mean.size(),
+                       beta.size() == mean.size(),
+                       utils::one_of(scales.size(), 1UL, mean.size()))) {
+    warning("Batch norm and scales should be of the same oc %d", oc);
+    return false;
+  }
+  const dtype bias_dt = bia != nullptr ? bia->data_type() : dtype::f32;
+  if (bia != nullptr && bia->std_dims()[0] != oc) {
+    warning("Bias channel do not match");
+    return false;
+  }
+  if (!utils::one_of(bias_dt, dtype::f32, dtype::s32, dtype::s8, dtype::u8)) {
+    warning("Unsupported bias data type");
+    return false;
+  }
+
+  auto bias = [&](int o) -> double {
+    if (bia == nullptr) {
+      return 0;
+    }
+    switch (bias_dt) {
+      case dtype::s32: return ((const s32 *)bia->data())[o];
+      case dtype::s8: return ((const s8 *)bia->data())[o];
+      case dtype::u8: return ((const u8 *)bia->data())[o];
+      default: return ((const f32 *)bia->data())[o];
+    }
+  };
+
+  // f32 whatever the bias is, not to round or saturate bias'
+  std::vector<float> folded_scales(oc);
+  std::unique_ptr<memory> folded(
+      new memory(memory::dims({oc}), memory::format::x, dtype::f32));
+  for (int o = 0; o < oc; ++o) {
+    if (var[o] + eps <= 0.f) {
+      warning("Variance of oc %d should be positive", o);
+      return false;
+    }
+    const float s = gamma[o] / std::sqrt(var[o] + eps);
+    folded_scales[o] = scales[scales.size() > 1 ? o : 0] * s;
+    if (folded_scales[o] == 0.f) {
+      warning("Scale of oc %d is 0 after folding", o);
+      return false;
+    }
+    ((f32 *)folded->data())[o] =
+        bias(o) + (beta[o] - mean[o] * s) / folded_scales[o];
+  }
+  folded_bia = std::move(folded);
+  scales = folded_scales;
+  return true;
+}
+
 void op::submit() {
 #ifdef WITH_VERBOSE
   double t_start = 0;
-  if (utils_is_profiling()) {
+  if (utils::is_profiling()) {
     t_start = utils::get_current_ms();
   }
 #endif
-  infer();
+  {
+    utils::trace_scope trace(this->name());
+    utils::perf_scope perf(this->name());
+    infer();
+  }
 #ifdef WITH_VERBOSE
   if (utils::is_profiling()) {
     info("%s infer %f", this->name(), utils::get_current_ms() - t_start);
@@ -104,15 +378,19 @@ void op::submit() {
 
 std::unique_ptr<op> concat(const std::vector<std::unique_ptr<memory>> &srcs,
                            std::unique_ptr<memory> &dst,
-                           bool post_relu) {
+                           bool post_relu,
+                           std::vector<float> scales,
+                           round_mode rmode) {
   switch (dst->data_type()) {
-#define CASE(tp)          \
-  case memory::dtype::tp: \
-    return std::unique_ptr<op>(new op_concat<tp>(srcs, dst, post_relu))
+#define CASE(tp)                                   \
+  case memory::dtype::tp:                          \
+    return std::unique_ptr<op>(new op_concat<tp>(  \
+        srcs, dst, post_relu, scales, rmode))
     CASE(f32);
     CASE(s32);
     CASE(s8);
     CASE(u8);
+    CASE(bf16);
 #undef CASE
     default:
       assert(!"bad data_type");
@@ -125,6 +403,7 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                          const std::unique_ptr<memory> &bia,
                          std::array<int, 2> sz_stride,
                          std::array<int, 2> sz_padding,
+                         std::array<int, 2> sz_dilation,
                          const std::unique_ptr<memory> &wei1x1,
                          const std::unique_ptr<memory> &bia1x1,
                          std::unique_ptr<memory> &dst,
@@ -134,7 +413,41 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                          bool conv1_relu,
                          std::vector<float> conv1_scales,
                          round_mode conv1_round_mode) {
-  switch (dst->data_type()) {
+  const auto src_dt = src->data_type(), dst_dt = dst->data_type();
+  if (wei->data_type() == memory::dtype::f32 &&
+      utils::one_of(src_dt, memory::dtype::f32, memory::dtype::bf16)) {
+    // f32 conv, the bias and weights of 1x1 are f32, while src and dst can be
+    // stored in bf16
+#define F32_CONV(dst_t, src_t)                                             \
+    return std::unique_ptr<op>(new op_conv<dst_t, src_t>(src,              \
+                                                         wei,              \
+                                                         bia,              \
+                                                         sz_stride,        \
+                                                         sz_padding,       \
+                                                         sz_dilation,      \
+                                                         dst,              \
+                                                         conv0_scales,     \
+                                                         conv1_scales,     \
+                                                         wei1x1,           \
+                                                         bia1x1,           \
+                                                         conv0_relu,       \
+                                                         conv1_relu,       \
+                                                         conv0_round_mode, \
+                                                         conv1_round_mode))
+    const bool src_bf16 = src_dt == memory::dtype::bf16;
+    const bool dst_bf16 = dst_dt == memory::dtype::bf16;
+    if (src_bf16 && dst_bf16) {
+      F32_CONV(bf16, bf16);
+    } else if (src_bf16) {
+      F32_CONV(f32, bf16);
+    } else if (dst_bf16) {
+      F32_CONV(bf16, f32);
+    } else {
+      F32_CONV(f32, f32);
+    }
+#undef F32_CONV
+  }
+  switch (dst_dt) {
 #define CASE(tp)                                                 \
   case memory::dtype::tp:                                        \
     return std::unique_ptr<op>(new op_conv<tp>(src,              \
@@ -142,6 +455,7 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                                                bia,              \
                                                sz_stride,        \
                                                sz_padding,       \
+                                               sz_dilation,      \
                                                dst,              \
                                                conv0_scales,     \
                                                conv1_scales,     \
@@ -167,6 +481,7 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
                          const std::unique_ptr<memory> &bia,
                          std::array<int, 2> sz_stride,
                          std::array<int, 2> sz_padding,
+                         std::array<int, 2> sz_dilation,
                          std::unique_ptr<memory> &dst,
                          bool conv0_relu,
                          std::vector<float> conv0_scales,
@@ -176,6 +491,91 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
               bia,
               sz_stride,
               sz_padding,
+              sz_dilation,
+              nullptr,
+              nullptr,
+              dst,
+              conv0_relu,
+              conv0_scales,
+              conv0_round_mode);
+}
+
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         const std::unique_ptr<memory> &wei1x1,
+                         const std::unique_ptr<memory> &bia1x1,
+                         std::unique_ptr<memory> &dst,
+                         bool conv0_relu,
+                         std::vector<float> conv0_scales,
+                         round_mode conv0_round_mode,
+                         bool conv1_relu,
+                         std::vector<float> conv1_scales,
+                         round_mode conv1_round_mode) {
+  return conv(src,
+              wei,
+              bia,
+              sz_stride,
+              sz_padding,
+              {{1, 1}},
+              wei1x1,
+              bia1x1,
+              dst,
+              conv0_relu,
+              conv0_scales,
+              conv0_round_mode,
+              conv1_relu,
+              conv1_scales,
+              conv1_round_mode);
+}
+
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         std::unique_ptr<memory> &dst,
+                         bool conv0_relu,
+                         std::vector<float> conv0_scales,
+                         round_mode conv0_round_mode,
+                         conv_algorithm algo) {
+  if (algo == conv_algorithm::winograd) {
+    jit::jit_wino_conf_t jcp;
+    if (jit::winograd_init_conf(jcp,
+                                src,
+                                wei,
+                                bia,
+                                sz_stride,
+                                sz_padding,
+                                dst,
+                                conv0_scales,
+                                conv0_relu,
+                                conv0_round_mode)) {
+      switch (dst->data_type()) {
+#define CASE(tp)                                                 \
+  case memory::dtype::tp:                                        \
+    return std::unique_ptr<op>(new op_conv_winograd<tp>(         \
+        src, wei, bia, sz_stride, sz_padding, dst, conv0_scales, \
+        conv0_relu, conv0_round_mode))
+        CASE(f32);
+        CASE(s32);
+        CASE(s8);
+        CASE(u8);
+#undef CASE
+        default:
+          break;
+      }
+    }
+    info("Winograd is not supported, fall back to direct conv");
+  }
+  return conv(src,
+              wei,
+              bia,
+              sz_stride,
+              sz_padding,
+              {{1, 1}},
               nullptr,
               nullptr,
               dst,
@@ -184,4 +584,105 @@ std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
               conv0_round_mode);
 }
 
+// the op with a memory only used by it, like the folded bias
+class op_with_memory : public op {
+public:
+  op_with_memory(std::unique_ptr<memory> mem, std::unique_ptr<op> op)
+      : mem_(std::move(mem)), op_(std::move(op)) {}
+  void submit() override { op_->submit(); }
+
+protected:
+  void infer() override { assert(!"submitted by the op held"); }
+  const char *name() override { return "op_with_memory"; }
+
+private:
+  std::unique_ptr<memory> mem_;  // destroyed after op_
+  std::unique_ptr<op> op_;
+};
+
+std::unique_ptr<op> conv(const std::unique_ptr<memory> &src,
+                         const std::unique_ptr<memory> &wei,
+                         const std::unique_ptr<memory> &bia,
+                         std::array<int, 2> sz_stride,
+                         std::array<int, 2> sz_padding,
+                         std::unique_ptr<memory> &dst,
+                         const std::vector<float> &bn_mean,
+                         const std::vector<float> &bn_var,
+                         const std::vector<float> &bn_gamma,
+                         const std::vector<float> &bn_beta,
+                         float bn_eps,
+                         bool conv0_relu,
+                         std::vector<float> conv0_scales,
+                         round_mode conv0_round_mode) {
+  std::unique_ptr<memory> folded_bia;
+  if (!fold_batch_norm(bia,
+                       folded_bia,
+                       conv0_scales,
+                       bn_mean,
+                       bn_var,
+                       bn_gamma,
+                       bn_beta,
+                       bn_eps)) {
+    error_and_exit("Fold batch norm failed!");
+  }
+  // the op keeps the folded scales itself
+  auto c = conv(src,
+                wei,
+                folded_bia,
+                sz_stride,
+                sz_padding,
+                dst,
+                conv0_relu,
+                conv0_scales,
+                conv0_round_mode);
+  return std::unique_ptr<op>(
+      new op_with_memory(std::move(folded_bia), std::move(c)));
+}
+
+std::unique_ptr<op> pooling(const std::unique_ptr<memory> &src,
+                            std::unique_ptr<memory> &dst,
+                            std::array<int, 2> sz_kernel,
+                            std::array<int, 2> sz_stride,
+                            std::array<int, 2> sz_padding,
+                            pooling_algorithm alg,
+                            round_mode rmode) {
+  switch (dst->data_type()) {
+#define CASE(tp)                                                 \
+  case memory::dtype::tp:                                        \
+    return std::unique_ptr<op>(new op_pooling<tp>(               \
+        src, dst, sz_kernel, sz_stride, sz_padding, alg, rmode))
+    CASE(f32);
+    CASE(s32);
+    CASE(s8);
+    CASE(u8);
+#undef CASE
+    default:
+      assert(!"bad data_type");
+  }
+  return nullptr;
+}
+
+std::unique_ptr<op> inner_product(const std::unique_ptr<memory> &src,
+                                  const std::unique_ptr<memory> &wei,
+                                  const std::unique_ptr<memory> &bia,
+                                  std::unique_ptr<memory> &dst,
+                                  bool relu,
+                                  std::vector<float> scales,
+                                  round_mode rmode) {
+  switch (dst->data_type()) {
+#define CASE(tp)                                         \
+  case memory::dtype::tp:                                \
+    return std::unique_ptr<op>(new op_inner_product<tp>( \
+        src, wei, bia, dst, scales, relu, rmode))
+    CASE(f32);
+    CASE(s32);
+    CASE(s8);
+    CASE(u8);
+#undef CASE
+    default:
+      assert(!"bad data_type");
+  }
+  return nullptr;
+}
+
 }
@@ -25,11 +25,15 @@ enum conv_loop_order_t { loop_cgn, loop_gnc, loop_ngc };
 
 namespace jit {
 
+// max inputs when concat requantizes inputs, as each input is unrolled in JIT
+constexpr int concat_max_inputs = 32;
+
 // concat with optional relu fusion
 struct jit_concat_call_t {
   const void **src;
   const int  *nb_ic;
   const void *dst;
+  const float *scales;  // one scale per input, only used with_scales
 };
 
 struct jit_concat_conf_t {
@@ -42,6 +46,12 @@ struct jit_concat_conf_t {
   int           block;      // u8: 64, s32: 16
   int           bits_size;  // 128, 256, 512 : xmm, ymm, zmm
   bool          with_relu;
+  bool          use_nt_store;  // non-temporal store to dst
+  // requantize each input by its own scale before concat, then the inputs
+  // can have different data type with dst
+  bool          with_scales;
+  round_mode    rmode;
+  memory::dtype src_dt[concat_max_inputs];
 };
 
 // convreluconv1x1relu
@@ -70,7 +80,8 @@ struct jit_conv_conf_t {
   int ih, iw, oh, ow;
   int kh, kw;
   int sh, sw;
-  int l_pad, t_pad;  // left, top padding
+  int dilate_h, dilate_w;  // 0 if not dilated
+  int l_pad, t_pad;        // left, top padding
   int ic_block, oc_block;
   int nb_ic, nb_oc;
   // @note: nc_ic==(nb_ic_blocking * ic_chunk)
@@ -81,7 +92,7 @@ struct jit_conv_conf_t {
   int typesize_acc;
   int typesize_conv0_bia;
   int typesize_conv1_bia;
-  memory::dtype dst_dt, conv0_bias_dt, conv1_bias_dt;
+  memory::dtype src_dt, dst_dt, conv0_bias_dt, conv1_bias_dt;
   round_mode conv0_round_mode, conv1_round_mode;
   conv_loop_order_t loop_order;
   /* conv 1x1*/
@@ -96,8 +107,102 @@ struct jit_conv_conf_t {
   bool conv1_with_bias;
   bool conv0_multi_oc_scale;  // whether use multi channel to scale oc
   bool conv1_multi_oc_scale;
+  bool use_nt_store;  // non-temporal store to dst
+  // prefetch distances in bytes, 0 means no prefetch
+  int prf_inp_dist;     // input rows of next call, prefetcht1
+  int prf_wei_dist;     // weights of next ic chunk, prefetcht1
+  int prf_wei1x1_dist;  // 1x1 weights of next oc1x1 block, prefetcht0
 };
 
+// int8 winograd F(2x2, 3x3), each tile of 4x4 input gives 2x2 output.
+// The transformed src, weights and gemm output are (16, tiles, c) where 16
+// is the elements of one tile, so there are 16 independent gemms.
+struct jit_wino_call_t {
+  const void **src;      // 16 input pixels of one tile, zeros in padding
+  const void **dst;      // 4 output pixels of one tile, scratch if out of dst
+  const void *wino_src;  // s16, (16, tiles, ic)
+  const void *wino_wei;  // s16, (16, oc/16, ic/2, 16o, 2i), at the oc chunk
+  const void *wino_dst;  // s32, (16, tiles, oc of the chunk)
+  const void *bia;       // at the oc chunk, as scales
+  const void *scales;
+};
+
+struct jit_wino_conf_t {
+  int bs;
+  int ic, oc;
+  int ih, iw, oh, ow;
+  int t_pad, l_pad;
+  int tile_h, tile_w;      // tiles of one image
+  int ic_block, oc_block;  // 32 ic as s16 in zmm, 16 oc as s32
+  int nb_ic, nb_oc;
+  int nb_oc_blocking;
+  int nb_oc_chunk, oc_chunks;  // oc blocks of each work, and works of all oc
+  int ur_t, ur_t_tail;  // tiles of one gemm block
+  int typesize_out;
+  int typesize_bia;
+  memory::dtype dst_dt, bias_dt;
+  round_mode rmode;
+  bool use_vnni;
+  bool with_bias;
+  bool with_relu;
+  bool multi_oc_scale;
+};
+
+// int8 inner product, as a conv whose kernel covers the whole src image.
+// Each call computes ur_n rows of the batch and nb_oc_blocking oc blocks.
+struct jit_ip_call_t {
+  const void *src;
+  const void *wei;
+  const void *bia;
+  const void *scales;
+  const void *dst;
+};
+
+struct jit_ip_conf_t {
+  int bs;
+  int ic, ih, iw;  // weights are OIhw4i16o4i of the same ih and iw
+  int oc;
+  int oc_tail;  // oc of the last partial oc block, 0 if none
+  int ic_block, oc_block;
+  int nb_ic, nb_oc;
+  int nb_ic_blocking;  // unrolled ic blocks when ih and iw are 1
+  int nb_oc_blocking;
+  int ur_n, ur_n_tail;  // batch rows of one call
+  int typesize_out;
+  int typesize_bia;
+  memory::dtype dst_dt, bias_dt;
+  round_mode rmode;
+  bool use_vnni;
+  bool with_bias;
+  bool with_relu;
+  bool multi_oc_scale;
+};
+
+// pooling of ur_c channel blocks of one output pixel, the window is clipped
+// to the image by caller
+struct jit_pooling_call_t {
+  const void *src;  // the first pixel of the window in image
+  const void *dst;
+  int kh, kw;       // pixels of the window in image
+  float divisor;    // of avg
+};
+
+struct jit_pooling_conf_t {
+  int bs;
+  int ih, iw, c;
+  int oh, ow;
+  int kh, kw;
+  int sh, sw;
+  int t_pad, l_pad;
+  pooling_algorithm alg;
+  memory::dtype dt;
+  int typesize;
+  int block;      // channels of one vector
+  int nb_c;
+  int ur_c;       // blocks of one call
+  int bits_size;  // 128, 256, 512 : xmm, ymm, zmm
+  round_mode rmode;
+};
 
 }
 }
@@ -34,49 +34,56 @@ void jit_concat_kernel::compute_one_input() {
   mov(reg_ptr_src_i, ptr[reg_ptr_src]);
   L(l_next_block);
   {
-    auto src_addr = EVEX_compress_addr(reg_ptr_src_i, 0);
-    auto dst_addr = EVEX_compress_addr(reg_ptr_dst, 0);
+    auto src_addr = ptr[reg_ptr_src_i];
+    auto dst_addr = ptr[reg_ptr_dst];
     // load, relu and store
     switch (jcp_.bits_size) {
       case USE_ZMM:
         vmovups(zmm_src, src_addr);
         if (jcp_.with_relu) {
           if (jcp_.dt == memory::dtype::s32) {
-            vpmaxsw(zmm_src, zmm_src, zmm_zero);
+            vpmaxsd(zmm_src, zmm_src, zmm_zero);
           } else if (jcp_.dt == memory::dtype::f32) {
             vmaxps(zmm_src, zmm_zero, zmm_src);
+          } else if (jcp_.dt == memory::dtype::bf16) {
+            // the sign bit of bf16 is the sign of s16
+            vpmaxsw(zmm_src, zmm_src, zmm_zero);
           } else {  // s8 or u8
             vpmaxsb(zmm_src, zmm_src, zmm_zero);
           }
         }
-        vmovups(dst_addr, zmm_src);
+        uni_vmovups(dst_addr, zmm_src, jcp_.use_nt_store);
         break;
       case USE_YMM:
         vmovups(ymm_src, src_addr);
         if (jcp_.with_relu) {
           if (jcp_.dt == memory::dtype::s32) {
-            vpmaxsw(ymm_src, ymm_src, ymm_zero);
+            vpmaxsd(ymm_src, ymm_src, ymm_zero);
           } else if (jcp_.dt == memory::dtype::f32) {
             vmaxps(ymm_src, ymm_zero, ymm_src);
+          } else if (jcp_.dt == memory::dtype::bf16) {
+            vpmaxsw(ymm_src, ymm_src, ymm_zero);
           } else {  // s8 or u8
             vpmaxsb(ymm_src, ymm_src, ymm_zero);
           }
         }
-        vmovups(dst_addr, ymm_src);
+        uni_vmovups(dst_addr, ymm_src, jcp_.use_nt_store);
         break;
       case USE_XMM:
         vmovups(xmm_src, src_addr);
         // maybe relu
         if (jcp_.with_relu) {
           if (jcp_.dt == memory::dtype::s32) {
-            vpmaxsw(xmm_src, xmm_src, xmm_zero);
+            vpmaxsd(xmm_src, xmm_src, xmm_zero);
           } else if (jcp_.dt == memory::dtype::f32) {
             vmaxps(xmm_src, xmm_zero, xmm_src);
+          } else if (jcp_.dt == memory::dtype::bf16) {
+            vpmaxsw(xmm_src, xmm_src, xmm_zero);
           } else {  // s8 or u8
             vpmaxsb(xmm_src, xmm_src, xmm_zero);
           }
         }
-        vmovups(dst_addr, xmm_src);
+        uni_vmovups(dst_addr, xmm_src, jcp_.use_nt_store);
         break;
       default:
         assert(!"Bad bits size.");
@@ -90,6 +97,107 @@ void jit_concat_kernel::compute_one_input() {
   }
 }
 
+// requantize one block per step: cvt src to f32, scale, relu, cvt to dst
+// the block is 16 channels on zmm, or 8 channels on ymm
+void jit_concat_kernel::compute_one_input_with_scales(int idx) {
+  using data_type = memory::dtype;
+  Label l_next_block;
+  const bool is_zmm = jcp_.bits_size == USE_ZMM;
+  const Xmm &vmm_src = is_zmm ? static_cast<const Xmm &>(zmm_src) : ymm_src;
+  const Xmm &vmm_zero = is_zmm ? static_cast<const Xmm &>(zmm_zero) : ymm_zero;
+  const Xmm &vmm_scale =
+      is_zmm ? static_cast<const Xmm &>(zmm_scale) : ymm_scale;
+  const Xmm &vmm_tmp1 = is_zmm ? static_cast<const Xmm &>(zmm_tmp1) : ymm_tmp1;
+  const Xmm &vmm_tmp2 = is_zmm ? static_cast<const Xmm &>(zmm_tmp2) : ymm_tmp2;
+  const auto src_dt = jcp_.src_dt[idx];
+  int shift_src = utils::dtype_size(src_dt) * jcp_.block;
+  int shift_dst = jcp_.typesize * jcp_.block;
+  mov(reg_nb, dword[reg_ptr_nb_ic]);
+  mov(reg_ptr_src_i, ptr[reg_ptr_src]);
+  vbroadcastss(vmm_scale, ptr[reg_ptr_scales + idx * sizeof(float)]);
+  L(l_next_block);
+  {
+    auto src_addr = ptr[reg_ptr_src_i];
+    auto dst_addr = ptr[reg_ptr_dst];
+    switch (src_dt) {
+      case data_type::f32:
+        vmovups(vmm_src, src_addr);
+        break;
+      case data_type::s32:
+        vcvtdq2ps(vmm_src, src_addr);
+        break;
+      case data_type::s8:
+        vpmovsxbd(vmm_src, src_addr);
+        vcvtdq2ps(vmm_src, vmm_src);
+        break;
+      case data_type::u8:
+        vpmovzxbd(vmm_src, src_addr);
+        vcvtdq2ps(vmm_src, vmm_src);
+        break;
+      case data_type::bf16:
+        load_bf16(vmm_src, src_addr);
+        break;
+      default:
+        assert(!"unsupported src data type");
+    }
+    vmulps(vmm_src, vmm_src, vmm_scale);
+    if (jcp_.with_relu || jcp_.dt == data_type::u8) {
+      vmaxps(vmm_src, vmm_zero, vmm_src);
+    }
+    if (!utils::one_of(jcp_.dt, data_type::f32, data_type::bf16)) {
+      assert(utils::one_of(jcp_.rmode, round_mode::nearest, round_mode::down));
+      if (is_zmm) {
+        if (jcp_.rmode == round_mode::nearest)
+          vcvtps2dq(zmm_src | T_rn_sae, zmm_src);
+        else
+          vcvtps2dq(zmm_src | T_rd_sae, zmm_src);
+      } else {
+        vroundps(ymm_src, ymm_src, jcp_.rmode == round_mode::nearest ? 0 : 1);
+        vcvtps2dq(ymm_src, ymm_src);
+      }
+    }
+    switch (jcp_.dt) {
+      case data_type::f32:
+      case data_type::s32:
+        uni_vmovups(dst_addr, vmm_src, jcp_.use_nt_store);
+        break;
+      case data_type::s8:
+      case data_type::u8:
+        if (is_zmm) {
+          if (jcp_.dt == data_type::s8) {
+            vpmovsdb(xmm_src, zmm_src);
+          } else {
+            vpmovusdb(xmm_src, zmm_src);
+          }
+          uni_vmovups(dst_addr, xmm_src, jcp_.use_nt_store);
+        } else {
+          // packs work in each 128 bits lane, get 8 x s16 in low lane first
+          vpackssdw(ymm_src, ymm_src, ymm_src);
+          vpermq(ymm_src, ymm_src, 0xD8);
+          if (jcp_.dt == data_type::s8) {
+            vpacksswb(ymm_src, ymm_src, ymm_src);
+          } else {
+            vpackuswb(ymm_src, ymm_src, ymm_src);
+          }
+          vmovq(dst_addr, xmm_src);
+        }
+        break;
+      case data_type::bf16:
+        cvt_f32_to_bf16(vmm_src, vmm_tmp1, vmm_tmp2);
+        store_bf16(dst_addr, vmm_src, jcp_.use_nt_store);
+        break;
+      default:
+        assert(!"unsupported dst data type");
+    }
+
+    add(reg_ptr_src_i, shift_src);
+    add(reg_ptr_dst, shift_dst);
+    dec(reg_nb);
+    cmp(reg_nb, 0);
+    jg(l_next_block, T_NEAR);
+  }
+}
+
 void jit_concat_kernel::generate() {
   preamble();
 
@@ -98,15 +206,36 @@ void jit_concat_kernel::generate() {
   mov(reg_ptr_nb_ic, ptr[param + GET_OFF(nb_ic)]);
   mov(reg_ptr_dst, ptr[param + GET_OFF(dst)]);
 
+  if (jcp_.with_scales) {
+    // inputs may have different data types, so unroll all inputs
+    mov(reg_ptr_scales, ptr[param + GET_OFF(scales)]);
+    if (jcp_.bits_size == USE_ZMM) {
+      vpxord(zmm_zero, zmm_zero, zmm_zero);
+    } else {
+      vpxor(ymm_zero, ymm_zero, ymm_zero);
+    }
+    for (int i = 0; i < jcp_.n_inputs; ++i) {
+      compute_one_input_with_scales(i);
+      add(reg_ptr_src, sizeof(void*));
+      add(reg_ptr_nb_ic, sizeof(int));
+    }
+    if (jcp_.use_nt_store) {
+      sfence();
+    }
+    vzeroupper();
+    postamble();
+    return;
+  }
+
   switch (jcp_.bits_size) {
     case USE_ZMM:
       vpxord(zmm_zero, zmm_zero, zmm_zero);
       break;
     case USE_YMM:
-      vpxord(ymm_zero, ymm_zero, ymm_zero);
+      vpxor(ymm_zero, ymm_zero, ymm_zero);
       break;
     case USE_XMM:
-      vpxord(xmm_zero, xmm_zero, xmm_zero);
+      vpxor(xmm_zero, xmm_zero, xmm_zero);
       break;
     default:
       assert(!"Bad bits size.");
@@ -124,6 +253,11 @@ void jit_concat_kernel::generate() {
     jl(l_next_input, T_NEAR);
   }
 
+  if (jcp_.use_nt_store) {
+    // make the non-temporal stores globally visible
+    sfence();
+  }
+  vzeroupper();
   postamble();
 }
 
@@ -131,11 +265,17 @@ bool jit_concat_kernel::init_conf(
     jit_concat_conf_t& jcp,
     const std::vector<std::unique_ptr<memory>>& srcs,
     const std::unique_ptr<memory>& dst,
-    bool post_relu) {
-  jcp = utils::zero<decltype(jcp)>();
+    bool post_relu,
+    const std::vector<float>& scales,
+    round_mode rmode) {
+  using namespace utils;
+  jcp = zero<decltype(jcp)>();
 
   jcp.n_inputs = srcs.size();
   jcp.with_relu = post_relu;
+  jcp.with_scales = !scales.empty();
+  jcp.rmode = rmode;
+  jcp.use_nt_store = use_streaming_store(dst);
   auto dm = dst->actual_dims();
   jcp.bs = dm[0];
   jcp.h = dm[1];
@@ -143,8 +283,8 @@ bool jit_concat_kernel::init_conf(
   jcp.oc = dm[3];
   jcp.dt = dst->data_type();
   jcp.typesize = utils::dtype_size(jcp.dt);
-  if (!utils::one_of(jcp.typesize, 1, 4)) {
-    // only s8, u8, s32, f32
+  if (!utils::one_of(jcp.typesize, 1, 2, 4)) {
+    // only s8, u8, bf16, s32, f32
     return false;
   }
   if (!utils::one_of(dst->dim_format(), memory::format::nhwc)) {
@@ -152,14 +292,55 @@ bool jit_concat_kernel::init_conf(
     return false;
   }
 
+  if (!mayiuse(avx2)) {
+    return false;
+  }
+
+  if (jcp.with_scales) {
+    if (!all_true(scales.size() == srcs.size(),
+                  jcp.n_inputs <= concat_max_inputs,
+                  one_of(jcp.rmode, round_mode::nearest, round_mode::down))) {
+      return false;
+    }
+    // requantize 16 channels one step on zmm, or 8 channels on ymm
+    if (mayiuse(avx512_core)) {
+      jcp.block = 16;
+      jcp.bits_size = USE_ZMM;
+    } else {
+      jcp.block = 8;
+      jcp.bits_size = USE_YMM;
+    }
+    for (size_t i = 0; i < srcs.size(); ++i) {
+      jcp.src_dt[i] = srcs[i]->data_type();
+      if (!all_true(srcs[i]->dim_format() == dst->dim_format(),
+                    one_of(jcp.src_dt[i],
+                           memory::dtype::f32,
+                           memory::dtype::s32,
+                           memory::dtype::s8,
+                           memory::dtype::u8,
+                           memory::dtype::bf16),
+                    srcs[i]->actual_dims()[3] % jcp.block == 0)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   // when 4bytes, work on 16x, 8x or 4x channels
+  // when 2bytes (bf16), work on 32x, 16x or 8x channels
   // when 1byte, work on 64x, 32x, 16x channels
+  // zmm is only used when avx512 is available
   std::vector<int> blocks;
   if (jcp.typesize == 1) {
     blocks = {64, 32, 16};
+  } else if (jcp.typesize == 2) {
+    blocks = {32, 16, 8};
   } else {  // typesize == 4
     blocks = {16, 8, 4};
   }
+  if (!mayiuse(avx512_core)) {
+    blocks.erase(blocks.begin());
+  }
   for (size_t k = 0; k < blocks.size(); ++k) {
     jcp.block = blocks[k];
     size_t i;
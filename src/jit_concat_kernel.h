@@ -33,7 +33,9 @@ struct jit_concat_kernel : public jit_generator {
   static bool init_conf(jit_concat_conf_t& jcp,
                         const std::vector<std::unique_ptr<memory>>& srcs,
                         const std::unique_ptr<memory>& dst,
-                        bool post_relu);
+                        bool post_relu,
+                        const std::vector<float>& scales = {},
+                        round_mode rmode = round_mode::nearest);
 
   jit_concat_conf_t jcp_;
   void (*jit_ker_)(jit_concat_call_t*);
@@ -57,16 +59,26 @@ private:
   reg64_t reg_ptr_dst = r10;
   reg64_t reg_ptr_src_i = r11;
   reg64_t reg_ninputs = r12;
+  reg64_t reg_ptr_scales = r13;
   reg32_t reg_nb = r15d;
 
-  xmm_t xmm_src = xmm_t(30);
-  ymm_t ymm_src = ymm_t(30);
+  // xmm and ymm use the low 16 registers, which can be encoded by VEX on avx2
+  xmm_t xmm_src = xmm_t(14);
+  ymm_t ymm_src = ymm_t(14);
   zmm_t zmm_src = zmm_t(30);
-  xmm_t xmm_zero = xmm_t(31);
-  ymm_t ymm_zero = ymm_t(31);
+  xmm_t xmm_zero = xmm_t(15);
+  ymm_t ymm_zero = ymm_t(15);
   zmm_t zmm_zero = zmm_t(31);
+  ymm_t ymm_scale = ymm_t(13);
+  zmm_t zmm_scale = zmm_t(29);
+  // to round f32 to bf16
+  ymm_t ymm_tmp1 = ymm_t(11);
+  ymm_t ymm_tmp2 = ymm_t(12);
+  zmm_t zmm_tmp1 = zmm_t(27);
+  zmm_t zmm_tmp2 = zmm_t(28);
 
   void compute_one_input();
+  void compute_one_input_with_scales(int idx);
   void generate();
 };
 
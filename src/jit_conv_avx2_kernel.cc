@@ -0,0 +1,540 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "jit_conv_avx2_kernel.h"
+#include "jit_conv_kernel.h"
+#include "deepfusion_utils.h"
+
+#define GET_OFF(field) offsetof(jit_conv_call_t, field)
+
+namespace deepfusion {
+namespace jit {
+
+using namespace Xbyak;
+
+void jit_conv_avx2_kernel::compute(ymm_t &vreg_acc,
+                                   const Address &wei,
+                                   ymm_t &vreg_src) {
+  vpmaddubsw(ymm_tmp, vreg_src, wei);
+  vpmaddwd(ymm_tmp, ymm_tmp, ymm_one);
+  vpaddd(vreg_acc, vreg_acc, ymm_tmp);
+}
+
+// load 8 bias to ymm_bias as f32
+void jit_conv_avx2_kernel::load_bias(const Reg64 &reg_ptr,
+                                     int offset,
+                                     memory::dtype bias_dt) {
+  using data_type = memory::dtype;
+  auto bias_addr = ptr[reg_ptr + offset];
+  switch (bias_dt) {
+    case data_type::f32:
+    case data_type::s32:
+      vmovups(ymm_bias, bias_addr);
+      break;
+    case data_type::s8:
+      vpmovsxbd(ymm_bias, bias_addr);
+      break;
+    case data_type::u8:
+      vpmovzxbd(ymm_bias, bias_addr);
+      break;
+    default:
+      assert(!"unsupported bias data type");
+  }
+  if (bias_dt != data_type::f32) {
+    vcvtdq2ps(ymm_bias, ymm_bias);
+  }
+}
+
+// s32 acc to f32, then add bias, scale, relu and round to s32 if dst is int
+void jit_conv_avx2_kernel::cvt_to_dst(const ymm_t &ymm,
+                                      bool with_bias,
+                                      bool with_relu,
+                                      round_mode rmode,
+                                      memory::dtype dst_dt) {
+  vcvtdq2ps(ymm, ymm);
+  if (with_bias) {
+    vaddps(ymm, ymm, ymm_bias);
+  }
+  vmulps(ymm, ymm, ymm_scales);
+  if (with_relu) {
+    vmaxps(ymm, ymm_zero, ymm);
+  }
+  if (dst_dt != memory::dtype::f32) {
+    if (rmode == round_mode::nearest)
+      vroundps(ymm, ymm, 0);
+    else if (rmode == round_mode::down)
+      vroundps(ymm, ymm, 1);
+    else
+      assert(!"unimplemented");
+    vcvtps2dq(ymm, ymm);
+  }
+}
+
+// pack 2 x 8 s32 to 16 x u8/s8 with saturation, result in xmm of ymm_dst
+void jit_conv_avx2_kernel::pack_to_u8s8(const ymm_t &ymm_lo,
+                                        const ymm_t &ymm_hi,
+                                        const ymm_t &ymm_dst,
+                                        bool is_signed) {
+  // packs work in each 128 bits lane, permute qwords back to order
+  vpackssdw(ymm_dst, ymm_lo, ymm_hi);
+  vpermq(ymm_dst, ymm_dst, 0xD8);
+  if (is_signed) {
+    vpacksswb(ymm_dst, ymm_dst, ymm_dst);
+  } else {
+    vpackuswb(ymm_dst, ymm_dst, ymm_dst);
+  }
+  vpermq(ymm_dst, ymm_dst, 0xD8);
+}
+
+void jit_conv_avx2_kernel::prepare_1x1output(int ur_w) {
+  Label l_first_load, l_ret;
+  mov(reg_ocb3x3, ptr[param1 + GET_OFF(ocb3x3)]);
+  cmp(reg_ocb3x3, 0);  // FISRT load
+  je(l_first_load, T_NEAR);
+
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      // acc1x1 format is (oc1x1/16, ow, 16o)
+      int offset = jcp.typesize_acc * j * jcp.oc1x1_block + h * half_bytes;
+      vmovups(ymm_1x1out(j, h), ptr[aux_reg_ptr_acc1x1 + offset]);
+    }
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_first_load);
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      ymm_t ymm = ymm_1x1out(j, h);
+      vpxor(ymm, ymm, ymm);
+    }
+  }
+
+  L(l_ret);
+}
+
+void jit_conv_avx2_kernel::store_1x1output(int ur_w, int ocb1x1) {
+  using data_type = memory::dtype;
+  Label l_update_acc, l_ret;
+  mov(reg_ocb3x3, ptr[param1 + GET_OFF(ocb3x3)]);
+  cmp(reg_ocb3x3, jcp.nb_oc - 1);  // LAST channel
+  jl(l_update_acc, T_NEAR);
+
+  mov(reg_ptr_bia1x1, ptr[param1 + GET_OFF(bia1x1)]);
+  mov(reg_ptr_scales1x1, ptr[param1 + GET_OFF(scales1x1)]);
+  vpxor(ymm_zero, ymm_zero, ymm_zero);
+  const int oc_half = jcp.oc1x1_block / n_halves;
+  for (int h = 0; h < n_halves; h++) {
+    int oc_off = ocb1x1 * jcp.oc1x1_block + h * oc_half;
+    if (jcp.conv1_with_bias) {
+      load_bias(reg_ptr_bia1x1, jcp.typesize_conv1_bia * oc_off,
+                jcp.conv1_bias_dt);
+    }
+    if (jcp.conv1_multi_oc_scale) {
+      vmovups(ymm_scales, ptr[reg_ptr_scales1x1 + sizeof(float) * oc_off]);
+    } else {
+      vbroadcastss(ymm_scales, ptr[reg_ptr_scales1x1]);
+    }
+    for (int jw = 0; jw < ur_w; jw++) {
+      cvt_to_dst(ymm_1x1out(jw, h),
+                 jcp.conv1_with_bias,
+                 jcp.conv1_with_relu || jcp.dst_dt == data_type::u8,
+                 jcp.conv1_round_mode,
+                 jcp.dst_dt);
+    }
+  }
+
+  for (int jw = 0; jw < ur_w; jw++) {
+    // out format is nhw,c/16,16o
+    int offset = jcp.typesize_out * (jw * jcp.oc1x1 + ocb1x1 * jcp.oc1x1_block);
+    switch (jcp.dst_dt) {
+      case data_type::f32:
+      case data_type::s32:
+        for (int h = 0; h < n_halves; h++) {
+          uni_vmovups(ptr[reg_ptr_out1x1 + offset + h * half_bytes],
+                      ymm_1x1out(jw, h),
+                      jcp.use_nt_store);
+        }
+        break;
+      case data_type::s8:
+      case data_type::u8:
+        pack_to_u8s8(ymm_1x1out(jw, 0),
+                     ymm_1x1out(jw, 1),
+                     ymm_1x1out(jw, 0),
+                     jcp.dst_dt == data_type::s8);
+        uni_vmovups(ptr[reg_ptr_out1x1 + offset],
+                    Xmm(ymm_1x1out(jw, 0).getIdx()),
+                    jcp.use_nt_store);
+        break;
+      default:
+        assert(!"unknown dst_dt");
+    }
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_update_acc);
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      // acc1x1 format is (oc1x1/16, ow, 16o)
+      int offset = jcp.typesize_acc * j * jcp.oc1x1_block + h * half_bytes;
+      vmovups(ptr[aux_reg_ptr_acc1x1 + offset], ymm_1x1out(j, h));
+    }
+  }
+  L(l_ret);
+}
+
+void jit_conv_avx2_kernel::compute1x1_loop(int ur_w) {
+  mov(reg_ptr_wei1x1, ptr[param1 + GET_OFF(wei1x1)]);  // ic1x1 offsetted
+  mov(aux_reg_ptr_acc1x1, reg_ptr_acc1x1);             // oh, ow offsetted.
+  // acc1x1 format is (oc1x1/16, ow, 16o)
+  int acc1x1_nboc_shift = jcp.typesize_acc * jcp.ow * jcp.oc1x1_block;
+  int wei1x1_shift = jcp.typesize_in * 4 * jcp.oc1x1_block;  // == 64*s8
+  for (int oc1x1_idx = 0; oc1x1_idx < jcp.nb_oc1x1; ++oc1x1_idx) {
+    prepare_1x1output(ur_w);
+    // 1x1 weight format is OIhw4i16o4i
+    // [oc1x1/16,ic1x1/16, 4i,16o,4i]
+    const int wei_oc_offset =
+        jcp.typesize_in * (oc1x1_idx * jcp.oc * jcp.oc1x1_block);
+    mov(aux_reg_ptr_wei1x1, reg_ptr_wei1x1);
+    add(aux_reg_ptr_wei1x1, wei_oc_offset);
+    for (int i4 = 0; i4 < 4; ++i4) {  // jcp.oc_block / 4
+      if (jcp.prf_wei1x1_dist > 0) {
+        prefetcht0(ptr[aux_reg_ptr_wei1x1 + jcp.prf_wei1x1_dist]);
+      }
+      for (int jw = 0; jw < ur_w; ++jw) {
+        // the u8 output of 3x3 is in xmm_out(jw, 0), bcast 4u8 of index i4
+        vpshufd(xmm_inp, xmm_out(jw, 0), i4 * 0x55);
+        vpbroadcastd(ymm_inp, xmm_inp);
+        for (int h = 0; h < n_halves; h++) {
+          compute(ymm_1x1out(jw, h),
+                  ptr[aux_reg_ptr_wei1x1 + h * half_bytes],
+                  ymm_inp);
+        }
+      }
+      add(aux_reg_ptr_wei1x1, wei1x1_shift);
+    }
+    store_1x1output(ur_w, oc1x1_idx);  // update acc, or last then relu to dst
+    add(aux_reg_ptr_acc1x1, acc1x1_nboc_shift);
+  }
+}
+
+void jit_conv_avx2_kernel::prepare_output(int ur_w) {
+  Label l_first_load, l_ret;
+  mov(reg_channel, ptr[param1 + GET_OFF(channel)]);
+  cmp(reg_channel, 0);  // FISRT load
+  je(l_first_load, T_NEAR);
+
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      int offset = jcp.typesize_acc * j * jcp.oc_block + h * half_bytes;
+      vmovups(ymm_out(j, h), ptr[reg_acc_s32 + offset]);
+    }
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_first_load);
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      ymm_t ymm = ymm_out(j, h);
+      vpxor(ymm, ymm, ymm);
+    }
+  }
+  L(l_ret);
+}
+
+void jit_conv_avx2_kernel::store_output(int ur_w) {
+  using data_type = memory::dtype;
+  Label l_update_acc, l_ret;
+
+  mov(reg_channel, ptr[param1 + GET_OFF(channel)]);
+  int adjusment =
+      jcp.nb_ic - ((jcp.nb_ic_blocking <= 1) ? 0 : jcp.nb_ic_blocking) - 1;
+  cmp(reg_channel, adjusment);  // LAST channel
+  jl(l_update_acc, T_NEAR);
+
+  mov(reg_bias, ptr[param1 + GET_OFF(bia)]);
+  mov(reg_ptr_scales, ptr[param1 + GET_OFF(scales)]);
+  vpxor(ymm_zero, ymm_zero, ymm_zero);
+  const int oc_half = jcp.oc_block / n_halves;
+  for (int h = 0; h < n_halves; h++) {
+    if (jcp.conv0_with_bias) {
+      load_bias(reg_bias, jcp.typesize_conv0_bia * h * oc_half,
+                jcp.conv0_bias_dt);
+    }
+    if (jcp.conv0_multi_oc_scale) {
+      vmovups(ymm_scales, ptr[reg_ptr_scales + sizeof(float) * h * oc_half]);
+    } else {
+      vbroadcastss(ymm_scales, ptr[reg_ptr_scales]);
+    }
+    for (int j = 0; j < ur_w; j++) {
+      cvt_to_dst(ymm_out(j, h),
+                 jcp.conv0_with_bias,
+                 jcp.conv0_with_relu || jcp.dst_dt == data_type::u8 ||
+                     jcp.fuse_conv1x1,
+                 jcp.conv0_round_mode,
+                 jcp.fuse_conv1x1 ? data_type::u8 : jcp.dst_dt);
+    }
+  }
+
+  for (int j = 0; j < ur_w; j++) {
+    if (jcp.fuse_conv1x1) {
+      // always convert to u8, as src of 1x1 conv
+      pack_to_u8s8(ymm_out(j, 0), ymm_out(j, 1), ymm_out(j, 0), false);
+      continue;
+    }
+    int aux_output_offset = jcp.typesize_out * (j * jcp.oc * jcp.gp);
+    switch (jcp.dst_dt) {
+      case data_type::f32:
+      case data_type::s32:
+        for (int h = 0; h < n_halves; h++) {
+          uni_vmovups(ptr[reg_out + aux_output_offset + h * half_bytes],
+                      ymm_out(j, h),
+                      jcp.use_nt_store);
+        }
+        break;
+      case data_type::s8:
+      case data_type::u8:
+        pack_to_u8s8(ymm_out(j, 0),
+                     ymm_out(j, 1),
+                     ymm_out(j, 0),
+                     jcp.dst_dt == data_type::s8);
+        uni_vmovups(ptr[reg_out + aux_output_offset],
+                    xmm_out(j, 0),
+                    jcp.use_nt_store);
+        break;
+      default:
+        assert(!"unknown dst_dt");
+    }
+  }
+
+  if (jcp.fuse_conv1x1) {
+    compute1x1_loop(ur_w);
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_update_acc);
+  for (int j = 0; j < ur_w; j++) {
+    for (int h = 0; h < n_halves; h++) {
+      int offset = jcp.typesize_acc * j * jcp.oc_block + h * half_bytes;
+      vmovups(ptr[reg_acc_s32 + offset], ymm_out(j, h));
+    }
+  }
+  L(l_ret);
+}
+
+void jit_conv_avx2_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
+  int kw = jcp.kw;
+  int stride_w = jcp.sw;
+  int ic_block = jcp.ic_block;
+  int oc_block = jcp.oc_block;
+  int nb_ic_block = jcp.nb_ic_blocking;
+
+  Label kh_label, skip_kh_loop;
+  int shift_kernel_ptr = jcp.typesize_in * jcp.kw * jcp.oc_block * jcp.ic_block;
+  int dilate_w = jcp.dilate_w + 1;
+  // next kernel row is dilate_h + 1 input rows below
+  int shift_input_ptr =
+      jcp.typesize_in * (jcp.dilate_h + 1) * jcp.iw * jcp.ic * jcp.gp;
+
+  auto input_offset = [=](int oi, int nb_ic, int ic, int ki) {
+    return jcp.typesize_in *
+           ((ki * dilate_w + oi * stride_w - pad_l) * jcp.ic * jcp.gp +
+            4 * ic + nb_ic * jcp.ic_block);
+  };
+  auto kernel_offset = [=](int nb_ic, int ic, int ki) {
+    return jcp.typesize_in *
+           (ki * ic_block * oc_block + 4 * ic * oc_block +
+            jcp.kh * jcp.kw * nb_ic * jcp.ic_block * oc_block);
+  };
+  // cache lines of one input pixel in this ic chunk
+  const int ic_per_line = std::max(1, 64 / (jcp.typesize_in * ic_block));
+  const int prf_inp_lines = utils::div_up(nb_ic_block, ic_per_line);
+
+  prepare_output(ur_w);
+
+  mov(aux_reg_inp, reg_inp);
+  mov(aux_reg_ker, reg_ker);
+  mov(reg_kj, reg_kh);
+  // all kernel rows can be in padding, also in the gaps of dilated rows
+  if (jcp.kh <= jcp.t_pad || jcp.dilate_h > 0) {
+    cmp(reg_kj, 0);
+    je(skip_kh_loop, T_NEAR);
+  }
+  L(kh_label);
+  {
+    std::vector<bool> inp_prefetched(ur_w * stride_w + kw * dilate_w, false);
+    for (int ki = 0; ki < kw; ki++) {
+      int jj_start = get_ow_start(ki, pad_l);
+      int jj_end = get_ow_end(ur_w, ki, pad_r);
+
+      if (jcp.prf_inp_dist > 0) {
+        for (int jj = jj_start; jj < jj_end; jj++) {
+          int pix = jj * stride_w + ki * dilate_w;
+          if (inp_prefetched[pix]) continue;
+          inp_prefetched[pix] = true;
+          for (int l = 0; l < prf_inp_lines; l++) {
+            int aux_input_offset = input_offset(jj, l * ic_per_line, 0, ki);
+            prefetcht1(ptr[aux_reg_inp + aux_input_offset + jcp.prf_inp_dist]);
+          }
+        }
+      }
+
+      for (int cc = 0; cc < nb_ic_block; cc++) {
+        for (int ic = 0; ic < ic_block / 4; ic++) {
+          int aux_kernel_offset = kernel_offset(cc, ic, ki);
+          if (jcp.prf_wei_dist > 0 && jj_end - jj_start > 0) {
+            prefetcht1(ptr[aux_reg_ker + aux_kernel_offset + jcp.prf_wei_dist]);
+          }
+          for (int jj = jj_start; jj < jj_end; jj++) {
+            int aux_input_offset = input_offset(jj, cc, ic, ki);
+            vpbroadcastd(ymm_inp, ptr[aux_reg_inp + aux_input_offset]);
+            for (int h = 0; h < n_halves; h++) {
+              compute(ymm_out(jj, h),
+                      ptr[aux_reg_ker + aux_kernel_offset + h * half_bytes],
+                      ymm_inp);
+            }
+          }
+        }
+      }
+    }
+    add(aux_reg_ker, shift_kernel_ptr);
+    add(aux_reg_inp, shift_input_ptr);
+    dec(reg_kj);
+    cmp(reg_kj, 0);
+    jg(kh_label, T_NEAR);
+  }
+  L(skip_kh_loop);
+
+  store_output(ur_w);
+}
+
+void jit_conv_avx2_kernel::generate() {
+  int acc_shift =
+      jcp.typesize_acc * (jcp.ur_w * jcp.oc_block * jcp.nb_oc_blocking);
+  int out_shift = 0, out1x1_shift = 0, acc1x1_shift = 0;
+  if (jcp.fuse_conv1x1) {
+    // here is for shifting ur_w
+    out1x1_shift = jcp.typesize_out * (jcp.ur_w * jcp.oc1x1);
+    // acc1x1 format is oc/16, ow, 16
+    acc1x1_shift = jcp.typesize_acc * (jcp.ur_w * jcp.oc1x1_block);
+  } else {
+    out_shift = jcp.typesize_out * (jcp.ur_w * jcp.oc * jcp.gp);
+  }
+
+  preamble();
+
+  // s16 one for vpmaddwd
+  Reg32 _t = jcp.fuse_conv1x1 ? reg_scratch_1x1.cvt32()
+                              : reg_scratch_3x3.cvt32();
+  mov(_t, 0x10001);
+  vmovd(xmm_one, _t);
+  vpbroadcastd(ymm_one, xmm_one);
+
+  mov(reg_inp, ptr[param1 + GET_OFF(src)]);
+  if (jcp.fuse_conv1x1) {
+    mov(reg_ptr_out1x1, ptr[param1 + GET_OFF(dst)]);
+    mov(reg_ptr_acc1x1, ptr[param1 + GET_OFF(acc1x1)]);
+  } else {
+    mov(reg_out, ptr[param1 + GET_OFF(dst)]);
+  }
+  mov(reg_ker, ptr[param1 + GET_OFF(wei)]);
+  mov(reg_kh, ptr[param1 + GET_OFF(kh_padding)]);
+  mov(reg_acc_s32, ptr[param1 + GET_OFF(acc_s32)]);
+
+  auto shift_ptrs = [&](int shift_inp) {
+    if (shift_inp != 0) {
+      add(reg_inp, jcp.typesize_in * shift_inp * jcp.ic * jcp.gp);
+    }
+    if (jcp.fuse_conv1x1) {
+      add(reg_ptr_out1x1, out1x1_shift);
+      add(reg_ptr_acc1x1, acc1x1_shift);
+    } else {
+      add(reg_out, out_shift);
+    }
+    add(reg_acc_s32, acc_shift);
+  };
+
+  for (const auto &blk : ow_blocks(jcp)) {
+    if (blk.count == 1) {
+      compute_loop(blk.ur_w, blk.pad_l, blk.pad_r);
+      shift_ptrs(blk.inp_shift);
+    } else {
+      Label ow_loop_label;
+      xor_(reg_oi, reg_oi);
+      L(ow_loop_label);
+      {
+        compute_loop(blk.ur_w, 0, 0);
+        shift_ptrs(blk.inp_shift);
+        inc(reg_oi);
+        cmp(reg_oi, blk.count);
+        jl(ow_loop_label, T_NEAR);
+      }
+    }
+  }
+
+  if (jcp.use_nt_store) {
+    sfence();
+  }
+  vzeroupper();
+  postamble();
+}
+
+bool jit_conv_avx2_kernel::init_conf(jit_conv_conf_t &jcp,
+                                     const std::unique_ptr<memory> &src,
+                                     const std::unique_ptr<memory> &wei,
+                                     const std::unique_ptr<memory> &bia,
+                                     int ngroups,
+                                     std::array<int, 2> sz_stride,
+                                     std::array<int, 2> sz_padding,
+                                     std::array<int, 2> sz_dilation,
+                                     std::unique_ptr<memory> &dst,
+                                     std::vector<float> conv0_scales,
+                                     std::vector<float> conv1_scales,
+                                     const std::unique_ptr<memory> &wei1x1,
+                                     const std::unique_ptr<memory> &bia1x1,
+                                     bool conv0_relu,
+                                     bool conv1_relu,
+                                     round_mode conv0_round_mode,
+                                     round_mode conv1_round_mode) {
+  if (!mayiuse(avx2)) {
+    return false;
+  }
+  // the checks and most settings are the same with avx512 kernel
+  if (!jit_conv_kernel::init_conf(jcp, src, wei, bia, ngroups, sz_stride,
+                                  sz_padding, sz_dilation, dst, conv0_scales,
+                                  conv1_scales, wei1x1, bia1x1, conv0_relu,
+                                  conv1_relu, conv0_round_mode,
+                                  conv1_round_mode)) {
+    return false;
+  }
+
+  jcp.use_vnni = false;
+  // 16 ymm: 12 for acc, others for input, bias, scales, zero and one
+  jcp.nb_oc_blocking = 1;
+  jcp.ur_w = ker_reg_base_idx / n_halves;
+  if (jcp.fuse_conv1x1) {
+    // half for 3x3 acc, half for 1x1 acc
+    jcp.ur_w /= 2;
+  }
+  if (jcp.ow < jcp.ur_w) jcp.ur_w = jcp.ow;
+  jcp.ur_w_tail = jcp.ow % jcp.ur_w;
+  // the distances above were from the avx512 blocking
+  jit_conv_kernel::init_prefetch(jcp);
+
+  return true;
+}
+
+}
+}
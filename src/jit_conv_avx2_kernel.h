@@ -0,0 +1,162 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include "jit_call_conf.h"
+#include "jit_generator.h"
+
+namespace deepfusion {
+namespace jit {
+
+// AVX2 version of jit_conv_kernel, with the same conf, call args and data
+// format. One ymm holds 8o of the 16o block, so each output pixel uses two.
+struct jit_conv_avx2_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_conv_avx2_kernel);
+
+  jit_conv_avx2_kernel(jit_conv_conf_t ajcp) : jcp(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_conv_call_t *))getCode();
+  }
+
+  static bool init_conf(jit_conv_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &wei,
+                        const std::unique_ptr<memory> &bia,
+                        int ngroups,  // only enabled on conv0
+                        std::array<int, 2> sz_stride,
+                        std::array<int, 2> sz_padding,
+                        std::array<int, 2> sz_dilation,
+                        std::unique_ptr<memory> &dst,
+                        std::vector<float> conv0_scales,
+                        std::vector<float> conv1_scales,
+                        const std::unique_ptr<memory> &wei1x1,
+                        const std::unique_ptr<memory> &bia1x1,
+                        bool conv0_relu,
+                        bool conv1_relu,
+                        round_mode conv0_round_mode,
+                        round_mode conv1_round_mode);
+
+  jit_conv_conf_t jcp;
+  void (*jit_ker_)(jit_conv_call_t *);
+
+private:
+  enum {
+    ker_reg_base_idx = 12,
+    n_halves = 2,  // 16o = 2 x 8o
+    half_bytes = 32,
+  };
+
+  using reg64_t = const Xbyak::Reg64;
+  using reg32_t = const Xbyak::Reg32;
+  using ymm_t = const Xbyak::Ymm;
+  using xmm_t = const Xbyak::Xmm;
+
+  reg64_t reg_inp = r8;
+  reg64_t reg_ker = r9;
+  reg64_t reg_out = r10;  // when fuse 1x1, do not need 3x3 out
+  reg64_t aux_reg_inp = r11;
+  reg64_t aux_reg_ker = r12;
+  reg64_t reg_acc_s32 = r13;
+  reg64_t reg_scratch_3x3 = r14;
+  reg64_t reg_kj = rax;
+  reg64_t reg_ptr_scales = rax;
+  reg64_t reg_oi = rbx;
+  reg64_t reg_bias = rdx;
+  reg64_t reg_kh = abi_not_param1;
+  reg64_t param = abi_param1;
+  reg64_t reg_channel = r15;
+
+  ymm_t ymm_zero = ymm_t(12);
+  ymm_t ymm_scales = ymm_t(13);
+  ymm_t ymm_inp = ymm_t(13);
+  xmm_t xmm_inp = xmm_t(13);
+  ymm_t ymm_bias = ymm_t(14);
+  ymm_t ymm_tmp = ymm_t(14);
+  xmm_t xmm_tmp = xmm_t(14);
+  ymm_t ymm_one = ymm_t(15);
+  xmm_t xmm_one = xmm_t(15);
+
+  // for conv 1x1
+  reg64_t reg_ptr_out1x1 = r10;
+  reg64_t aux_reg_ptr_acc1x1 = r11;
+  reg64_t reg_ptr_wei1x1 = r12;
+  reg64_t reg_ptr_acc1x1 = r14;
+  reg64_t reg_scratch_1x1 = r15;
+  reg64_t reg_ocb3x3 = r15;
+  reg64_t aux_reg_ptr_wei1x1 = rax;
+  reg64_t reg_ptr_scales1x1 = rax;
+  reg64_t reg_ptr_bia1x1 = rdx;
+
+  // nb_oc_blocking is always 1, acc of 16o is (ymm_out(j, 0), ymm_out(j, 1))
+  ymm_t ymm_out(int i_ur, int h) {
+    int idx = i_ur * n_halves + h;
+    assert(idx < ker_reg_base_idx);
+    return ymm_t(idx);
+  }
+
+  xmm_t xmm_out(int i_ur, int h) {
+    int idx = i_ur * n_halves + h;
+    assert(idx < ker_reg_base_idx);
+    return xmm_t(idx);
+  }
+
+  // conv 1x1 acc follows conv 3x3 acc
+  ymm_t ymm_1x1out(int jw, int h) {
+    int idx = (jcp.ur_w + jw) * n_halves + h;
+    assert(idx < ker_reg_base_idx);
+    return ymm_t(idx);
+  }
+
+  // the outputs of [start, end) whose input of ki is not in padding
+  int get_ow_start(int ki, int pad_l) {
+    return std::max(
+        0, utils::div_up(pad_l - ki * (jcp.dilate_w + 1), jcp.sw));
+  }
+
+  int get_ow_end(int ur_w, int ki, int pad_r) {
+    return ur_w - std::max(0,
+                           utils::div_up(pad_r - (jcp.kw - 1 - ki) *
+                                                     (jcp.dilate_w + 1),
+                                         jcp.sw));
+  }
+
+  void compute(ymm_t &vreg_acc, const Xbyak::Address &wei, ymm_t &vreg_src);
+  void load_bias(const Xbyak::Reg64 &reg_ptr,
+                 int offset,
+                 memory::dtype bias_dt);
+  void cvt_to_dst(const ymm_t &ymm,
+                  bool with_bias,
+                  bool with_relu,
+                  round_mode rmode,
+                  memory::dtype dst_dt);
+  void pack_to_u8s8(const ymm_t &ymm_lo,
+                    const ymm_t &ymm_hi,
+                    const ymm_t &ymm_dst,
+                    bool is_signed);
+  void prepare_output(int ur_w);
+  void store_output(int ur_w);
+  void compute_loop(int ur_w, int pad_l, int pad_r);
+
+  void compute1x1_loop(int ur_w);
+  void prepare_1x1output(int ur_w);
+  void store_1x1output(int ur_w, int ocb1x1);
+
+  void generate();
+};
+
+}
+}
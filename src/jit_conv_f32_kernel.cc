@@ -0,0 +1,535 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "jit_conv_f32_kernel.h"
+#include "deepfusion_utils.h"
+
+#define GET_OFF(field) offsetof(jit_conv_call_t, field)
+
+namespace deepfusion {
+namespace jit {
+
+using namespace Xbyak;
+
+// f32 dst, or rounded to bf16 dst which is half size
+void jit_conv_f32_kernel::store_dst(reg64_t reg_dst, int offset, zmm_t zmm) {
+  if (jcp.dst_dt == memory::dtype::bf16) {
+    cvt_f32_to_bf16(zmm, zmm_tmp, zmm_wei);
+    store_bf16(ptr[reg_dst + offset], zmm, jcp.use_nt_store);
+  } else {
+    uni_vmovups(
+        EVEX_compress_addr(reg_dst, offset), zmm, jcp.use_nt_store);
+  }
+}
+
+void jit_conv_f32_kernel::prepare_1x1output(int ur_w) {
+  Label l_first_load, l_ret;
+  mov(reg_ocb3x3, ptr[param1 + GET_OFF(ocb3x3)]);
+  cmp(reg_ocb3x3, 0);  // FISRT load
+  je(l_first_load, T_NEAR);
+
+  for (int j = 0; j < ur_w; j++) {
+    // acc1x1 format is (oc1x1/16, ow, 16o)
+    int offset = jcp.typesize_acc * j * jcp.oc1x1_block;
+    vmovups(zmm_1x1out(j), EVEX_compress_addr(aux_reg_ptr_acc1x1, offset));
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_first_load);
+  for (int j = 0; j < ur_w; j++) {
+    vpxord(zmm_1x1out(j), zmm_1x1out(j), zmm_1x1out(j));
+  }
+  L(l_ret);
+}
+
+void jit_conv_f32_kernel::store_1x1output(int ur_w, int ocb1x1) {
+  Label l_update_acc, l_ret;
+  mov(reg_ocb3x3, ptr[param1 + GET_OFF(ocb3x3)]);
+  cmp(reg_ocb3x3, jcp.nb_oc - jcp.nb_oc_blocking);  // LAST channel
+  jl(l_update_acc, T_NEAR);
+
+  mov(reg_ptr_bia1x1, ptr[param1 + GET_OFF(bia1x1)]);
+  mov(reg_ptr_scales1x1, ptr[param1 + GET_OFF(scales1x1)]);
+  int scale_offset =
+      jcp.conv1_multi_oc_scale ? sizeof(float) * ocb1x1 * jcp.oc1x1_block : 0;
+  if (jcp.conv1_with_bias) {
+    int bias_offset = jcp.typesize_conv1_bia * ocb1x1 * jcp.oc1x1_block;
+    vmovups(zmm_bias, EVEX_compress_addr(reg_ptr_bia1x1, bias_offset));
+  }
+  vpxord(zmm_zero, zmm_zero, zmm_zero);
+  for (int jw = 0; jw < ur_w; jw++) {
+    Zmm zmm = zmm_1x1out(jw);
+    if (jcp.conv1_with_bias) {
+      vaddps(zmm, zmm, zmm_bias);
+    }
+    vmulps(zmm, zmm, EVEX_compress_addr(reg_ptr_scales1x1, scale_offset));
+    if (jcp.conv1_with_relu) {
+      vmaxps(zmm, zmm_zero, zmm);
+    }
+    // out format is nhw,c/16,16o
+    int offset = jcp.typesize_out * (jw * jcp.oc1x1 + ocb1x1 * jcp.oc1x1_block);
+    store_dst(reg_ptr_out1x1, offset, zmm);
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_update_acc);
+  for (int j = 0; j < ur_w; j++) {
+    // acc1x1 format is (oc1x1/16, ow, 16o)
+    int offset = jcp.typesize_acc * j * jcp.oc1x1_block;
+    vmovups(EVEX_compress_addr(aux_reg_ptr_acc1x1, offset), zmm_1x1out(j));
+  }
+  L(l_ret);
+}
+
+void jit_conv_f32_kernel::compute1x1_loop(int ur_w) {
+  mov(reg_ptr_wei1x1, ptr[param1 + GET_OFF(wei1x1)]);  // ic1x1 offsetted
+  mov(aux_reg_ptr_acc1x1, reg_ptr_acc1x1);             // oh, ow offsetted
+  // acc1x1 format is (oc1x1/16, ow, 16o)
+  int acc1x1_nboc_shift = jcp.typesize_acc * jcp.ow * jcp.oc1x1_block;
+  for (int oc1x1_idx = 0; oc1x1_idx < jcp.nb_oc1x1; ++oc1x1_idx) {
+    prepare_1x1output(ur_w);
+    for (int k = 0; k < jcp.nb_oc_blocking; ++k) {
+      for (int i = 0; i < jcp.oc_block; ++i) {
+        // 1x1 weight format is OIhw16i16o, [oc1x1/16, ic1x1/16, 16i, 16o]
+        int wei_offset =
+            typesize_wei * (oc1x1_idx * jcp.oc * jcp.oc1x1_block +
+                               (k * jcp.oc_block + i) * jcp.oc1x1_block);
+        vmovups(zmm_1x1_wei, EVEX_compress_addr(reg_ptr_wei1x1, wei_offset));
+        if (jcp.prf_wei1x1_dist > 0) {
+          prefetcht0(ptr[reg_ptr_wei1x1 + wei_offset + jcp.prf_wei1x1_dist]);
+        }
+        for (int jw = 0; jw < ur_w; ++jw) {
+          // the output of conv0 is kept in acc as (oc/16, ur_w, 16o)
+          int src_offset =
+              jcp.typesize_acc * ((k * ur_w + jw) * jcp.oc_block + i);
+          vfmadd231ps(zmm_1x1out(jw),
+                      zmm_1x1_wei,
+                      EVEX_compress_addr(reg_acc, src_offset, true));
+        }
+      }
+    }
+    store_1x1output(ur_w, oc1x1_idx);  // update acc, or last then relu to dst
+    add(aux_reg_ptr_acc1x1, acc1x1_nboc_shift);
+  }
+}
+
+void jit_conv_f32_kernel::prepare_output(int ur_w) {
+  Label l_first_load, l_ret;
+  mov(reg_channel, ptr[param1 + GET_OFF(channel)]);
+  cmp(reg_channel, 0);  // FISRT load
+  je(l_first_load, T_NEAR);
+
+  for (int k = 0; k < jcp.nb_oc_blocking; k++) {
+    for (int j = 0; j < ur_w; j++) {
+      int offset = jcp.typesize_acc * (k * ur_w + j) * jcp.oc_block;
+      vmovups(zmm_out(j, k), EVEX_compress_addr(reg_acc, offset));
+    }
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_first_load);
+  for (int k = 0; k < jcp.nb_oc_blocking; k++) {
+    for (int j = 0; j < ur_w; j++) {
+      vpxord(zmm_out(j, k), zmm_out(j, k), zmm_out(j, k));
+    }
+  }
+  L(l_ret);
+}
+
+void jit_conv_f32_kernel::store_output(int ur_w) {
+  Label l_update_acc, l_ret;
+  mov(reg_channel, ptr[param1 + GET_OFF(channel)]);
+  cmp(reg_channel, jcp.nb_ic - jcp.nb_ic_blocking);  // LAST channel
+  jl(l_update_acc, T_NEAR);
+
+  mov(reg_bias, ptr[param1 + GET_OFF(bia)]);
+  mov(reg_ptr_scales, ptr[param1 + GET_OFF(scales)]);
+  vpxord(zmm_zero, zmm_zero, zmm_zero);
+  for (int k = 0; k < jcp.nb_oc_blocking; k++) {
+    int scale_offset =
+        jcp.conv0_multi_oc_scale ? sizeof(float) * k * jcp.oc_block : 0;
+    if (jcp.conv0_with_bias) {
+      int bias_offset = jcp.typesize_conv0_bia * k * jcp.oc_block;
+      vmovups(zmm_bias, EVEX_compress_addr(reg_bias, bias_offset));
+    }
+    for (int j = 0; j < ur_w; j++) {
+      Zmm zmm = zmm_out(j, k);
+      if (jcp.conv0_with_bias) {
+        vaddps(zmm, zmm, zmm_bias);
+      }
+      vmulps(zmm, zmm, EVEX_compress_addr(reg_ptr_scales, scale_offset));
+      if (jcp.conv0_with_relu) {
+        vmaxps(zmm, zmm_zero, zmm);
+      }
+      if (jcp.fuse_conv1x1) {
+        // keep in acc, to be broadcast as src of 1x1 conv
+        int offset = jcp.typesize_acc * (k * ur_w + j) * jcp.oc_block;
+        vmovups(EVEX_compress_addr(reg_acc, offset), zmm);
+      } else {
+        int offset =
+            jcp.typesize_out * (k * jcp.oc_block + j * jcp.oc * jcp.gp);
+        store_dst(reg_out, offset, zmm);
+      }
+    }
+  }
+
+  if (jcp.fuse_conv1x1) {
+    compute1x1_loop(ur_w);
+  }
+  jmp(l_ret, T_NEAR);
+
+  L(l_update_acc);
+  for (int k = 0; k < jcp.nb_oc_blocking; k++) {
+    for (int j = 0; j < ur_w; j++) {
+      int offset = jcp.typesize_acc * (k * ur_w + j) * jcp.oc_block;
+      vmovups(EVEX_compress_addr(reg_acc, offset), zmm_out(j, k));
+    }
+  }
+  L(l_ret);
+}
+
+void jit_conv_f32_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
+  int kw = jcp.kw;
+  int stride_w = jcp.sw;
+  int dilate_w = jcp.dilate_w + 1;
+  int ic_block = jcp.ic_block;
+  int oc_block = jcp.oc_block;
+  int nb_oc_block = jcp.nb_oc_blocking;
+  int nb_ic_block = jcp.nb_ic_blocking;
+
+  Label kh_label, skip_kh_loop;
+  int shift_kernel_ptr = typesize_wei * jcp.kw * jcp.oc_block * jcp.ic_block;
+  // next kernel row is dilate_h + 1 input rows below
+  int shift_input_ptr =
+      jcp.typesize_in * (jcp.dilate_h + 1) * jcp.iw * jcp.ic * jcp.gp;
+
+  auto input_offset = [=](int oi, int nb_ic, int ic, int ki) {
+    return jcp.typesize_in *
+           ((ki * dilate_w + oi * stride_w - pad_l) * jcp.ic * jcp.gp +
+            nb_ic * jcp.ic_block + ic);
+  };
+  // OIhw16i16o
+  auto kernel_offset = [=](int ii, int nb_ic, int ic, int ki) {
+    return typesize_wei *
+           (ii * jcp.nb_ic * jcp.kh * jcp.kw * ic_block * oc_block +
+            jcp.kh * jcp.kw * nb_ic * ic_block * oc_block +
+            ki * ic_block * oc_block + ic * oc_block);
+  };
+  // cache lines of one input pixel in this ic chunk
+  const int ic_per_line = std::max(1, 64 / (jcp.typesize_in * ic_block));
+  const int prf_inp_lines = utils::div_up(nb_ic_block, ic_per_line);
+
+  prepare_output(ur_w);
+
+  mov(aux_reg_inp, reg_inp);
+  mov(aux_reg_ker, reg_ker);
+  mov(reg_kj, reg_kh);
+  // all kernel rows can be in padding, also in the gaps of dilated rows
+  if (jcp.kh <= jcp.t_pad || jcp.dilate_h > 0) {
+    cmp(reg_kj, 0);
+    je(skip_kh_loop, T_NEAR);
+  }
+  L(kh_label);
+  {
+    // the input pixels of this row which have been prefetched
+    std::vector<bool> inp_prefetched(ur_w * stride_w + kw * dilate_w, false);
+    for (int ki = 0; ki < kw; ki++) {
+      int jj_start = get_ow_start(ki, pad_l);
+      int jj_end = get_ow_end(ur_w, ki, pad_r);
+      if (jj_end - jj_start <= 0) {
+        continue;
+      }
+
+      if (jcp.prf_inp_dist > 0) {
+        // prefetch the ic chunk of each input pixel once
+        for (int jj = jj_start; jj < jj_end; jj++) {
+          int pix = jj * stride_w + ki * dilate_w;
+          if (inp_prefetched[pix]) continue;
+          inp_prefetched[pix] = true;
+          for (int l = 0; l < prf_inp_lines; l++) {
+            int aux_input_offset =
+                input_offset(jj, l * ic_per_line, 0, ki);
+            prefetcht1(ptr[aux_reg_inp + aux_input_offset + jcp.prf_inp_dist]);
+          }
+        }
+      }
+
+      for (int cc = 0; cc < nb_ic_block; cc++) {
+        for (int ic = 0; ic < ic_block; ic++) {
+          for (int jj = jj_start; jj < jj_end; jj++) {
+            int aux_input_offset = input_offset(jj, cc, ic, ki);
+            if (jcp.src_dt == memory::dtype::bf16) {
+              // bf16 in both halves of each dword, keep the upper one
+              vpbroadcastw(zmm_inp(jj), ptr[aux_reg_inp + aux_input_offset]);
+              vpslld(zmm_inp(jj), zmm_inp(jj), 16);
+            } else {
+              vbroadcastss(zmm_inp(jj), ptr[aux_reg_inp + aux_input_offset]);
+            }
+          }
+          for (int ii = 0; ii < nb_oc_block; ii++) {
+            int aux_kernel_offset = kernel_offset(ii, cc, ic, ki);
+            vmovups(zmm_wei,
+                    EVEX_compress_addr(aux_reg_ker, aux_kernel_offset));
+            if (jcp.prf_wei_dist > 0) {
+              // one zmm of weights is one cache line
+              prefetcht1(
+                  ptr[aux_reg_ker + aux_kernel_offset + jcp.prf_wei_dist]);
+            }
+            for (int jj = jj_start; jj < jj_end; jj++) {
+              vfmadd231ps(zmm_out(jj, ii), zmm_wei, zmm_inp(jj));
+            }
+          }
+        }
+      }
+    }
+    add(aux_reg_ker, shift_kernel_ptr);
+    add(aux_reg_inp, shift_input_ptr);
+    dec(reg_kj);
+    cmp(reg_kj, 0);
+    jg(kh_label, T_NEAR);
+  }
+  L(skip_kh_loop);
+
+  store_output(ur_w);
+}
+
+void jit_conv_f32_kernel::generate() {
+  int acc_shift =
+      jcp.typesize_acc * (jcp.ur_w * jcp.oc_block * jcp.nb_oc_blocking);
+  int out_shift = 0, out1x1_shift = 0, acc1x1_shift = 0;
+  if (jcp.fuse_conv1x1) {
+    out1x1_shift = jcp.typesize_out * (jcp.ur_w * jcp.oc1x1);
+    // acc1x1 format is oc/16, ow, 16
+    acc1x1_shift = jcp.typesize_acc * (jcp.ur_w * jcp.oc1x1_block);
+  } else {
+    out_shift = jcp.typesize_out * (jcp.ur_w * jcp.oc * jcp.gp);
+  }
+
+  preamble();
+
+  mov(reg_inp, ptr[param1 + GET_OFF(src)]);
+  if (jcp.fuse_conv1x1) {
+    mov(reg_ptr_out1x1, ptr[param1 + GET_OFF(dst)]);
+    mov(reg_ptr_acc1x1, ptr[param1 + GET_OFF(acc1x1)]);
+  } else {
+    mov(reg_out, ptr[param1 + GET_OFF(dst)]);
+  }
+  mov(reg_ker, ptr[param1 + GET_OFF(wei)]);
+  mov(reg_kh, ptr[param1 + GET_OFF(kh_padding)]);
+  mov(reg_acc, ptr[param1 + GET_OFF(acc_s32)]);
+
+  auto shift_ptrs = [&](int shift_inp) {
+    if (shift_inp != 0) {
+      add(reg_inp, jcp.typesize_in * shift_inp * jcp.ic * jcp.gp);
+    }
+    if (jcp.fuse_conv1x1) {
+      add(reg_ptr_out1x1, out1x1_shift);
+      add(reg_ptr_acc1x1, acc1x1_shift);
+    } else {
+      add(reg_out, out_shift);
+    }
+    add(reg_acc, acc_shift);
+  };
+
+  for (const auto &blk : ow_blocks(jcp)) {
+    if (blk.count == 1) {
+      compute_loop(blk.ur_w, blk.pad_l, blk.pad_r);
+      shift_ptrs(blk.inp_shift);
+    } else {
+      Label ow_loop_label;
+      xor_(reg_oi, reg_oi);
+      L(ow_loop_label);
+      {
+        compute_loop(blk.ur_w, 0, 0);
+        shift_ptrs(blk.inp_shift);
+        inc(reg_oi);
+        cmp(reg_oi, blk.count);
+        jl(ow_loop_label, T_NEAR);
+      }
+    }
+  }
+
+  if (jcp.use_nt_store) {
+    sfence();
+  }
+  postamble();
+}
+
+bool jit_conv_f32_kernel::init_conf(jit_conv_conf_t &jcp,
+                                    const std::unique_ptr<memory> &src,
+                                    const std::unique_ptr<memory> &wei,
+                                    const std::unique_ptr<memory> &bia,
+                                    int ngroups,
+                                    std::array<int, 2> sz_stride,
+                                    std::array<int, 2> sz_padding,
+                                    std::array<int, 2> sz_dilation,
+                                    std::unique_ptr<memory> &dst,
+                                    std::vector<float> conv0_scales,
+                                    std::vector<float> conv1_scales,
+                                    const std::unique_ptr<memory> &wei1x1,
+                                    const std::unique_ptr<memory> &bia1x1,
+                                    bool conv0_relu,
+                                    bool conv1_relu,
+                                    round_mode conv0_round_mode,
+                                    round_mode conv1_round_mode) {
+  using namespace utils;
+  using data_type = memory::dtype;
+  jcp = zero<decltype(jcp)>();
+  if (!mayiuse(avx512_core)) {
+    return false;
+  }
+  // all in f32, but src and dst can be stored in bf16
+  if (!all_true(one_of(src->data_type(), data_type::f32, data_type::bf16),
+                wei->data_type() == data_type::f32,
+                one_of(dst->data_type(), data_type::f32, data_type::bf16),
+                bia == nullptr || bia->data_type() == data_type::f32,
+                wei1x1 == nullptr || wei1x1->data_type() == data_type::f32,
+                bia1x1 == nullptr || bia1x1->data_type() == data_type::f32)) {
+    return false;
+  }
+  if (!all_true(src->dim_format() == memory::format::nhwc,
+                dst->dim_format() == memory::format::nhwc,
+                wei->dim_format() == memory::format::OIhw16i16o,
+                bia == nullptr || bia->dim_format() == memory::format::x,
+                wei1x1 == nullptr ||
+                    wei1x1->dim_format() == memory::format::OIhw16i16o,
+                bia1x1 == nullptr ||
+                    bia1x1->dim_format() == memory::format::x)) {
+    return false;
+  }
+
+  jcp.gp = ngroups;
+  assert(ngroups == 1);
+  auto src_dims = src->std_dims();  // nchw
+  auto wei_dims = wei->std_dims();  // oihw
+  auto dst_dims = dst->std_dims();  // nchw
+  jcp.bs = src_dims[0];
+  jcp.ic = src_dims[1] / jcp.gp;
+  jcp.ih = src_dims[2];
+  jcp.iw = src_dims[3];
+  // dst channel is oc1x1 when fused
+  jcp.oc = wei_dims[0] / jcp.gp;
+  jcp.oh = dst_dims[2];
+  jcp.ow = dst_dims[3];
+  jcp.kh = wei_dims[2];
+  jcp.kw = wei_dims[3];
+  jcp.sh = sz_stride[0];
+  jcp.sw = sz_stride[1];
+  jcp.t_pad = sz_padding[0];
+  jcp.l_pad = sz_padding[1];
+  if (!all_true(sz_dilation[0] >= 1, sz_dilation[1] >= 1)) {
+    return false;
+  }
+  jcp.dilate_h = sz_dilation[0] - 1;
+  jcp.dilate_w = sz_dilation[1] - 1;
+  jcp.ic_block = 16;
+  jcp.oc_block = 16;
+  jcp.nb_ic = jcp.ic / jcp.ic_block;
+  jcp.nb_oc = jcp.oc / jcp.oc_block;
+  if (!all_true(jcp.ic % jcp.ic_block == 0, jcp.oc % jcp.oc_block == 0)) {
+    return false;
+  }
+  jcp.use_vnni = false;
+  jcp.loop_order = jcp.gp > 1 ? loop_ngc : loop_cgn;
+
+  jcp.fuse_conv1x1 = wei1x1 != nullptr;
+  if (jcp.fuse_conv1x1) {
+    auto wei1x1_dims = wei1x1->std_dims();  // oihw
+    jcp.oc1x1 = wei1x1_dims[0];
+    if (!all_true(jcp.oc == wei1x1_dims[1],
+                  wei1x1_dims[2] == 1,
+                  wei1x1_dims[3] == 1)) {
+      return false;
+    }
+    jcp.oc1x1_block = 16;
+    jcp.nb_oc1x1 = jcp.oc1x1 / jcp.oc1x1_block;
+    if (jcp.oc1x1 % jcp.oc1x1_block != 0) {
+      return false;
+    }
+  }
+
+  auto undef_dt = data_type::undef;
+  jcp.conv0_with_bias = bia != nullptr;
+  jcp.conv1_with_bias = bia1x1 != nullptr;
+  jcp.conv0_bias_dt = jcp.conv0_with_bias ? data_type::f32 : undef_dt;
+  jcp.conv1_bias_dt = jcp.conv1_with_bias ? data_type::f32 : undef_dt;
+  jcp.src_dt = src->data_type();
+  jcp.dst_dt = dst->data_type();
+  jcp.typesize_in = dtype_size(jcp.src_dt);
+  jcp.typesize_out = dtype_size(jcp.dst_dt);
+  jcp.typesize_acc = sizeof(f32);
+  jcp.typesize_conv0_bia = jcp.conv0_with_bias ? sizeof(f32) : 0;
+  jcp.typesize_conv1_bia = jcp.conv1_with_bias ? sizeof(f32) : 0;
+  jcp.conv0_with_relu = conv0_relu;
+  jcp.conv1_with_relu = conv1_relu;
+  jcp.use_nt_store = use_streaming_store(dst);
+  // no rounding in f32
+  jcp.conv0_round_mode = conv0_round_mode;
+  jcp.conv1_round_mode = conv1_round_mode;
+
+  // each ic of the chunk is unrolled, 4 times of the int8 kernel
+  jcp.nb_ic_blocking = dividable_of(jcp.nb_ic, 4, 2, 1);
+  if (jcp.kh >= 7 || jcp.kw >= 7) {
+    jcp.nb_ic_blocking = dividable_of(jcp.nb_ic, 2, 1);
+  }
+  jcp.nb_oc_blocking = jcp.nb_oc > 4 ? 4 : jcp.nb_oc;
+  if (jcp.nb_oc % jcp.nb_oc_blocking != 0) {
+    jcp.nb_oc_blocking = find_dividable(jcp.nb_oc, jcp.nb_oc_blocking);
+  }
+
+  // the rest 1 size of ur_w is for src input zmm
+  jcp.ur_w = ker_reg_base_idx / (jcp.nb_oc_blocking + 1);
+  if (jcp.ow < jcp.ur_w) jcp.ur_w = jcp.ow;
+  jcp.ur_w_tail = jcp.ow % jcp.ur_w;
+
+  // prefetch settings, only when the working set is beyond L1
+  const int l1_size = get_cache_size(1, true);
+  const int ic_chunks = jcp.nb_ic / jcp.nb_ic_blocking;
+  const int inp_rows = (jcp.kh - 1) * (jcp.dilate_h + 1) + 1;
+  const int inp_rows_size =
+      jcp.typesize_in * inp_rows * jcp.iw * jcp.ic * jcp.gp;
+  const int wei_chunk_size = typesize_wei * jcp.kh * jcp.kw *
+                             jcp.nb_ic_blocking * jcp.ic_block * jcp.oc_block;
+  jcp.prf_inp_dist = inp_rows_size > l1_size
+                         ? jcp.typesize_in * jcp.sh * jcp.iw * jcp.ic * jcp.gp
+                         : 0;
+  jcp.prf_wei_dist =
+      ic_chunks > 1 && wei_chunk_size * jcp.nb_oc_blocking > l1_size / 2
+          ? wei_chunk_size
+          : 0;
+  jcp.prf_wei1x1_dist =
+      jcp.fuse_conv1x1 && typesize_wei * jcp.oc * jcp.oc1x1 > l1_size / 2
+          ? typesize_wei * jcp.oc * jcp.oc1x1_block
+          : 0;
+  jcp.prf_inp_dist = getenv_int("DEEPFUSION_CONV_PRF_INP", jcp.prf_inp_dist);
+  jcp.prf_wei_dist = getenv_int("DEEPFUSION_CONV_PRF_WEI", jcp.prf_wei_dist);
+  jcp.prf_wei1x1_dist =
+      getenv_int("DEEPFUSION_CONV_PRF_WEI1X1", jcp.prf_wei1x1_dist);
+
+  jcp.conv0_multi_oc_scale = conv0_scales.size() > 1;
+  jcp.conv1_multi_oc_scale = conv1_scales.size() > 1;
+  if (!one_of(conv0_scales.size(), 1, jcp.oc)) {
+    return false;
+  }
+  if (jcp.fuse_conv1x1 && !one_of(conv1_scales.size(), 1, jcp.oc1x1)) {
+    return false;
+  }
+
+  return true;
+}
+
+}
+}
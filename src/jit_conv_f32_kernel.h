@@ -0,0 +1,136 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include "jit_call_conf.h"
+#include "jit_conv_kernel.h"
+#include "jit_generator.h"
+
+namespace deepfusion {
+namespace jit {
+
+// f32 conv with AVX512 FMA, for the models can not be quantized.
+// src and dst are nhwc in f32 or bf16, weights are OIhw16i16o, bias is f32.
+// The blocking, ow blocks and conv1x1 fusion are the same with the int8
+// kernel, but the output of conv0 stays f32 as the src of conv1x1.
+struct jit_conv_f32_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_conv_f32_kernel);
+
+  jit_conv_f32_kernel(jit_conv_conf_t ajcp) : jcp(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_conv_call_t *))getCode();
+  }
+
+  static bool init_conf(jit_conv_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &wei,
+                        const std::unique_ptr<memory> &bia,
+                        int ngroups,  // only enabled on conv0
+                        std::array<int, 2> sz_stride,
+                        std::array<int, 2> sz_padding,
+                        std::array<int, 2> sz_dilation,
+                        std::unique_ptr<memory> &dst,
+                        std::vector<float> conv0_scales,
+                        std::vector<float> conv1_scales,
+                        const std::unique_ptr<memory> &wei1x1,
+                        const std::unique_ptr<memory> &bia1x1,
+                        bool conv0_relu,
+                        bool conv1_relu,
+                        round_mode conv0_round_mode,
+                        round_mode conv1_round_mode);
+
+  jit_conv_conf_t jcp;
+  void (*jit_ker_)(jit_conv_call_t *);
+
+private:
+  enum {
+    ker_reg_base_idx = 28,
+    typesize_wei = sizeof(f32),  // src may be bf16, weights are always f32
+  };
+
+  using reg64_t = const Xbyak::Reg64;
+  using zmm_t = const Xbyak::Zmm;
+
+  reg64_t reg_inp = r8;
+  reg64_t reg_ker = r9;
+  reg64_t reg_out = r10;
+  reg64_t aux_reg_inp = r11;
+  reg64_t aux_reg_ker = r12;
+  reg64_t reg_acc = r13;  // acc of ic chunks, then conv0 output if fused
+  reg64_t reg_kj = rax;
+  reg64_t reg_ptr_scales = rax;
+  reg64_t reg_oi = rbx;
+  reg64_t reg_bias = rdx;
+  reg64_t reg_kh = abi_not_param1;
+  reg64_t reg_channel = r15;
+
+  zmm_t zmm_bias = zmm_t(29);
+  zmm_t zmm_zero = zmm_t(30);
+  zmm_t zmm_wei = zmm_t(31);
+  zmm_t zmm_tmp = zmm_t(28);  // with zmm_wei, to round f32 to bf16 dst
+
+  // for conv 1x1
+  reg64_t reg_ptr_out1x1 = r10;
+  reg64_t aux_reg_ptr_acc1x1 = r11;
+  reg64_t reg_ptr_wei1x1 = r12;
+  reg64_t reg_ptr_acc1x1 = r14;
+  reg64_t reg_ocb3x3 = r15;
+  reg64_t reg_ptr_scales1x1 = rax;
+  reg64_t reg_ptr_bia1x1 = rdx;
+  zmm_t zmm_1x1_wei = zmm_t(31);
+
+  zmm_t zmm_out(int i_ur, int i_oc) {
+    int idx = i_ur + i_oc * jcp.ur_w;
+    assert(idx < ker_reg_base_idx);
+    return zmm_t(idx);
+  }
+
+  zmm_t zmm_inp(int i_ur) {
+    int idx = i_ur + jcp.nb_oc_blocking * jcp.ur_w;
+    assert(idx < ker_reg_base_idx);
+    return zmm_t(idx);
+  }
+
+  // 1x1 acc reuses the input zmms, which are free after conv0
+  zmm_t zmm_1x1out(int jw) { return zmm_inp(jw); }
+
+  int get_ow_start(int ki, int pad_l) {
+    return std::max(
+        0, utils::div_up(pad_l - ki * (jcp.dilate_w + 1), jcp.sw));
+  }
+
+  int get_ow_end(int ur_w, int ki, int pad_r) {
+    return ur_w - std::max(0,
+                           utils::div_up(pad_r - (jcp.kw - 1 - ki) *
+                                                     (jcp.dilate_w + 1),
+                                         jcp.sw));
+  }
+
+  void store_dst(reg64_t reg_dst, int offset, zmm_t zmm);
+  void prepare_output(int ur_w);
+  void store_output(int ur_w);
+  void compute_loop(int ur_w, int pad_l, int pad_r);
+
+  void compute1x1_loop(int ur_w);
+  void prepare_1x1output(int ur_w);
+  void store_1x1output(int ur_w, int ocb1x1);
+
+  void generate();
+};
+
+}
+}
@@ -114,15 +114,15 @@ void jit_conv_kernel::store_1x1output(int ur_w, int ocb1x1) {
     switch (jcp.dst_dt) {
       case data_type::f32:
       case data_type::s32:
-        vmovups(addr, zmm);
+        uni_vmovups(addr, zmm, jcp.use_nt_store);
         break;
       case data_type::s8:
         vpmovsdb(xmm, zmm);
-        vmovups(addr, xmm);
+        uni_vmovups(addr, xmm, jcp.use_nt_store);
         break;
       case data_type::u8:
         vpmovusdb(xmm, zmm);
-        vmovups(addr, xmm);
+        uni_vmovups(addr, xmm, jcp.use_nt_store);
         break;
       default:
         assert(!"unknown dst_dt");
@@ -172,6 +172,9 @@ void jit_conv_kernel::compute1x1_loop(int ur_w) {
         // load 1x1 wei, load 16o4i *s8 one, the format is OIhw4i16o4i
         // [oc1x1/16,ic1x1/16, 4i,16o,4i]
         vmovups(zmm_1x1_wei, EVEX_compress_addr(aux_reg_ptr_wei1x1, 0));
+        if (jcp.prf_wei1x1_dist > 0) {
+          prefetcht0(ptr[aux_reg_ptr_wei1x1 + jcp.prf_wei1x1_dist]);
+        }
         add(aux_reg_ptr_wei1x1, wei1x1_shift);
         for (int jw = 0; jw < ur_w; ++jw) {
           if (i4 == 0) {
@@ -261,10 +264,12 @@ void jit_conv_kernel::store_output(int ur_w) {
         vaddps(zmm, zmm, zmm_bias);
       }
       vmulps(zmm, zmm, EVEX_compress_addr(reg_ptr_scales, scale_offset));
-      if (jcp.conv0_with_relu || jcp.dst_dt == data_type::u8 || jcp.fuse_conv1x1) {
+      if (jcp.conv0_with_relu || jcp.dst_dt == data_type::u8 ||
+          jcp.fuse_conv1x1) {
         vmaxps(zmm, zmm_zero, zmm);
       }
-      if (jcp.dst_dt != data_type::f32) {
+      // the output of conv0 is always u8 when fused, even if dst is f32
+      if (jcp.dst_dt != data_type::f32 || jcp.fuse_conv1x1) {
         if (jcp.conv0_round_mode == round_mode::nearest)
           vcvtps2dq(zmm | T_rn_sae, zmm);
         else if (jcp.conv0_round_mode == round_mode::down)
@@ -282,15 +287,15 @@ void jit_conv_kernel::store_output(int ur_w) {
         switch (jcp.dst_dt) {
           case data_type::f32:
           case data_type::s32:
-            vmovups(addr, zmm);
+            uni_vmovups(addr, zmm, jcp.use_nt_store);
             break;
           case data_type::s8:
             vpmovsdb(xmm, zmm);
-            vmovups(addr, xmm);
+            uni_vmovups(addr, xmm, jcp.use_nt_store);
             break;
           case data_type::u8:
             vpmovusdb(xmm, zmm);
-            vmovups(addr, xmm);
+            uni_vmovups(addr, xmm, jcp.use_nt_store);
             break;
           default:
             assert(!"unknown dst_dt");
@@ -324,11 +329,15 @@ void jit_conv_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
 
   Label kh_label, skip_kh_loop;
   int shift_kernel_ptr = jcp.typesize_in * jcp.kw * jcp.oc_block * jcp.ic_block;
-  int shift_input_ptr = jcp.typesize_in * jcp.iw * jcp.ic * jcp.gp;
+  int dilate_w = jcp.dilate_w + 1;
+  // next kernel row is dilate_h + 1 input rows below
+  int shift_input_ptr =
+      jcp.typesize_in * (jcp.dilate_h + 1) * jcp.iw * jcp.ic * jcp.gp;
 
   auto input_offset = [=](int oi, int nb_ic, int ic, int ki) {
-    return jcp.typesize_in * ((ki + oi * stride_w - pad_l) * jcp.ic * jcp.gp +
-                              4 * ic + nb_ic * jcp.ic_block);
+    return jcp.typesize_in *
+           ((ki * dilate_w + oi * stride_w - pad_l) * jcp.ic * jcp.gp +
+            4 * ic + nb_ic * jcp.ic_block);
   };
   auto kernel_offset = [=](int ii, int nb_ic, int ic, int ki) {
     return jcp.typesize_in *
@@ -345,22 +354,41 @@ void jit_conv_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
       vpaddd(vreg_acc, vreg_acc, zmm_tmp);
     }
   };
+  // cache lines of one input pixel in this ic chunk
+  const int ic_per_line = std::max(1, 64 / (jcp.typesize_in * ic_block));
+  const int prf_inp_lines = utils::div_up(nb_ic_block, ic_per_line);
 
   prepare_output(ur_w);
 
   mov(aux_reg_inp, reg_inp);
   mov(aux_reg_ker, reg_ker);
   mov(reg_kj, reg_kh);
-  if (jcp.kh <= jcp.t_pad) {
+  // all kernel rows can be in padding, also in the gaps of dilated rows
+  if (jcp.kh <= jcp.t_pad || jcp.dilate_h > 0) {
     cmp(reg_kj, 0);
     je(skip_kh_loop, T_NEAR);
   }
   L(kh_label);
   {
+    // the input pixels of this row which have been prefetched
+    std::vector<bool> inp_prefetched(ur_w * stride_w + kw * dilate_w, false);
     for (int ki = 0; ki < kw; ki++) {
       int jj_start = get_ow_start(ki, pad_l);
       int jj_end = get_ow_end(ur_w, ki, pad_r);
 
+      if (jcp.prf_inp_dist > 0) {
+        // prefetch the ic chunk of each input pixel once
+        for (int jj = jj_start; jj < jj_end; jj++) {
+          int pix = jj * stride_w + ki * dilate_w;
+          if (inp_prefetched[pix]) continue;
+          inp_prefetched[pix] = true;
+          for (int l = 0; l < prf_inp_lines; l++) {
+            int aux_input_offset = input_offset(jj, l * ic_per_line, 0, ki);
+            prefetcht1(ptr[aux_reg_inp + aux_input_offset + jcp.prf_inp_dist]);
+          }
+        }
+      }
+
       for (int cc = 0; cc < nb_ic_block; cc++) {
         for (int ic = 0; ic < ic_block / 4; ic++) {
           for (int jj = jj_start; jj < jj_end; jj++) {
@@ -371,9 +399,15 @@ void jit_conv_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
 
           for (int ii = 0; ii < nb_oc_block; ii++) {
             int aux_kernel_offset = kernel_offset(ii, cc, ic, ki);
-            if (jj_end - jj_start > 0)
+            if (jj_end - jj_start > 0) {
               vmovups(zmm_wei,
                       EVEX_compress_addr(aux_reg_ker, aux_kernel_offset));
+              if (jcp.prf_wei_dist > 0) {
+                // one zmm of weights is one cache line
+                prefetcht1(ptr[aux_reg_ker + aux_kernel_offset +
+                               jcp.prf_wei_dist]);
+              }
+            }
             for (int jj = jj_start; jj < jj_end; jj++) {
               compute(zmm_out(jj, ii), zmm_wei, zmm_inp(jj, nb_oc_block));
             }
@@ -392,10 +426,48 @@ void jit_conv_kernel::compute_loop(int ur_w, int pad_l, int pad_r) {
   store_output(ur_w);
 }
 
+std::vector<ow_block_t> ow_blocks(const jit_conv_conf_t &jcp) {
+  // the input pointer of each block is at its first pixel out of padding,
+  // so pad_l is the left padding of the block's first output
+  auto pad_l = [&](int b) {
+    return std::max(0, jcp.l_pad - b * jcp.ur_w * jcp.sw);
+  };
+  auto pad_r = [&](int b, int ur_w) {
+    int last_iw = (b * jcp.ur_w + ur_w - 1) * jcp.sw +
+                  (jcp.kw - 1) * (jcp.dilate_w + 1) - jcp.l_pad;
+    return std::max(0, last_iw - (jcp.iw - 1));
+  };
+  auto inp_pos = [&](int b) {
+    return std::max(0, b * jcp.ur_w * jcp.sw - jcp.l_pad);
+  };
+
+  std::vector<ow_block_t> blocks;
+  const int n_oi = jcp.ow / jcp.ur_w;
+  int b_l = 0;  // blocks before b_l have left padding
+  while (b_l < n_oi && pad_l(b_l) > 0) {
+    ++b_l;
+  }
+  int b_r = n_oi;  // blocks from b_r have right padding
+  while (b_r > b_l && pad_r(b_r - 1, jcp.ur_w) > 0) {
+    --b_r;
+  }
+  for (int b = 0; b < n_oi; ++b) {
+    int shift = inp_pos(b + 1) - inp_pos(b);
+    if (b >= b_l && b < b_r) {
+      blocks.push_back({jcp.ur_w, 0, 0, b_r - b_l, shift});
+      b = b_r - 1;
+    } else {
+      blocks.push_back({jcp.ur_w, pad_l(b), pad_r(b, jcp.ur_w), 1, shift});
+    }
+  }
+  if (jcp.ur_w_tail != 0) {
+    blocks.push_back(
+        {jcp.ur_w_tail, pad_l(n_oi), pad_r(n_oi, jcp.ur_w_tail), 1, 0});
+  }
+  return blocks;
+}
+
 void jit_conv_kernel::generate() {
-  int inp_shift_pad =
-      jcp.typesize_in * (jcp.ur_w * jcp.sw - jcp.l_pad) * jcp.ic * jcp.gp;
-  int inp_shift = jcp.typesize_in * (jcp.ur_w * jcp.sw * jcp.ic * jcp.gp);
   int acc_shift =
       jcp.typesize_acc * (jcp.ur_w * jcp.oc_block * jcp.nb_oc_blocking);
   int out_shift = 0, out1x1_shift = 0, acc1x1_shift = 0;
@@ -433,82 +505,75 @@ void jit_conv_kernel::generate() {
   mov(reg_kh, ptr[param1 + GET_OFF(kh_padding)]);
   mov(reg_acc_s32, ptr[param1 + GET_OFF(acc_s32)]);
 
-  int r_pad = std::max(
-      0, (jcp.ow - 1) * jcp.sw + (jcp.kw - 1) - (jcp.iw + jcp.l_pad - 1));
-  int n_oi = jcp.ow / jcp.ur_w;
-  int r_pad1 =
-      (jcp.ur_w * n_oi - 1) * jcp.sw + jcp.kw - 1 - (jcp.iw + jcp.l_pad - 1);
-  if (r_pad1 > 0) n_oi--;
+  auto shift_ptrs = [&](int shift_inp) {
+    if (shift_inp != 0) {
+      add(reg_inp, jcp.typesize_in * shift_inp * jcp.ic * jcp.gp);
+    }
+    if (jcp.fuse_conv1x1) {
+      add(reg_ptr_out1x1, out1x1_shift);
+      add(reg_ptr_acc1x1, acc1x1_shift);
+    } else {
+      add(reg_out, out_shift);
+    }
+    add(reg_acc_s32, acc_shift);
+  };
 
-  xor_(reg_oi, reg_oi);
-  if (jcp.ow == jcp.ur_w) {
-    compute_loop(jcp.ur_w, jcp.l_pad, r_pad);
-  } else {
-    if (n_oi == 0) {
-      compute_loop(jcp.ur_w, jcp.l_pad, r_pad1);
-      add(reg_inp, inp_shift_pad);
-      if (jcp.fuse_conv1x1) {
-        add(reg_ptr_out1x1, out1x1_shift);
-        add(reg_ptr_acc1x1, acc1x1_shift);
-      } else {
-        add(reg_out, out_shift);
-      }
-      add(reg_acc_s32, acc_shift);
-      if (jcp.ur_w_tail != 0) {
-        compute_loop(jcp.ur_w_tail, 0, r_pad);
-      }
+  for (const auto &blk : ow_blocks(jcp)) {
+    if (blk.count == 1) {
+      compute_loop(blk.ur_w, blk.pad_l, blk.pad_r);
+      shift_ptrs(blk.inp_shift);
     } else {
-      if (jcp.l_pad > 0) {
-        compute_loop(jcp.ur_w, jcp.l_pad, 0);
-        add(reg_inp, inp_shift_pad);
-        if (jcp.fuse_conv1x1) {
-          add(reg_ptr_out1x1, out1x1_shift);
-          add(reg_ptr_acc1x1, acc1x1_shift);
-        } else {
-          add(reg_out, out_shift);
-        }
-        add(reg_acc_s32, acc_shift);
+      Label ow_loop_label;
+      xor_(reg_oi, reg_oi);
+      L(ow_loop_label);
+      {
+        compute_loop(blk.ur_w, 0, 0);
+        shift_ptrs(blk.inp_shift);
         inc(reg_oi);
-      }
-      if ((jcp.l_pad <= 0 && n_oi > 0) || (jcp.l_pad > 0 && n_oi > 1)) {
-        if (jcp.l_pad <= 0 && r_pad1 > 0) n_oi--;
-        Label ow_loop_label;
-        L(ow_loop_label);
-        {
-          compute_loop(jcp.ur_w, 0, 0);
-          add(reg_inp, inp_shift);
-          if (jcp.fuse_conv1x1) {
-            add(reg_ptr_out1x1, out1x1_shift);
-            add(reg_ptr_acc1x1, acc1x1_shift);
-          } else {
-            add(reg_out, out_shift);
-          }
-          add(reg_acc_s32, acc_shift);
-          inc(reg_oi);
-          cmp(reg_oi, n_oi);
-          jl(ow_loop_label, T_NEAR);
-        }
-      }
-      if (r_pad1 > 0) {
-        compute_loop(jcp.ur_w, 0, r_pad1);
-        add(reg_inp, inp_shift);
-        if (jcp.fuse_conv1x1) {
-          add(reg_ptr_out1x1, out1x1_shift);
-          add(reg_ptr_acc1x1, acc1x1_shift);
-        } else {
-          add(reg_out, out_shift);
-        }
-        add(reg_acc_s32, acc_shift);
-      }
-      if (jcp.ur_w_tail != 0) {
-        compute_loop(jcp.ur_w_tail, 0, r_pad);
+        cmp(reg_oi, blk.count);
+        jl(ow_loop_label, T_NEAR);
       }
     }
   }
 
+  if (jcp.use_nt_store) {
+    sfence();
+  }
   postamble();
 }
 
+// prefetch settings, only when the working set is beyond L1,
+// call it again whenever the blocking changes
+void jit_conv_kernel::init_prefetch(jit_conv_conf_t &jcp) {
+  using namespace utils;
+  const int l1_size = get_cache_size(1, true);
+  const int ic_chunks = jcp.nb_ic / jcp.nb_ic_blocking;
+  const int inp_rows = (jcp.kh - 1) * (jcp.dilate_h + 1) + 1;
+  const int inp_rows_size =
+      jcp.typesize_in * inp_rows * jcp.iw * jcp.ic * jcp.gp;
+  const int wei_chunk_size = jcp.typesize_in * jcp.kh * jcp.kw *
+                             jcp.nb_ic_blocking * jcp.ic_block * jcp.oc_block;
+  // next call handles next output row, which needs the input rows of sh below
+  jcp.prf_inp_dist = inp_rows_size > l1_size
+                         ? jcp.typesize_in * jcp.sh * jcp.iw * jcp.ic * jcp.gp
+                         : 0;
+  // next ic chunk is right after this chunk in OIhw4i16o4i
+  jcp.prf_wei_dist =
+      ic_chunks > 1 && wei_chunk_size * jcp.nb_oc_blocking > l1_size / 2
+          ? wei_chunk_size
+          : 0;
+  // next oc1x1 block is oc * 16o after in OIhw4i16o4i
+  jcp.prf_wei1x1_dist =
+      jcp.fuse_conv1x1 && jcp.typesize_in * jcp.oc * jcp.oc1x1 > l1_size / 2
+          ? jcp.typesize_in * jcp.oc * jcp.oc1x1_block
+          : 0;
+  // can be tuned by env, in bytes, 0 to disable
+  jcp.prf_inp_dist = getenv_int("DEEPFUSION_CONV_PRF_INP", jcp.prf_inp_dist);
+  jcp.prf_wei_dist = getenv_int("DEEPFUSION_CONV_PRF_WEI", jcp.prf_wei_dist);
+  jcp.prf_wei1x1_dist =
+      getenv_int("DEEPFUSION_CONV_PRF_WEI1X1", jcp.prf_wei1x1_dist);
+}
+
 bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
                                 const std::unique_ptr<memory> &src,
                                 const std::unique_ptr<memory> &wei,
@@ -516,6 +581,7 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
                                 int ngroups,
                                 std::array<int, 2> sz_stride,
                                 std::array<int, 2> sz_padding,
+                                std::array<int, 2> sz_dilation,
                                 std::unique_ptr<memory> &dst,
                                 std::vector<float> conv0_scales,
                                 std::vector<float> conv1_scales,
@@ -569,12 +635,11 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
   auto wei_dims = wei->std_dims();  // oihw
   auto dst_dims = dst->std_dims();  // nchw
   jcp.bs = src_dims[0];
-  // TODO: ic, oc do not use src and dst channel, use wei instead
-  // src and dst channel should be used for double check
   jcp.ic = src_dims[1] / jcp.gp;
   jcp.ih = src_dims[2];
   jcp.iw = src_dims[3];
-  jcp.oc = dst_dims[1] / jcp.gp;
+  // dst channel is oc1x1 when fused
+  jcp.oc = wei_dims[0] / jcp.gp;
   jcp.oh = dst_dims[2];
   jcp.ow = dst_dims[3];
   jcp.kh = wei_dims[2];
@@ -583,6 +648,11 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
   jcp.sw = sz_stride[1];
   jcp.t_pad = sz_padding[0];
   jcp.l_pad = sz_padding[1];
+  if (!all_true(sz_dilation[0] >= 1, sz_dilation[1] >= 1)) {
+    return false;
+  }
+  jcp.dilate_h = sz_dilation[0] - 1;
+  jcp.dilate_w = sz_dilation[1] - 1;
   jcp.ic_block = 16;
   jcp.oc_block = 16;
   jcp.nb_ic = jcp.ic / jcp.ic_block;
@@ -607,8 +677,8 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
     auto wei1x1_dims = wei1x1->std_dims();  // oihw
     jcp.oc1x1 = wei1x1_dims[0];
     if (!all_true(jcp.oc == wei1x1_dims[1],
-                  jcp.oh == wei1x1_dims[2],
-                  jcp.ow == wei1x1_dims[3])) {
+                  wei1x1_dims[2] == 1,
+                  wei1x1_dims[3] == 1)) {
       return false;
     }
     jcp.oc1x1_block = 16;
@@ -623,6 +693,7 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
   jcp.conv1_with_bias = bia1x1 != nullptr;
   jcp.conv0_bias_dt = jcp.conv0_with_bias ? bia->data_type() : undef_dt;
   jcp.conv1_bias_dt = jcp.conv1_with_bias ? bia1x1->data_type() : undef_dt;
+  jcp.src_dt = src->data_type();
   jcp.dst_dt = dst->data_type();
   jcp.typesize_in = dtype_size(src->data_type());
   jcp.typesize_out = dtype_size(dst->data_type());
@@ -633,6 +704,7 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
       jcp.conv1_with_bias ? dtype_size(bia1x1->data_type()) : 0;
   jcp.conv0_with_relu = conv0_relu;
   jcp.conv1_with_relu = conv1_relu;
+  jcp.use_nt_store = use_streaming_store(dst);
 
   jcp.conv0_round_mode = conv0_round_mode;
   jcp.conv1_round_mode = conv1_round_mode;
@@ -654,11 +726,7 @@ bool jit_conv_kernel::init_conf(jit_conv_conf_t &jcp,
   if (jcp.ow < jcp.ur_w) jcp.ur_w = jcp.ow;
   jcp.ur_w_tail = jcp.ow % jcp.ur_w;
 
-  int r_pad_no_tail = std::max(
-      0, (jcp.ow - jcp.ur_w_tail - 1) * jcp.sw + jcp.kw - jcp.iw - jcp.l_pad);
-  if (jcp.l_pad > jcp.ur_w || r_pad_no_tail > jcp.ur_w) {
-    return false;
-  }
+  init_prefetch(jcp);
 
   jcp.conv0_multi_oc_scale = conv0_scales.size() > 1;
   jcp.conv1_multi_oc_scale = conv1_scales.size() > 1;
@@ -22,6 +22,17 @@
 namespace deepfusion {
 namespace jit {
 
+// The ow of one output row is computed by blocks of ur_w, then the tail.
+// The blocks touching left or right padding are generated one by one, with
+// any padding size, and the ones in between run in a loop.
+struct ow_block_t {
+  int ur_w;
+  int pad_l, pad_r;  // input pixels in padding, of the first and last output
+  int count;         // > 1 if run in a loop
+  int inp_shift;     // input pixels to shift after each block
+};
+std::vector<ow_block_t> ow_blocks(const jit_conv_conf_t &jcp);
+
 struct jit_conv_kernel : public jit_generator {
   DECLARE_JIT_KERNEL(jit_conv_kernel);
 
@@ -37,6 +48,7 @@ struct jit_conv_kernel : public jit_generator {
                         int ngroups,  // only enabled on conv0
                         std::array<int, 2> sz_stride,
                         std::array<int, 2> sz_padding,
+                        std::array<int, 2> sz_dilation,
                         std::unique_ptr<memory> &dst,
                         std::vector<float> conv0_scales,
                         std::vector<float> conv1_scales,
@@ -47,6 +59,8 @@ struct jit_conv_kernel : public jit_generator {
                         round_mode conv0_round_mode,
                         round_mode conv1_round_mode);
 
+  static void init_prefetch(jit_conv_conf_t &jcp);
+
   jit_conv_conf_t jcp;
   void (*jit_ker_)(jit_conv_call_t *);
 
@@ -117,13 +131,17 @@ private:
     return zmm_t(idx);
   }
 
+  // the outputs of [start, end) whose input of ki is not in padding
   int get_ow_start(int ki, int pad_l) {
-    return std::max(0, (pad_l - ki + jcp.sw - 1) / jcp.sw);
+    return std::max(
+        0, utils::div_up(pad_l - ki * (jcp.dilate_w + 1), jcp.sw));
   }
 
   int get_ow_end(int ur_w, int ki, int pad_r) {
-    return ur_w -
-           std::max(0, (ki + pad_r - (jcp.kw - 1) + jcp.sw - 1) / jcp.sw);
+    return ur_w - std::max(0,
+                           utils::div_up(pad_r - (jcp.kw - 1 - ki) *
+                                                     (jcp.dilate_w + 1),
+                                         jcp.sw));
   }
 
   bool maybe_relu(int position);
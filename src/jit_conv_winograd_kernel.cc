@@ -0,0 +1,414 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "jit_conv_winograd_kernel.h"
+#include "deepfusion_utils.h"
+#include "omp_thread.h"
+
+#define GET_OFF(field) offsetof(jit_wino_call_t, field)
+
+namespace deepfusion {
+namespace jit {
+
+using namespace Xbyak;
+
+void jit_wino_src_trans_kernel::generate() {
+  // (16, tiles, ic) in s16, the stride of each element
+  const int elem_stride = jcp.tile_w * jcp.ic * sizeof(int16_t);
+  Label ic_loop;
+
+  preamble();
+
+  mov(reg_src, ptr[param1 + GET_OFF(src)]);
+  mov(reg_wino_src, ptr[param1 + GET_OFF(wino_src)]);
+  xor_(reg_ic, reg_ic);
+  mov(reg_cnt, jcp.nb_ic);
+  L(ic_loop);
+  {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        mov(reg_pix, ptr[reg_src + (i * 4 + j) * sizeof(void *)]);
+        vpmovzxbw(zmm_d(i, j), ptr[reg_pix + reg_ic]);
+      }
+    }
+    // B' d, on rows
+    for (int j = 0; j < 4; ++j) {
+      vpsubw(zmm_t_(0, j), zmm_d(0, j), zmm_d(2, j));
+      vpaddw(zmm_t_(1, j), zmm_d(1, j), zmm_d(2, j));
+      vpsubw(zmm_t_(2, j), zmm_d(2, j), zmm_d(1, j));
+      vpsubw(zmm_t_(3, j), zmm_d(1, j), zmm_d(3, j));
+    }
+    // (B' d) B, on columns
+    for (int i = 0; i < 4; ++i) {
+      vpsubw(zmm_d(i, 0), zmm_t_(i, 0), zmm_t_(i, 2));
+      vpaddw(zmm_d(i, 1), zmm_t_(i, 1), zmm_t_(i, 2));
+      vpsubw(zmm_d(i, 2), zmm_t_(i, 2), zmm_t_(i, 1));
+      vpsubw(zmm_d(i, 3), zmm_t_(i, 1), zmm_t_(i, 3));
+    }
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        int offset = (i * 4 + j) * elem_stride;
+        vmovups(EVEX_compress_addr(reg_wino_src, offset), zmm_d(i, j));
+      }
+    }
+    add(reg_ic, jcp.ic_block);
+    add(reg_wino_src, jcp.ic_block * sizeof(int16_t));
+    dec(reg_cnt);
+    cmp(reg_cnt, 0);
+    jg(ic_loop, T_NEAR);
+  }
+
+  postamble();
+}
+
+void jit_wino_gemm_kernel::compute_block(int ur_t) {
+  const int nbo = jcp.nb_oc_blocking;
+  // weights of each oc block are (ic/2, 16o, 2i) in s16
+  const int wei_oc_stride = jcp.ic * jcp.oc_block * sizeof(int16_t);
+  Label ic_loop;
+
+  for (int t = 0; t < ur_t; ++t) {
+    for (int o = 0; o < nbo; ++o) {
+      vpxord(zmm_acc(t, o), zmm_acc(t, o), zmm_acc(t, o));
+    }
+  }
+
+  mov(aux_reg_src, reg_src);
+  mov(aux_reg_wei, reg_wei);
+  mov(reg_ic_cnt, jcp.ic / 2);
+  L(ic_loop);
+  {
+    for (int o = 0; o < nbo; ++o) {
+      vmovups(zmm_wei(o), EVEX_compress_addr(aux_reg_wei, o * wei_oc_stride));
+    }
+    for (int t = 0; t < ur_t; ++t) {
+      // 2 ic of this tile in each dword
+      int src_offset = t * jcp.ic * sizeof(int16_t);
+      vpbroadcastd(zmm_bcast, ptr[aux_reg_src + src_offset]);
+      for (int o = 0; o < nbo; ++o) {
+        if (jcp.use_vnni) {
+          vpdpwssd(zmm_acc(t, o), zmm_wei(o), zmm_bcast);
+        } else {
+          vpmaddwd(zmm_tmp, zmm_wei(o), zmm_bcast);
+          vpaddd(zmm_acc(t, o), zmm_acc(t, o), zmm_tmp);
+        }
+      }
+    }
+    add(aux_reg_src, 2 * sizeof(int16_t));
+    add(aux_reg_wei, jcp.oc_block * 2 * sizeof(int16_t));
+    dec(reg_ic_cnt);
+    cmp(reg_ic_cnt, 0);
+    jg(ic_loop, T_NEAR);
+  }
+
+  // (tiles, oc of the chunk) in s32
+  const int oc_chunk = jcp.nb_oc_chunk * jcp.oc_block;
+  for (int t = 0; t < ur_t; ++t) {
+    for (int o = 0; o < nbo; ++o) {
+      int offset = (t * oc_chunk + o * jcp.oc_block) * sizeof(s32);
+      vmovups(EVEX_compress_addr(aux_reg_dst, offset), zmm_acc(t, o));
+    }
+  }
+}
+
+void jit_wino_gemm_kernel::generate() {
+  const int nbo = jcp.nb_oc_blocking;
+  const int nb_t = jcp.tile_w / jcp.ur_t;
+  const int oc_chunk = jcp.nb_oc_chunk * jcp.oc_block;
+  Label oc_loop, t_loop;
+
+  preamble();
+
+  mov(reg_wei, ptr[param1 + GET_OFF(wino_wei)]);
+  mov(reg_dst, ptr[param1 + GET_OFF(wino_dst)]);
+  xor_(reg_oc_cnt, reg_oc_cnt);
+  // the weights of oc chunk stay in cache for all tiles of the row
+  L(oc_loop);
+  {
+    mov(reg_src, ptr[param1 + GET_OFF(wino_src)]);
+    mov(aux_reg_dst, reg_dst);
+    if (nb_t > 0) {
+      xor_(reg_t_cnt, reg_t_cnt);
+      L(t_loop);
+      {
+        compute_block(jcp.ur_t);
+        add(reg_src, jcp.ur_t * jcp.ic * sizeof(int16_t));
+        add(aux_reg_dst, jcp.ur_t * oc_chunk * sizeof(s32));
+        inc(reg_t_cnt);
+        cmp(reg_t_cnt, nb_t);
+        jl(t_loop, T_NEAR);
+      }
+    }
+    if (jcp.ur_t_tail > 0) {
+      compute_block(jcp.ur_t_tail);
+    }
+    add(reg_wei, nbo * jcp.ic * jcp.oc_block * sizeof(int16_t));
+    add(reg_dst, nbo * jcp.oc_block * sizeof(s32));
+    inc(reg_oc_cnt);
+    cmp(reg_oc_cnt, jcp.nb_oc_chunk / nbo);
+    jl(oc_loop, T_NEAR);
+  }
+
+  postamble();
+}
+
+// Y[k] of the tile to its dst pixel, k is (y * 2 + x)
+void jit_wino_dst_trans_kernel::store_output(int k) {
+  using data_type = memory::dtype;
+  zmm_t zmm = zmm_y(k / 2, k % 2);
+  xmm_t xmm = xmm_t(zmm.getIdx());
+
+  // A' M A is 4 times of Y, exactly
+  vpsrad(zmm, zmm, 2);
+  vcvtdq2ps(zmm, zmm);
+  if (jcp.with_bias) {
+    vaddps(zmm, zmm, zmm_bias);
+  }
+  if (jcp.multi_oc_scale) {
+    vmulps(zmm, zmm, zword[reg_scales]);
+  } else {
+    vmulps(zmm, zmm, zword_b[reg_scales]);
+  }
+  if (jcp.with_relu || jcp.dst_dt == data_type::u8) {
+    vmaxps(zmm, zmm_zero, zmm);
+  }
+  if (jcp.dst_dt != data_type::f32) {
+    if (jcp.rmode == round_mode::nearest)
+      vcvtps2dq(zmm | T_rn_sae, zmm);
+    else if (jcp.rmode == round_mode::down)
+      vcvtps2dq(zmm | T_rd_sae, zmm);
+    else
+      assert(!"unimplemented");
+  }
+
+  mov(reg_pix, ptr[reg_dst + k * sizeof(void *)]);
+  auto addr = ptr[reg_pix + reg_oc];
+  switch (jcp.dst_dt) {
+    case data_type::f32:
+    case data_type::s32:
+      vmovups(addr, zmm);
+      break;
+    case data_type::s8:
+      vpmovsdb(xmm, zmm);
+      vmovups(addr, xmm);
+      break;
+    case data_type::u8:
+      vpmovusdb(xmm, zmm);
+      vmovups(addr, xmm);
+      break;
+    default:
+      assert(!"unknown dst_dt");
+  }
+}
+
+void jit_wino_dst_trans_kernel::generate() {
+  using data_type = memory::dtype;
+  // (16, tiles, oc of the chunk) in s32, the stride of each element
+  const int elem_stride =
+      jcp.tile_w * jcp.nb_oc_chunk * jcp.oc_block * sizeof(s32);
+  Label oc_loop;
+
+  preamble();
+
+  mov(reg_dst, ptr[param1 + GET_OFF(dst)]);
+  mov(reg_wino_dst, ptr[param1 + GET_OFF(wino_dst)]);
+  mov(reg_bias, ptr[param1 + GET_OFF(bia)]);
+  mov(reg_scales, ptr[param1 + GET_OFF(scales)]);
+  vpxord(zmm_zero, zmm_zero, zmm_zero);
+  xor_(reg_oc, reg_oc);
+  mov(reg_cnt, jcp.nb_oc_chunk);
+  L(oc_loop);
+  {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        int offset = (i * 4 + j) * elem_stride;
+        vmovups(zmm_m(i, j), EVEX_compress_addr(reg_wino_dst, offset));
+      }
+    }
+    // A' M, on rows
+    for (int j = 0; j < 4; ++j) {
+      vpaddd(zmm_r(0, j), zmm_m(0, j), zmm_m(1, j));
+      vpaddd(zmm_r(0, j), zmm_r(0, j), zmm_m(2, j));
+      vpsubd(zmm_r(1, j), zmm_m(1, j), zmm_m(2, j));
+      vpsubd(zmm_r(1, j), zmm_r(1, j), zmm_m(3, j));
+    }
+    // (A' M) A, on columns
+    for (int i = 0; i < 2; ++i) {
+      vpaddd(zmm_y(i, 0), zmm_r(i, 0), zmm_r(i, 1));
+      vpaddd(zmm_y(i, 0), zmm_y(i, 0), zmm_r(i, 2));
+      vpsubd(zmm_y(i, 1), zmm_r(i, 1), zmm_r(i, 2));
+      vpsubd(zmm_y(i, 1), zmm_y(i, 1), zmm_r(i, 3));
+    }
+
+    if (jcp.with_bias) {
+      switch (jcp.bias_dt) {
+        case data_type::f32:
+        case data_type::s32:
+          vmovups(zmm_bias, ptr[reg_bias]);
+          break;
+        case data_type::s8:
+          vpmovsxbd(zmm_bias, ptr[reg_bias]);
+          break;
+        case data_type::u8:
+          vpmovzxbd(zmm_bias, ptr[reg_bias]);
+          break;
+        default:
+          assert(!"unsupported bias data type");
+      }
+      if (jcp.bias_dt != data_type::f32) {
+        vcvtdq2ps(zmm_bias, zmm_bias);
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      store_output(k);
+    }
+
+    add(reg_oc, jcp.oc_block * jcp.typesize_out);
+    add(reg_wino_dst, jcp.oc_block * sizeof(s32));
+    if (jcp.with_bias) {
+      add(reg_bias, jcp.oc_block * jcp.typesize_bia);
+    }
+    if (jcp.multi_oc_scale) {
+      add(reg_scales, jcp.oc_block * sizeof(float));
+    }
+    dec(reg_cnt);
+    cmp(reg_cnt, 0);
+    jg(oc_loop, T_NEAR);
+  }
+
+  postamble();
+}
+
+bool winograd_init_conf(jit_wino_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &wei,
+                        const std::unique_ptr<memory> &bia,
+                        std::array<int, 2> sz_stride,
+                        std::array<int, 2> sz_padding,
+                        std::unique_ptr<memory> &dst,
+                        const std::vector<float> &scales,
+                        bool relu,
+                        round_mode rmode) {
+  using namespace utils;
+  using data_type = memory::dtype;
+  jcp = zero<decltype(jcp)>();
+  if (!mayiuse(avx512_core)) {
+    return false;
+  }
+  if (!all_true(src->data_type() == data_type::u8,
+                wei->data_type() == data_type::s8,
+                one_of(dst->data_type(),
+                       data_type::f32,
+                       data_type::s32,
+                       data_type::s8,
+                       data_type::u8),
+                bia == nullptr || one_of(bia->data_type(),
+                                         data_type::f32,
+                                         data_type::s32,
+                                         data_type::s8,
+                                         data_type::u8))) {
+    return false;
+  }
+  if (!all_true(src->dim_format() == memory::format::nhwc,
+                dst->dim_format() == memory::format::nhwc,
+                wei->dim_format() == memory::format::OIhw4i16o4i,
+                bia == nullptr || bia->dim_format() == memory::format::x)) {
+    return false;
+  }
+
+  auto src_dims = src->std_dims();  // nchw
+  auto wei_dims = wei->std_dims();  // oihw
+  auto dst_dims = dst->std_dims();  // nchw
+  jcp.bs = src_dims[0];
+  jcp.ic = src_dims[1];
+  jcp.ih = src_dims[2];
+  jcp.iw = src_dims[3];
+  jcp.oc = wei_dims[0];
+  jcp.oh = dst_dims[2];
+  jcp.ow = dst_dims[3];
+  jcp.t_pad = sz_padding[0];
+  jcp.l_pad = sz_padding[1];
+  // only 3x3 with stride 1
+  if (!all_true(wei_dims[2] == 3,
+                wei_dims[3] == 3,
+                sz_stride[0] == 1,
+                sz_stride[1] == 1,
+                jcp.t_pad >= 0,
+                jcp.l_pad >= 0)) {
+    return false;
+  }
+  if (!all_true(dst_dims[0] == jcp.bs,
+                wei_dims[1] == jcp.ic,
+                dst_dims[1] == jcp.oc,
+                bia == nullptr || bia->std_dims()[0] == jcp.oc,
+                jcp.oh == conv_output_size(jcp.ih, 3, 1, jcp.t_pad, 1),
+                jcp.ow == conv_output_size(jcp.iw, 3, 1, jcp.l_pad, 1),
+                jcp.oh > 0,
+                jcp.ow > 0)) {
+    return false;
+  }
+
+  jcp.ic_block = 32;
+  jcp.oc_block = 16;
+  if (!all_true(jcp.ic % jcp.ic_block == 0, jcp.oc % jcp.oc_block == 0)) {
+    return false;
+  }
+  jcp.nb_ic = jcp.ic / jcp.ic_block;
+  jcp.nb_oc = jcp.oc / jcp.oc_block;
+  jcp.tile_h = div_up(jcp.oh, 2);
+  jcp.tile_w = div_up(jcp.ow, 2);
+  jcp.use_vnni = mayiuse(avx512_core_vnni);
+
+  // acc of ur_t * nb_oc_blocking, weights of nb_oc_blocking, 1 bcast, 1 tmp
+  jcp.nb_oc_blocking = dividable_of(jcp.nb_oc, 4, 2, 1);
+  jcp.ur_t = (32 - 2 - jcp.nb_oc_blocking) / jcp.nb_oc_blocking;
+  if (jcp.tile_w < jcp.ur_t) jcp.ur_t = jcp.tile_w;
+  jcp.ur_t_tail = jcp.tile_w % jcp.ur_t;
+
+  // split oc into chunks only if the tile rows are too few for all threads,
+  // as the src of a tile row is transformed again for each chunk
+  const int nthreads = omp_get_max_threads();
+  const int oc_works = jcp.nb_oc / jcp.nb_oc_blocking;
+  jcp.oc_chunks = 1;
+  while (jcp.bs * jcp.tile_h * jcp.oc_chunks < nthreads &&
+         jcp.oc_chunks < oc_works) {
+    do {
+      jcp.oc_chunks++;
+    } while (oc_works % jcp.oc_chunks != 0);
+  }
+  jcp.nb_oc_chunk = jcp.nb_oc / jcp.oc_chunks;
+
+  jcp.with_bias = bia != nullptr;
+  jcp.bias_dt = jcp.with_bias ? bia->data_type() : data_type::undef;
+  jcp.dst_dt = dst->data_type();
+  jcp.typesize_bia = jcp.with_bias ? dtype_size(jcp.bias_dt) : 0;
+  jcp.typesize_out = dtype_size(jcp.dst_dt);
+  jcp.with_relu = relu;
+  jcp.rmode = rmode;
+  if (!one_of(rmode, round_mode::nearest, round_mode::down)) {
+    return false;
+  }
+
+  jcp.multi_oc_scale = scales.size() > 1;
+  if (!one_of(scales.size(), 1, jcp.oc)) {
+    return false;
+  }
+
+  return true;
+}
+
+}
+}
@@ -0,0 +1,149 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include "jit_call_conf.h"
+#include "jit_generator.h"
+
+namespace deepfusion {
+namespace jit {
+
+// Int8 winograd F(2x2, 3x3) of 3x3 stride 1 conv, on AVX512.
+// With the integer transforms below, all in s16 and the gemm in s32, the
+// result is exactly the same with direct conv:
+//   src: V = B' d B,  B' = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1]
+//   wei: U = G g G',  G = [2 0 0; 1 1 1; 1 -1 1; 0 0 2], 4 times of F(2,3)
+//   dst: Y = A' M A / 4,  A' = [1 1 1 0; 0 1 -1 -1]
+// u8 src gives V in [-1020, 1020] and s8 weights give U in [-1152, 1152].
+// The s32 sums may wrap in between, but Y is exact while 4Y fits in s32.
+bool winograd_init_conf(jit_wino_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &wei,
+                        const std::unique_ptr<memory> &bia,
+                        std::array<int, 2> sz_stride,
+                        std::array<int, 2> sz_padding,
+                        std::unique_ptr<memory> &dst,
+                        const std::vector<float> &scales,
+                        bool relu,
+                        round_mode rmode);
+
+// transform the src of one tile, all ic
+struct jit_wino_src_trans_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_wino_src_trans_kernel);
+
+  jit_wino_src_trans_kernel(jit_wino_conf_t ajcp) : jcp(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_wino_call_t *))getCode();
+  }
+
+  jit_wino_conf_t jcp;
+  void (*jit_ker_)(jit_wino_call_t *);
+
+private:
+  using reg64_t = const Xbyak::Reg64;
+  using zmm_t = const Xbyak::Zmm;
+
+  reg64_t reg_src = r8;  // 16 pixel pointers
+  reg64_t reg_wino_src = r9;
+  reg64_t reg_ic = r10;  // ic offset in bytes of src
+  reg64_t reg_pix = r11;
+  reg64_t reg_cnt = r12;
+
+  zmm_t zmm_d(int i, int j) { return zmm_t(i * 4 + j); }
+  zmm_t zmm_t_(int i, int j) { return zmm_t(16 + i * 4 + j); }
+
+  void generate();
+};
+
+// gemm of one tile element, all tiles of one row and one chunk of oc
+struct jit_wino_gemm_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_wino_gemm_kernel);
+
+  jit_wino_gemm_kernel(jit_wino_conf_t ajcp) : jcp(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_wino_call_t *))getCode();
+  }
+
+  jit_wino_conf_t jcp;
+  void (*jit_ker_)(jit_wino_call_t *);
+
+private:
+  using reg64_t = const Xbyak::Reg64;
+  using zmm_t = const Xbyak::Zmm;
+
+  reg64_t reg_src = r8;
+  reg64_t reg_wei = r9;
+  reg64_t reg_dst = r10;
+  reg64_t aux_reg_src = r11;
+  reg64_t aux_reg_wei = r12;
+  reg64_t reg_ic_cnt = r13;
+  reg64_t reg_oc_cnt = r14;
+  reg64_t reg_t_cnt = r15;
+  reg64_t aux_reg_dst = rax;
+
+  zmm_t zmm_bcast = zmm_t(30);
+  zmm_t zmm_tmp = zmm_t(31);
+
+  zmm_t zmm_acc(int t, int o) {
+    int idx = t * jcp.nb_oc_blocking + o;
+    assert(idx < 30 - jcp.nb_oc_blocking);
+    return zmm_t(idx);
+  }
+  zmm_t zmm_wei(int o) { return zmm_t(30 - jcp.nb_oc_blocking + o); }
+
+  void compute_block(int ur_t);
+  void generate();
+};
+
+// transform the gemm output of one tile to dst, one chunk of oc
+struct jit_wino_dst_trans_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_wino_dst_trans_kernel);
+
+  jit_wino_dst_trans_kernel(jit_wino_conf_t ajcp) : jcp(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_wino_call_t *))getCode();
+  }
+
+  jit_wino_conf_t jcp;
+  void (*jit_ker_)(jit_wino_call_t *);
+
+private:
+  using reg64_t = const Xbyak::Reg64;
+  using zmm_t = const Xbyak::Zmm;
+  using xmm_t = const Xbyak::Xmm;
+
+  reg64_t reg_dst = r8;  // 4 pixel pointers
+  reg64_t reg_wino_dst = r9;
+  reg64_t reg_bias = r10;
+  reg64_t reg_scales = r11;
+  reg64_t reg_oc = r12;  // oc offset in bytes of dst
+  reg64_t reg_pix = r13;
+  reg64_t reg_cnt = r14;
+
+  zmm_t zmm_bias = zmm_t(24);
+  zmm_t zmm_zero = zmm_t(25);
+
+  zmm_t zmm_m(int i, int j) { return zmm_t(i * 4 + j); }
+  zmm_t zmm_r(int i, int j) { return zmm_t(16 + i * 4 + j); }
+  zmm_t zmm_y(int i, int j) { return zmm_t(i * 2 + j); }
+
+  void store_output(int k);
+  void generate();
+};
+
+}
+}
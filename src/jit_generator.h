@@ -15,6 +15,7 @@
 *******************************************************************************/
 #pragma once
 
+#include <cstring>
 #include <type_traits>
 
 #define XBYAK64
@@ -33,6 +34,7 @@
 #include "deepfusion_utils.h"
 #include "xbyak/xbyak.h"
 #include "xbyak/xbyak_util.h"
+#include "log.h"
 
 #define DECLARE_JIT_KERNEL(jit_name)                      \
   const char *name() const override { return #jit_name; } \
@@ -87,9 +89,70 @@ template <>
 struct cpu_isa_traits<avx512_mic_4ops> : public cpu_isa_traits<avx512_common> {
 };
 
+static inline int isa_level(const cpu_isa_t cpu_isa) {
+  switch (cpu_isa) {
+    case isa_any:
+      return 0;
+    case sse42:
+      return 1;
+    case avx2:
+      return 2;
+    case avx512_common:
+    case avx512_mic:
+    case avx512_mic_4ops:
+      return 3;
+    case avx512_core:
+      return 4;
+    case avx512_core_vnni:
+      return 5;
+  }
+  return 0;
+}
+
+// The max ISA level can be used, which can be capped by env, for example:
+// export DEEPFUSION_MAX_ISA=avx2
+// then the kernels of avx2 would be used even on avx512 machine.
+// Not static, so the level is read once and shared by the whole process.
+inline int max_isa_level() {
+  static int level = -1;
+  if (level < 0) {
+    const int len = 32;
+    char env_isa[len] = {0};
+    level = isa_level(avx512_core_vnni);
+    if (utils::_getenv(env_isa, "DEEPFUSION_MAX_ISA", len) > 0) {
+      const struct {
+        const char *name;
+        cpu_isa_t isa;
+      } isa_names[] = {
+          {"any", isa_any},
+          {"sse42", sse42},
+          {"avx2", avx2},
+          {"avx512_common", avx512_common},
+          {"avx512_core", avx512_core},
+          {"avx512_core_vnni", avx512_core_vnni},
+      };
+      bool found = false;
+      for (const auto &it : isa_names) {
+        if (strcmp(env_isa, it.name) == 0) {
+          level = isa_level(it.isa);
+          found = true;
+        }
+      }
+      if (!found) {
+        warning("Unknown DEEPFUSION_MAX_ISA %s, ignored", env_isa);
+      }
+    }
+  }
+  return level;
+}
+
 static inline bool mayiuse(const cpu_isa_t cpu_isa) {
   using namespace Xbyak::util;
 
+  if (isa_level(cpu_isa) > max_isa_level()) {
+    return false;
+  }
+
   switch (cpu_isa) {
     case sse42:
       return cpu.has(Cpu::tSSE42);
@@ -143,6 +206,20 @@ inline unsigned int get_cache_size(int level, bool per_core = true) {
     return 0;
 }
 
+// Use non-temporal store for dst, when it's too large to be consumed from
+// cache, so that the writes do not pollute LLC and avoid RFO.
+// The dst must be 64 bytes aligned.
+inline bool use_streaming_store(const std::unique_ptr<memory> &dst) {
+  if (reinterpret_cast<uintptr_t>(dst->data()) % 64 != 0) {
+    return false;
+  }
+  int mode = utils::streaming_store_mode();
+  if (mode >= 0) {
+    return mode == 1;
+  }
+  return dst->buffer_size() > get_cache_size(3, false);
+}
+
 #ifdef XBYAK64
 constexpr Xbyak::Operand::Code abi_save_gpr_regs[] = {
     Xbyak::Operand::RBX,
@@ -255,6 +332,67 @@ public:
       return zword[re];
   }
 
+  // store vector to memory, with non-temporal hint if nt
+  void uni_vmovups(const Xbyak::Address &addr, const Xbyak::Xmm &x, bool nt) {
+    if (nt) {
+      vmovntps(addr, x);
+    } else {
+      vmovups(addr, x);
+    }
+  }
+
+  // bf16 is converted in software, avx512_bf16 is not needed.
+  // load 16 bf16 to f32 on zmm, or 8 on ymm
+  void load_bf16(const Xbyak::Xmm &x, const Xbyak::Address &addr) {
+    vpmovzxwd(x, addr);
+    vpslld(x, x, 16);
+  }
+
+  // round f32 to nearest even bf16, in the low 16 bits of each dword.
+  // NaN is quieted instead of rounded, which may carry it to inf.
+  // t1 and t2 are clobbered, and k1 on zmm.
+  void cvt_f32_to_bf16(const Xbyak::Xmm &x,
+                       const Xbyak::Xmm &t1,
+                       const Xbyak::Xmm &t2) {
+    // x + 0x7fff + the lowest bit kept
+    vpslld(t1, x, 15);
+    vpsrld(t1, t1, 31);
+    if (x.isZMM()) {
+      vpternlogd(t2, t2, t2, 0xff);
+    } else {
+      vpcmpeqd(t2, t2, t2);
+    }
+    vpsrld(t2, t2, 17);
+    vpaddd(t1, t1, t2);
+    vpaddd(t1, t1, x);
+    // quiet bit 0x400000 of NaN
+    vpsrld(t2, t2, 14);
+    vpslld(t2, t2, 22);
+    if (x.isZMM()) {
+      vcmpps(k1, x, x, 3);  // unordered
+      vpord(t1 | k1, t2, x);
+      vpsrld(x, t1, 16);
+    } else {
+      vpor(t2, t2, x);
+      vcmpunordps(x, x, x);
+      vblendvps(x, t1, t2, x);
+      vpsrld(x, x, 16);
+    }
+  }
+
+  // store the bf16 converted by cvt_f32_to_bf16, x is clobbered
+  void store_bf16(const Xbyak::Address &addr, const Xbyak::Xmm &x, bool nt) {
+    if (x.isZMM()) {
+      vpmovdw(Xbyak::Ymm(x.getIdx()), x);
+      uni_vmovups(addr, Xbyak::Ymm(x.getIdx()), nt);
+    } else {
+      // packs work in each 128 bits lane
+      vpackusdw(x, x, x);
+      vpermq(Xbyak::Ymm(x.getIdx()), Xbyak::Ymm(x.getIdx()), 0xD8);
+      uni_vmovups(addr, Xbyak::Xmm(x.getIdx()), nt);
+    }
+  }
+
   void L(const char *label) { Xbyak::CodeGenerator::L(label); }
   void L(const Xbyak::Label &label) { Xbyak::CodeGenerator::L(label); }
 
@@ -0,0 +1,310 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "jit_inner_product_kernel.h"
+#include "deepfusion_utils.h"
+#include "omp_thread.h"
+
+#define GET_OFF(field) offsetof(jit_ip_call_t, field)
+
+namespace deepfusion {
+namespace jit {
+
+using namespace Xbyak;
+
+// 16 ic of one src pixel, at the offsets from aux_reg_src and reg_wei
+void jit_inner_product_kernel::compute_ic_block(int src_offset,
+                                                int wei_offset) {
+  const int src_row_stride = jcp.ih * jcp.iw * jcp.ic;
+  // OIhw4i16o4i, (ic/16, ih, iw, 4i, 16o, 4i) of each oc block
+  const int wei_oc_stride = jcp.ic * jcp.ih * jcp.iw * jcp.oc_block;
+  auto compute = [=](Zmm vreg_acc, Zmm vreg_wei, Zmm vreg_src) {
+    if (jcp.use_vnni) {
+      vpdpbusd(vreg_acc, vreg_src, vreg_wei);
+    } else {
+      vpmaddubsw(zmm_tmp, vreg_src, vreg_wei);
+      vpmaddwd(zmm_tmp, zmm_tmp, zmm_one);
+      vpaddd(vreg_acc, vreg_acc, zmm_tmp);
+    }
+  };
+
+  for (int ic = 0; ic < jcp.ic_block / 4; ++ic) {
+    for (int n = 0; n < ur_n_; ++n) {
+      int offset = n * src_row_stride + src_offset + 4 * ic;
+      vpbroadcastd(zmm_inp(n), ptr[aux_reg_src + offset]);
+    }
+    for (int o = 0; o < jcp.nb_oc_blocking; ++o) {
+      int offset = o * wei_oc_stride + wei_offset + 4 * ic * jcp.oc_block;
+      vmovups(zmm_wei, EVEX_compress_addr(reg_wei, offset));
+      for (int n = 0; n < ur_n_; ++n) {
+        compute(zmm_out(n, o), zmm_wei, zmm_inp(n));
+      }
+    }
+  }
+}
+
+void jit_inner_product_kernel::store_output() {
+  using data_type = memory::dtype;
+  vpxord(zmm_zero, zmm_zero, zmm_zero);
+  if (oc_tail_) {
+    mov(reg_tmp.cvt32(), (1 << jcp.oc_tail) - 1);
+    kmovw(ktail_mask, reg_tmp.cvt32());
+  }
+  for (int o = 0; o < jcp.nb_oc_blocking; ++o) {
+    // bias, scales and dst have only oc_tail in the last block
+    const bool mask_flag = oc_tail_ && o == jcp.nb_oc_blocking - 1;
+    auto maybe_mask = [=](Zmm zmm) {
+      return mask_flag ? zmm | ktail_mask | T_z : zmm;
+    };
+    if (jcp.with_bias) {
+      auto bias_addr = ptr[reg_bias + jcp.typesize_bia * o * jcp.oc_block];
+      switch (jcp.bias_dt) {
+        case data_type::f32:
+        case data_type::s32:
+          vmovups(maybe_mask(zmm_bias), bias_addr);
+          break;
+        case data_type::s8:
+          vpmovsxbd(maybe_mask(zmm_bias), bias_addr);
+          break;
+        case data_type::u8:
+          vpmovzxbd(maybe_mask(zmm_bias), bias_addr);
+          break;
+        default:
+          assert(!"unsupported bias data type");
+      }
+      if (jcp.bias_dt != data_type::f32) {
+        vcvtdq2ps(zmm_bias, zmm_bias);
+      }
+    }
+    int scale_offset = sizeof(float) * o * jcp.oc_block;
+    for (int n = 0; n < ur_n_; ++n) {
+      Zmm zmm = zmm_out(n, o);
+      Xmm xmm = Xmm(zmm.getIdx());
+      Zmm zmm_k = mask_flag ? zmm | ktail_mask : zmm;
+      vcvtdq2ps(zmm, zmm);
+      if (jcp.with_bias) {
+        vaddps(zmm, zmm, zmm_bias);
+      }
+      if (jcp.multi_oc_scale) {
+        vmulps(maybe_mask(zmm),
+               zmm,
+               EVEX_compress_addr(reg_scales, scale_offset));
+      } else {
+        vmulps(zmm, zmm, zword_b[reg_scales]);
+      }
+      if (jcp.with_relu || jcp.dst_dt == data_type::u8) {
+        vmaxps(zmm, zmm_zero, zmm);
+      }
+      if (jcp.dst_dt != data_type::f32) {
+        if (jcp.rmode == round_mode::nearest)
+          vcvtps2dq(zmm | T_rn_sae, zmm);
+        else if (jcp.rmode == round_mode::down)
+          vcvtps2dq(zmm | T_rd_sae, zmm);
+        else
+          assert(!"unimplemented");
+      }
+      // dst is (bs, oc)
+      int offset = jcp.typesize_out * (n * jcp.oc + o * jcp.oc_block);
+      auto addr = ptr[reg_dst + offset];
+      switch (jcp.dst_dt) {
+        case data_type::f32:
+        case data_type::s32:
+          vmovups(addr, zmm_k);
+          break;
+        case data_type::s8:
+          if (mask_flag) {
+            vpmovsdb(addr, zmm_k);
+          } else {
+            vpmovsdb(xmm, zmm);
+            vmovups(addr, xmm);
+          }
+          break;
+        case data_type::u8:
+          if (mask_flag) {
+            vpmovusdb(addr, zmm_k);
+          } else {
+            vpmovusdb(xmm, zmm);
+            vmovups(addr, xmm);
+          }
+          break;
+        default:
+          assert(!"unknown dst_dt");
+      }
+    }
+  }
+}
+
+void jit_inner_product_kernel::generate() {
+  const int nb_pix = jcp.ih * jcp.iw;
+
+  preamble();
+
+  if (!jcp.use_vnni) {
+    xor_(reg_tmp, reg_tmp);
+    Reg16 _t = reg_tmp.cvt16();
+    mov(_t, 0x1);
+    vpbroadcastw(zmm_one, _t);
+  }
+  mov(reg_src, ptr[param1 + GET_OFF(src)]);
+  mov(reg_wei, ptr[param1 + GET_OFF(wei)]);
+  mov(reg_dst, ptr[param1 + GET_OFF(dst)]);
+  mov(reg_bias, ptr[param1 + GET_OFF(bia)]);
+  mov(reg_scales, ptr[param1 + GET_OFF(scales)]);
+
+  for (int o = 0; o < jcp.nb_oc_blocking; ++o) {
+    for (int n = 0; n < ur_n_; ++n) {
+      vpxord(zmm_out(n, o), zmm_out(n, o), zmm_out(n, o));
+    }
+  }
+
+  // the weights are read once in order, 16 ic of each pixel after another
+  Label icb_loop, pix_loop;
+  if (nb_pix == 1) {
+    // ic blocks are unrolled, without the pixel loop
+    const int icb_unroll = jcp.nb_ic_blocking;
+    mov(aux_reg_src, reg_src);
+    mov(reg_icb, jcp.nb_ic / icb_unroll);
+    L(icb_loop);
+    {
+      for (int icb = 0; icb < icb_unroll; ++icb) {
+        compute_ic_block(icb * jcp.ic_block,
+                         icb * jcp.ic_block * jcp.oc_block);
+      }
+      add(aux_reg_src, icb_unroll * jcp.ic_block);
+      add(reg_wei, icb_unroll * jcp.ic_block * jcp.oc_block);
+      dec(reg_icb);
+      cmp(reg_icb, 0);
+      jg(icb_loop, T_NEAR);
+    }
+  } else {
+    mov(reg_icb, jcp.nb_ic);
+    L(icb_loop);
+    {
+      mov(aux_reg_src, reg_src);
+      mov(reg_pix, nb_pix);
+      L(pix_loop);
+      {
+        compute_ic_block(0, 0);
+        add(aux_reg_src, jcp.ic);
+        add(reg_wei, jcp.ic_block * jcp.oc_block);
+        dec(reg_pix);
+        cmp(reg_pix, 0);
+        jg(pix_loop, T_NEAR);
+      }
+      add(reg_src, jcp.ic_block);
+      dec(reg_icb);
+      cmp(reg_icb, 0);
+      jg(icb_loop, T_NEAR);
+    }
+  }
+
+  store_output();
+
+  postamble();
+}
+
+bool jit_inner_product_kernel::init_conf(jit_ip_conf_t &jcp,
+                                         const std::unique_ptr<memory> &src,
+                                         const std::unique_ptr<memory> &wei,
+                                         const std::unique_ptr<memory> &bia,
+                                         std::unique_ptr<memory> &dst,
+                                         const std::vector<float> &scales,
+                                         bool relu,
+                                         round_mode rmode) {
+  using namespace utils;
+  using data_type = memory::dtype;
+  jcp = zero<decltype(jcp)>();
+  if (!mayiuse(avx512_core)) {
+    return false;
+  }
+  if (!all_true(src->data_type() == data_type::u8,
+                wei->data_type() == data_type::s8,
+                one_of(dst->data_type(),
+                       data_type::f32,
+                       data_type::s32,
+                       data_type::s8,
+                       data_type::u8),
+                bia == nullptr || one_of(bia->data_type(),
+                                         data_type::f32,
+                                         data_type::s32,
+                                         data_type::s8,
+                                         data_type::u8))) {
+    return false;
+  }
+  if (!all_true(src->dim_format() == memory::format::nhwc,
+                dst->dim_format() == memory::format::nhwc,
+                wei->dim_format() == memory::format::OIhw4i16o4i,
+                bia == nullptr || bia->dim_format() == memory::format::x)) {
+    return false;
+  }
+
+  auto src_dims = src->std_dims();  // nchw
+  auto wei_dims = wei->std_dims();  // oihw
+  jcp.bs = src_dims[0];
+  jcp.ic = src_dims[1];
+  jcp.ih = src_dims[2];
+  jcp.iw = src_dims[3];
+  jcp.oc = wei_dims[0];
+  jcp.ic_block = 16;
+  jcp.oc_block = 16;
+  jcp.nb_ic = jcp.ic / jcp.ic_block;
+  // the weights are padded to whole oc blocks, the tail is masked when
+  // stored
+  jcp.nb_oc = div_up(jcp.oc, jcp.oc_block);
+  jcp.oc_tail = jcp.oc % jcp.oc_block;
+  if (jcp.ic % jcp.ic_block != 0) {
+    return false;
+  }
+  jcp.use_vnni = mayiuse(avx512_core_vnni);
+
+  jcp.with_bias = bia != nullptr;
+  jcp.bias_dt = jcp.with_bias ? bia->data_type() : data_type::undef;
+  jcp.dst_dt = dst->data_type();
+  jcp.typesize_bia = jcp.with_bias ? dtype_size(jcp.bias_dt) : 0;
+  jcp.typesize_out = dtype_size(jcp.dst_dt);
+  jcp.with_relu = relu;
+  jcp.rmode = rmode;
+  assert(one_of(jcp.rmode, round_mode::nearest, round_mode::down));
+
+  jcp.nb_ic_blocking = dividable_of(jcp.nb_ic, 4, 2, 1);
+  // the weights are the most of memory traffic, so more rows share each
+  // weights load; but for small batch, the oc blocks are split finer to
+  // keep all threads busy
+  const int nthreads = omp_get_max_threads();
+  jcp.nb_oc_blocking = dividable_of(jcp.nb_oc, 4, 2, 1);
+  while (true) {
+    // the rest 1 size of ur_n is for src input zmm
+    jcp.ur_n = ker_reg_base_idx / (jcp.nb_oc_blocking + 1);
+    if (jcp.bs < jcp.ur_n) jcp.ur_n = jcp.bs;
+    int chunks =
+        div_up(jcp.bs, jcp.ur_n) * (jcp.nb_oc / jcp.nb_oc_blocking);
+    if (chunks >= nthreads || jcp.nb_oc_blocking == 1) {
+      break;
+    }
+    jcp.nb_oc_blocking /= 2;
+  }
+  jcp.ur_n_tail = jcp.bs % jcp.ur_n;
+
+  jcp.multi_oc_scale = scales.size() > 1;
+  if (!one_of(scales.size(), 1, jcp.oc)) {
+    return false;
+  }
+
+  return true;
+}
+
+}
+}
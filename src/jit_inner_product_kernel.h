@@ -0,0 +1,99 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include "jit_call_conf.h"
+#include "jit_generator.h"
+
+namespace deepfusion {
+namespace jit {
+
+// u8 src in nhwc, s8 weights in OIhw4i16o4i, on AVX512.
+// The whole ic of ur_n rows is accumulated in registers, then bias, scales
+// and relu are applied when stored, as the conv kernel. The last oc block
+// of the last oc chunk is masked if oc is not a multiple of 16.
+struct jit_inner_product_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_inner_product_kernel);
+
+  // ur_n is jcp.ur_n, or jcp.ur_n_tail for the last rows, oc_tail is for
+  // the last oc chunk
+  jit_inner_product_kernel(jit_ip_conf_t ajcp, int ur_n, bool oc_tail)
+      : jcp(ajcp), ur_n_(ur_n), oc_tail_(oc_tail) {
+    generate();
+    jit_ker_ = (void (*)(jit_ip_call_t *))getCode();
+  }
+
+  static bool init_conf(jit_ip_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &wei,
+                        const std::unique_ptr<memory> &bia,
+                        std::unique_ptr<memory> &dst,
+                        const std::vector<float> &scales,
+                        bool relu,
+                        round_mode rmode);
+
+  jit_ip_conf_t jcp;
+  void (*jit_ker_)(jit_ip_call_t *);
+
+private:
+  enum {
+    ker_reg_base_idx = 29,
+  };
+
+  using reg64_t = const Xbyak::Reg64;
+  using zmm_t = const Xbyak::Zmm;
+  using xmm_t = const Xbyak::Xmm;
+  using mask_t = const Xbyak::Opmask;
+
+  reg64_t reg_src = r8;
+  reg64_t reg_wei = r9;
+  reg64_t reg_dst = r10;
+  reg64_t aux_reg_src = r11;
+  reg64_t reg_icb = r12;
+  reg64_t reg_pix = r13;
+  reg64_t reg_bias = r14;
+  reg64_t reg_scales = r15;
+  reg64_t reg_tmp = rax;
+
+  zmm_t zmm_tmp = zmm_t(29);
+  zmm_t zmm_one = zmm_t(30);
+  zmm_t zmm_zero = zmm_t(30);  // after compute
+  zmm_t zmm_wei = zmm_t(31);
+  zmm_t zmm_bias = zmm_t(31);  // after compute
+  mask_t ktail_mask = k2;
+
+  int ur_n_;
+  bool oc_tail_;
+
+  zmm_t zmm_out(int n, int o) {
+    int idx = o * ur_n_ + n;
+    assert(idx < ker_reg_base_idx);
+    return zmm_t(idx);
+  }
+  zmm_t zmm_inp(int n) {
+    int idx = jcp.nb_oc_blocking * ur_n_ + n;
+    assert(idx < ker_reg_base_idx);
+    return zmm_t(idx);
+  }
+
+  void compute_ic_block(int src_offset, int wei_offset);
+  void store_output();
+  void generate();
+};
+
+}
+}
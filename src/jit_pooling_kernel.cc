@@ -0,0 +1,301 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "jit_pooling_kernel.h"
+#include "deepfusion_utils.h"
+
+#define GET_OFF(field) offsetof(jit_pooling_call_t, field)
+
+namespace deepfusion {
+namespace jit {
+
+using namespace Xbyak;
+
+Xmm jit_pooling_kernel::vmm(int idx) const {
+  switch (jcp_.bits_size) {
+    case USE_ZMM:
+      return Zmm(idx);
+    case USE_YMM:
+      return Ymm(idx);
+    default:
+      return Xmm(idx);
+  }
+}
+
+// max or sum of ur_c blocks of the pixel at aux_reg_pix
+void jit_pooling_kernel::compute_pixel() {
+  using data_type = memory::dtype;
+  const Xmm vmm_tmp = vmm(idx_tmp);
+  for (int u = 0; u < jcp_.ur_c; ++u) {
+    const Xmm acc = vmm(u);
+    auto src_addr = ptr[aux_reg_pix + u * jcp_.block * jcp_.typesize];
+    if (jcp_.alg == pooling_max) {
+      switch (jcp_.dt) {
+        case data_type::f32:
+          vmaxps(acc, acc, src_addr);
+          break;
+        case data_type::s32:
+          vpmaxsd(acc, acc, src_addr);
+          break;
+        case data_type::s8:
+          vpmaxsb(acc, acc, src_addr);
+          break;
+        case data_type::u8:
+          vpmaxub(acc, acc, src_addr);
+          break;
+        default:
+          assert(!"unsupported data type");
+      }
+    } else {
+      switch (jcp_.dt) {
+        case data_type::f32:
+          vaddps(acc, acc, src_addr);
+          break;
+        case data_type::s32:
+          vpaddd(acc, acc, src_addr);
+          break;
+        case data_type::s8:
+          vpmovsxbd(vmm_tmp, src_addr);
+          vpaddd(acc, acc, vmm_tmp);
+          break;
+        case data_type::u8:
+          vpmovzxbd(vmm_tmp, src_addr);
+          vpaddd(acc, acc, vmm_tmp);
+          break;
+        default:
+          assert(!"unsupported data type");
+      }
+    }
+  }
+}
+
+void jit_pooling_kernel::store_output() {
+  using data_type = memory::dtype;
+  const Xmm vmm_div = vmm(idx_const);
+  for (int u = 0; u < jcp_.ur_c; ++u) {
+    const Xmm acc = vmm(u);
+    auto dst_addr = ptr[reg_dst + u * jcp_.block * jcp_.typesize];
+    if (jcp_.alg == pooling_max) {
+      vmovups(dst_addr, acc);
+      continue;
+    }
+
+    // avg, the same rounding as (float)sum / divisor
+    if (jcp_.dt != data_type::f32) {
+      vcvtdq2ps(acc, acc);
+    }
+    vdivps(acc, acc, vmm_div);
+    if (jcp_.dt != data_type::f32) {
+      if (jcp_.bits_size == USE_ZMM) {
+        if (jcp_.rmode == round_mode::nearest)
+          vcvtps2dq(Zmm(u) | T_rn_sae, Zmm(u));
+        else
+          vcvtps2dq(Zmm(u) | T_rd_sae, Zmm(u));
+      } else {
+        vroundps(acc, acc, jcp_.rmode == round_mode::nearest ? 0 : 1);
+        vcvtps2dq(acc, acc);
+      }
+    }
+    switch (jcp_.dt) {
+      case data_type::f32:
+      case data_type::s32:
+        vmovups(dst_addr, acc);
+        break;
+      case data_type::s8:
+      case data_type::u8:
+        if (jcp_.bits_size == USE_ZMM) {
+          if (jcp_.dt == data_type::s8) {
+            vpmovsdb(Xmm(u), Zmm(u));
+          } else {
+            vpmovusdb(Xmm(u), Zmm(u));
+          }
+          vmovups(dst_addr, Xmm(u));
+          break;
+        }
+        // packs work in each 128 bits lane, get 8 x s16 in low lane first
+        vpackssdw(acc, acc, acc);
+        if (jcp_.bits_size == USE_YMM) {
+          vpermq(Ymm(u), Ymm(u), 0xD8);
+        }
+        if (jcp_.dt == data_type::s8) {
+          vpacksswb(acc, acc, acc);
+        } else {
+          vpackuswb(acc, acc, acc);
+        }
+        if (jcp_.bits_size == USE_YMM) {
+          vmovq(dst_addr, Xmm(u));
+        } else {
+          vmovd(dst_addr, Xmm(u));
+        }
+        break;
+      default:
+        assert(!"unsupported data type");
+    }
+  }
+}
+
+void jit_pooling_kernel::generate() {
+  using data_type = memory::dtype;
+  preamble();
+
+  mov(reg_src, ptr[param + GET_OFF(src)]);
+  mov(reg_dst, ptr[param + GET_OFF(dst)]);
+
+  const Xmm vmm_const = vmm(idx_const);
+  if (jcp_.alg == pooling_max) {
+    // broadcast the lowest value of the data type, as dword
+    uint32_t lowest = 0;
+    switch (jcp_.dt) {
+      case data_type::f32:
+        lowest = 0xff7fffff;  // -FLT_MAX
+        break;
+      case data_type::s32:
+        lowest = 0x80000000;
+        break;
+      case data_type::s8:
+        lowest = 0x80808080;
+        break;
+      case data_type::u8:
+        lowest = 0;
+        break;
+      default:
+        assert(!"unsupported data type");
+    }
+    mov(reg_tmp, lowest);
+    vmovd(Xmm(idx_const), reg_tmp);
+    vpbroadcastd(vmm_const, Xmm(idx_const));
+    for (int u = 0; u < jcp_.ur_c; ++u) {
+      vmovups(vmm(u), vmm_const);
+    }
+  } else {
+    vbroadcastss(vmm_const, ptr[param + GET_OFF(divisor)]);
+    for (int u = 0; u < jcp_.ur_c; ++u) {
+      vxorps(vmm(u), vmm(u), vmm(u));
+    }
+  }
+
+  // the window has one pixel at least
+  Label kh_loop, kw_loop;
+  mov(aux_reg_row, reg_src);
+  mov(reg_kh, dword[param + GET_OFF(kh)]);
+  L(kh_loop);
+  {
+    mov(aux_reg_pix, aux_reg_row);
+    mov(reg_kw, dword[param + GET_OFF(kw)]);
+    L(kw_loop);
+    {
+      compute_pixel();
+      add(aux_reg_pix, jcp_.c * jcp_.typesize);
+      dec(reg_kw);
+      cmp(reg_kw, 0);
+      jg(kw_loop, T_NEAR);
+    }
+    add(aux_reg_row, jcp_.iw * jcp_.c * jcp_.typesize);
+    dec(reg_kh);
+    cmp(reg_kh, 0);
+    jg(kh_loop, T_NEAR);
+  }
+
+  store_output();
+
+  vzeroupper();
+  postamble();
+}
+
+bool jit_pooling_kernel::init_conf(jit_pooling_conf_t &jcp,
+                                   const std::unique_ptr<memory> &src,
+                                   const std::unique_ptr<memory> &dst,
+                                   std::array<int, 2> sz_kernel,
+                                   std::array<int, 2> sz_stride,
+                                   std::array<int, 2> sz_padding,
+                                   pooling_algorithm alg,
+                                   round_mode rmode) {
+  using namespace utils;
+  using data_type = memory::dtype;
+  jcp = zero<decltype(jcp)>();
+  if (!mayiuse(avx2)) {
+    return false;
+  }
+
+  jcp.dt = src->data_type();
+  if (!all_true(dst->data_type() == jcp.dt,
+                one_of(jcp.dt,
+                       data_type::f32,
+                       data_type::s32,
+                       data_type::s8,
+                       data_type::u8),
+                src->dim_format() == memory::format::nhwc,
+                dst->dim_format() == memory::format::nhwc)) {
+    return false;
+  }
+
+  auto src_dims = src->std_dims();  // nchw
+  auto dst_dims = dst->std_dims();  // nchw
+  jcp.bs = src_dims[0];
+  jcp.c = src_dims[1];
+  jcp.ih = src_dims[2];
+  jcp.iw = src_dims[3];
+  jcp.oh = dst_dims[2];
+  jcp.ow = dst_dims[3];
+  jcp.kh = sz_kernel[0];
+  jcp.kw = sz_kernel[1];
+  jcp.sh = sz_stride[0];
+  jcp.sw = sz_stride[1];
+  jcp.t_pad = sz_padding[0];
+  jcp.l_pad = sz_padding[1];
+  jcp.alg = alg;
+  jcp.rmode = rmode;
+  jcp.typesize = dtype_size(jcp.dt);
+  if (alg != pooling_max &&
+      !one_of(jcp.rmode, round_mode::nearest, round_mode::down)) {
+    return false;
+  }
+
+  // max works on the whole vector of any data type, 64, 32 or 16 bytes.
+  // avg works on 16, 8 or 4 channels in s32 or f32.
+  // zmm is only used when avx512 is available
+  std::vector<int> blocks;
+  if (alg == pooling_max) {
+    blocks = {64 / jcp.typesize, 32 / jcp.typesize, 16 / jcp.typesize};
+  } else {
+    blocks = {16, 8, 4};
+  }
+  if (!mayiuse(avx512_core)) {
+    blocks.erase(blocks.begin());
+  }
+  jcp.block = 0;
+  for (int b : blocks) {
+    if (jcp.c % b == 0) {
+      jcp.block = b;
+      break;
+    }
+  }
+  if (jcp.block == 0) {
+    return false;
+  }
+  jcp.bits_size = alg == pooling_max ? 8 * jcp.typesize * jcp.block
+                                     : 8 * sizeof(float) * jcp.block;
+  if (!one_of(jcp.bits_size, USE_XMM, USE_YMM, USE_ZMM)) {
+    return false;
+  }
+  jcp.nb_c = jcp.c / jcp.block;
+  jcp.ur_c = dividable_of(jcp.nb_c, 8, 4, 2, 1);
+
+  return true;
+}
+
+}
+}
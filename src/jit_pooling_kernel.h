@@ -0,0 +1,83 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include "jit_call_conf.h"
+#include "jit_generator.h"
+
+namespace deepfusion {
+namespace jit {
+
+// max or avg pooling of nhwc, vectorized over channels.
+// Max works on the data type itself, avg sums in s32 (f32 for f32 data),
+// then divides and rounds to the data type.
+struct jit_pooling_kernel : public jit_generator {
+  DECLARE_JIT_KERNEL(jit_pooling_kernel);
+
+  jit_pooling_kernel(jit_pooling_conf_t ajcp) : jcp_(ajcp) {
+    generate();
+    jit_ker_ = (void (*)(jit_pooling_call_t *))getCode();
+  }
+
+  static bool init_conf(jit_pooling_conf_t &jcp,
+                        const std::unique_ptr<memory> &src,
+                        const std::unique_ptr<memory> &dst,
+                        std::array<int, 2> sz_kernel,
+                        std::array<int, 2> sz_stride,
+                        std::array<int, 2> sz_padding,
+                        pooling_algorithm alg,
+                        round_mode rmode);
+
+  jit_pooling_conf_t jcp_;
+  void (*jit_ker_)(jit_pooling_call_t *);
+
+private:
+  enum {
+    USE_ZMM = 512,
+    USE_YMM = 256,
+    USE_XMM = 128,
+  };
+
+  using reg64_t = const Xbyak::Reg64;
+  using reg32_t = const Xbyak::Reg32;
+
+  reg64_t param = abi_param1;
+  reg64_t reg_src = r8;
+  reg64_t reg_dst = r9;
+  reg64_t aux_reg_row = r10;
+  reg64_t aux_reg_pix = r11;
+  reg32_t reg_kh = r12d;
+  reg32_t reg_kw = r13d;
+  reg32_t reg_tmp = r14d;
+
+  // the accumulators are 0 .. ur_c-1, all registers are in the low 16, which
+  // can be encoded by VEX on avx2
+  enum {
+    idx_tmp = 14,
+    idx_const = 15,  // the lowest value of max, or the divisor of avg
+  };
+
+  // xmm, ymm or zmm by bits_size
+  Xbyak::Xmm vmm(int idx) const;
+
+  void compute_pixel();
+  void store_output();
+  void generate();
+};
+
+}
+}
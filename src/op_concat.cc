@@ -16,6 +16,7 @@
 
 #include "op_concat.h"
 #include "deepfusion_utils.h"
+#include "trace.h"
 
 namespace deepfusion {
 
@@ -31,16 +32,18 @@ void op_concat<dtype>::infer() {
   if (work_amount < max) {
     #pragma omp parallel for schedule(static) collapse(1)
     for (int iwork = 0; iwork < max; ++iwork) {
+      trace_scope trace("concat_thread");
       int n{0}, h{0}, w{0};
       nd_iterator_init(iwork, n, jcp.bs, h, jcp.h, w, jcp.w);
-      int nhw = n * (jcp.h * jcp.w) + h * (jcp.w) + w;
+      size_t nhw = (size_t)n * (jcp.h * jcp.w) + h * (jcp.w) + w;
       auto srcs = src_with_offset_ + iwork * jcp.n_inputs;
       for (int i = 0; i < jcp.n_inputs; ++i) {
-        srcs[i] = srcs_data_[i] + (nhw * ic_[i]);
+        srcs[i] = srcs_data_[i] + (nhw * ic_[i] * src_typesize_[i]);
       }
       jit::jit_concat_call_t p = {0};
       p.src = reinterpret_cast<const void **>(srcs);
       p.nb_ic = reinterpret_cast<const int *>(nb_ic_);
+      p.scales = scales_;
       p.dst = reinterpret_cast<void *>(dst_data_ + nhw * jcp.oc);
       kernel_->jit_ker_(&p);
     }
@@ -48,6 +51,7 @@ void op_concat<dtype>::infer() {
     // if work amount > max omp threads, need balance
     #pragma omp parallel
     {
+      trace_scope trace("concat_thread");
       int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
       int start{0}, end{0};
       balance211(work_amount, nthr, ithr, start, end);
@@ -56,12 +60,13 @@ void op_concat<dtype>::infer() {
       auto srcs = src_with_offset_ + ithr * jcp.n_inputs;
       jit::jit_concat_call_t p = {0};
       for (int iwork = start; iwork < end; ++iwork) {
-        int nhw = n * (jcp.h * jcp.w) + h * (jcp.w) + w;
+        size_t nhw = (size_t)n * (jcp.h * jcp.w) + h * (jcp.w) + w;
         for (int i = 0; i < jcp.n_inputs; ++i) {
-          srcs[i] = srcs_data_[i] + (nhw * ic_[i]);
+          srcs[i] = srcs_data_[i] + (nhw * ic_[i] * src_typesize_[i]);
         }
         p.src = reinterpret_cast<const void **>(srcs);
         p.nb_ic = reinterpret_cast<const int *>(nb_ic_);
+        p.scales = scales_;
         p.dst = reinterpret_cast<void *>(dst_data_ + nhw * jcp.oc);
         // one kernel move one dst oc from all srcs
         kernel_->jit_ker_(&p);
@@ -75,5 +80,6 @@ template class op_concat<f32>;
 template class op_concat<s32>;
 template class op_concat<s8>;
 template class op_concat<u8>;
+template class op_concat<bf16>;
 
 }
@@ -27,10 +27,12 @@ class op_concat : public op {
 public:
   explicit op_concat(const std::vector<std::unique_ptr<memory>> &srcs,
                      std::unique_ptr<memory> &dst,
-                     bool post_relu = false)
-      : op() {
+                     bool post_relu = false,
+                     const std::vector<float> &scales = {},
+                     round_mode rmode = round_mode::nearest)
+      : op(), scales_(nullptr) {
     jit::jit_concat_conf_t conf;
-    if (!init_conf(conf, srcs, dst, post_relu)) {
+    if (!init_conf(conf, srcs, dst, post_relu, scales, rmode)) {
       error_and_exit("Init Concat op failed!");
     }
 
@@ -40,9 +42,17 @@ public:
     const int num_srcs = jcp.n_inputs;
     assert(num_srcs == srcs.size());
 
-    srcs_data_ = (const dtype **)utils::aligned_malloc(num_srcs * sizeof(dtype *), 64);
+    srcs_data_ = (const char **)utils::aligned_malloc(num_srcs * sizeof(char *), 64);
     ic_ = (int *)utils::aligned_malloc(num_srcs * sizeof(int), 64);
     nb_ic_ = (int *)utils::aligned_malloc(num_srcs * sizeof(int), 64);
+    src_typesize_ = (int *)utils::aligned_malloc(num_srcs * sizeof(int), 64);
+    if (jcp.with_scales) {
+      // keep a copy, the scales vector may be gone when infer
+      scales_ = (float *)utils::aligned_malloc(num_srcs * sizeof(float), 64);
+      for (int i = 0; i < num_srcs; ++i) {
+        scales_[i] = scales[i];
+      }
+    }
 
     for (int i = 0; i < num_srcs; ++i) {
       auto dim = srcs[i]->actual_dims();
@@ -51,19 +61,24 @@ public:
       nb_ic_[i] = ic_[i] / jcp.block;
       check_eq(nb_ic_[i] * jcp.block, ic_[i]);
       // XXX the src data pointer is determined here, if need update when infer should change API
-      srcs_data_[i] = reinterpret_cast<const dtype *>(srcs[i]->data());
+      srcs_data_[i] = reinterpret_cast<const char *>(srcs[i]->data());
+      src_typesize_[i] = utils::dtype_size(srcs[i]->data_type());
     }
     dst_data_ = (dtype *)dst->data();
 
     const int nthreads = omp_get_max_threads();
     debug("Concat: Max OMP threads: %d", nthreads);
-    src_with_offset_ = (const dtype **)utils::aligned_malloc(nthreads * num_srcs * sizeof(dtype *), 4096);
+    src_with_offset_ = (const char **)utils::aligned_malloc(nthreads * num_srcs * sizeof(char *), 4096);
   }
 
   ~op_concat() {
     utils::aligned_free(ic_);
     utils::aligned_free(nb_ic_);
+    utils::aligned_free(src_typesize_);
     utils::aligned_free(srcs_data_);
+    if (scales_) {
+      utils::aligned_free(scales_);
+    }
     utils::aligned_free(src_with_offset_);
     delete kernel_;
   }
@@ -72,11 +87,13 @@ protected:
   bool init_conf(jit::jit_concat_conf_t &conf,
                  const std::vector<std::unique_ptr<memory>> &srcs,
                  const std::unique_ptr<memory> &dst,
-                 bool post_relu = false) {
+                 bool post_relu,
+                 const std::vector<float> &scales,
+                 round_mode rmode) {
     /* TODO can add more init of op_concat itself
             before run into kernel init_conf
     */
-    return jit::jit_concat_kernel::init_conf(conf, srcs, dst, post_relu);
+    return jit::jit_concat_kernel::init_conf(conf, srcs, dst, post_relu, scales, rmode);
   }
 
   void infer() override;
@@ -86,10 +103,12 @@ protected:
 private:
   jit::jit_concat_kernel *kernel_;
   dtype *dst_data_;
-  const dtype **srcs_data_;
-  const dtype **src_with_offset_;
+  const char **srcs_data_;
+  const char **src_with_offset_;
+  int *src_typesize_;
   int *ic_;
   int *nb_ic_;
+  float *scales_;
 };
 
 }
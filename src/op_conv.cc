@@ -16,11 +16,12 @@
 
 #include "op_conv.h"
 #include "deepfusion_utils.h"
+#include "trace.h"
 
 namespace deepfusion {
 
-template <typename dst_data_t>
-void op_conv<dst_data_t>::infer() {
+template <typename dst_data_t, typename src_data_t>
+void op_conv<dst_data_t, src_data_t>::infer() {
   if (fuse_conv1x1_) {
     infer_conv0conv1();
   } else {
@@ -28,16 +29,17 @@ void op_conv<dst_data_t>::infer() {
   }
 }
 
-template <typename dst_data_t>
-void op_conv<dst_data_t>::infer_conv0() {
+template <typename dst_data_t, typename src_data_t>
+void op_conv<dst_data_t, src_data_t>::infer_conv0() {
   using namespace utils;
-  const auto &jcp = kernel_->jcp;
+  const auto &jcp = jcp_;
   assert(jcp.nb_oc % jcp.nb_oc_blocking == 0);
   // bias data type can be any of u8,s8,s32,f32
   auto bias_data = reinterpret_cast<const char *>(bia_data_);
 
   #pragma omp parallel
   {
+    trace_scope trace("conv_thread");
     int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
     int oc_chunks = jcp.nb_oc / jcp.nb_oc_blocking;
     int ic_chunks = jcp.nb_ic / jcp.nb_ic_blocking;
@@ -48,11 +50,13 @@ void op_conv<dst_data_t>::infer_conv0() {
 
     jit::jit_conv_call_t p = {0};
     auto ws_l = ws_ + ithr * ws_per_thread_;
-    size_t src_h_stride = jcp.iw * jcp.ic;
-    size_t dst_h_stride = jcp.ow * jcp.oc;
-    // TODO: below stride should be wrong!
-    size_t wht_h_stride = jcp.kw;
-    size_t wht_ic_stride = jcp.kh * jcp.kw;
+    // src and dst are nhwc, weights are OIhw4i16o4i
+    size_t src_h_stride = jcp.iw * jcp.ic * jcp.gp;
+    size_t dst_h_stride = jcp.ow * jcp.oc * jcp.gp;
+    size_t wht_h_stride = jcp.kw * jcp.ic_block * jcp.oc_block;
+    size_t wht_ic_stride = jcp.kh * wht_h_stride;
+    size_t wht_oc_stride = jcp.ic * jcp.kh * jcp.kw;
+    const int dh = jcp.dilate_h + 1;
 
     int n{0}, g{0}, occ{0}, oh_s{0};
     if (jcp.loop_order == loop_cgn) {  // this is default
@@ -77,21 +81,18 @@ void op_conv<dst_data_t>::infer_conv0() {
       int ih_s = -jcp.t_pad + oh_s * jcp.sh;
       int oh_e = oh_s + work_rem > jcp.oh ? jcp.oh : oh_s + work_rem;
 
-      auto bias_w = bias_data
-                        ? bias_data + ((size_t)g_oc * jcp.oc / jcp.gp *
-                                       jcp.typesize_conv0_bia)
-                        : 0;
-      auto dst_w = dst_data_ + (size_t)n * jcp.oc * jcp.oh * jcp.ow +
-                   g_oc * jcp.oh * jcp.ow + oh_s * jcp.ow;
-      auto src_w = src_data_ + (size_t)n * jcp.ic * jcp.ih * jcp.iw +
-                   g_ic * jcp.ih * jcp.iw + ih_s * jcp.iw;
+      auto bias_w =
+          bias_data ? bias_data + (size_t)g_oc * jcp.typesize_conv0_bia : 0;
+      auto dst_w = dst_data_ + (size_t)n * jcp.oh * dst_h_stride +
+                   oh_s * dst_h_stride + g_oc;
+      // ih_s is negative in top padding, p.src is shifted back below
+      auto src_w = src_data_ + (size_t)n * jcp.ih * src_h_stride +
+                   (ptrdiff_t)ih_s * (ptrdiff_t)src_h_stride + g_ic;
       auto wht_w =
-          wei_data_ + (jcp.gp > 1 ? ((size_t)g * jcp.oc * jcp.ic * jcp.kh *
-                                         jcp.kw / jcp.gp +
-                                     ocb * jcp.ic * jcp.kh * jcp.kw / jcp.gp)
-                                  : ((size_t)ocb * jcp.ic * jcp.kh * jcp.kw));
-      auto scales =
-          conv0_scales_data_ ? conv0_scales_data_ + g_oc : conv0_scales_data_;
+          wei_data_ + (size_t)(g * jcp.nb_oc + ocb) * jcp.oc_block *
+                          wht_oc_stride;
+      auto scales = jcp.conv0_multi_oc_scale ? conv0_scales_data_ + g_oc
+                                             : conv0_scales_data_;
 
       for (int icc = 0; icc < ic_chunks; ++icc) {
         auto src_c = src_w;
@@ -99,11 +100,13 @@ void op_conv<dst_data_t>::infer_conv0() {
         auto ws_c = ws_l;
         int icb = icc * jcp.nb_ic_blocking;
         for (int oj = oh_s, ij = ih_s; oj < oh_e; ++oj, ij += jcp.sh) {
-          int i_t_overflow = -std::min(0, ij);
-          int i_b_overflow = std::max(jcp.ih, ij + jcp.kh) - jcp.ih;
+          // kernel rows in top and bottom padding
+          int i_t_overflow = div_up(std::max(0, -ij), dh);
+          int ij_e = ij + (jcp.kh - 1) * dh + 1;  // past the last row
+          int i_b_overflow = div_up(std::max(jcp.ih, ij_e) - jcp.ih, dh);
           int kh_padding = std::max(0, jcp.kh - i_t_overflow - i_b_overflow);
 
-          p.src = src_c + i_t_overflow * src_h_stride;
+          p.src = src_c + i_t_overflow * dh * src_h_stride;
           p.wei = wht_w + i_t_overflow * wht_h_stride;
           p.bia = bias_w;
           p.acc_s32 = ws_c;
@@ -111,7 +114,7 @@ void op_conv<dst_data_t>::infer_conv0() {
           p.kh_padding = kh_padding;
           p.scales = scales;
           p.dst = dst_c;
-          kernel_->jit_ker_(&p);
+          jit_ker_(&p);
 
           src_c += src_h_stride * jcp.sh;
           dst_c += dst_h_stride;
@@ -137,10 +140,10 @@ void op_conv<dst_data_t>::infer_conv0() {
   }
 }
 
-template <typename dst_data_t>
-void op_conv<dst_data_t>::infer_conv0conv1() {
+template <typename dst_data_t, typename src_data_t>
+void op_conv<dst_data_t, src_data_t>::infer_conv0conv1() {
   using namespace utils;
-  const auto &jcp = kernel_->jcp;
+  const auto &jcp = jcp_;
   assert(jcp.nb_oc % jcp.nb_oc_blocking == 0);
   assert(jcp.oc1x1 == jcp.nb_oc1x1 * jcp.oc1x1_block);
   // bias data type can be any of u8, s8, s32, f32
@@ -148,6 +151,7 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
 
   #pragma omp parallel
   {
+    trace_scope trace("conv_thread");
     int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
     int oc_chunks = jcp.nb_oc / jcp.nb_oc_blocking;
     int ic_chunks = jcp.nb_ic / jcp.nb_ic_blocking;
@@ -159,11 +163,14 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
     auto ws_l = ws_ + ithr * ws_per_thread_;
     auto ws1x1_l = ws1x1_ + ithr * ws1x1_per_thread_;
 
-    size_t src_h_stride = jcp.iw * jcp.ic;
+    // src and dst are nhwc, weights are OIhw4i16o4i
+    size_t src_h_stride = jcp.iw * jcp.ic * jcp.gp;
     size_t out1x1_h_stride = jcp.ow * jcp.oc1x1;
     size_t acc1x1_h_stride = jcp.ow * jcp.oc1x1;
-    size_t wht_h_stride = jcp.kw;
-    size_t wht_ic_stride = jcp.kh * jcp.kw;
+    size_t wht_h_stride = jcp.kw * jcp.ic_block * jcp.oc_block;
+    size_t wht_ic_stride = jcp.kh * wht_h_stride;
+    size_t wht_oc_stride = jcp.ic * jcp.kh * jcp.kw;
+    const int dh = jcp.dilate_h + 1;
 
     int n{0}, g{0}, oh_s{0};
     if (jcp.loop_order == loop_cgn) {  // this is default
@@ -193,19 +200,16 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
         int ih_s = -jcp.t_pad + oh_s * jcp.sh;
         int oh_e = oh_s + work_rem > jcp.oh ? jcp.oh : oh_s + work_rem;
 
-        auto bias_w = bias_data
-                          ? bias_data + ((size_t)g_oc * jcp.oc / jcp.gp *
-                                         jcp.typesize_conv0_bia)
-                          : 0;
-        auto src_w = src_data_ + (size_t)n * jcp.ic * jcp.ih * jcp.iw +
-                     g_ic * jcp.ih * jcp.iw + ih_s * jcp.iw;
+        auto bias_w =
+            bias_data ? bias_data + (size_t)g_oc * jcp.typesize_conv0_bia : 0;
+        // ih_s is negative in top padding, p.src is shifted back below
+        auto src_w = src_data_ + (size_t)n * jcp.ih * src_h_stride +
+                     (ptrdiff_t)ih_s * (ptrdiff_t)src_h_stride + g_ic;
         auto wht_w =
-            wei_data_ + (jcp.gp > 1 ? ((size_t)g * jcp.oc * jcp.ic * jcp.kh *
-                                           jcp.kw / jcp.gp +
-                                       ocb * jcp.ic * jcp.kh * jcp.kw / jcp.gp)
-                                    : ((size_t)ocb * jcp.ic * jcp.kh * jcp.kw));
-        auto scales =
-            conv0_scales_data_ ? conv0_scales_data_ + g_oc : conv0_scales_data_;
+            wei_data_ + (size_t)(g * jcp.nb_oc + ocb) * jcp.oc_block *
+                            wht_oc_stride;
+        auto scales = jcp.conv0_multi_oc_scale ? conv0_scales_data_ + g_oc
+                                               : conv0_scales_data_;
 
         for (int icc = 0; icc < ic_chunks; ++icc) {
           auto src_c = src_w;
@@ -215,11 +219,13 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
 
           int icb = icc * jcp.nb_ic_blocking;
           for (int oj = oh_s, ij = ih_s; oj < oh_e; ++oj, ij += jcp.sh) {
-            int i_t_overflow = -std::min(0, ij);
-            int i_b_overflow = std::max(jcp.ih, ij + jcp.kh) - jcp.ih;
+            // kernel rows in top and bottom padding
+            int i_t_overflow = div_up(std::max(0, -ij), dh);
+            int ij_e = ij + (jcp.kh - 1) * dh + 1;  // past the last row
+            int i_b_overflow = div_up(std::max(jcp.ih, ij_e) - jcp.ih, dh);
             int kh_padding = std::max(0, jcp.kh - i_t_overflow - i_b_overflow);
 
-            p.src = src_c + i_t_overflow * src_h_stride;
+            p.src = src_c + i_t_overflow * dh * src_h_stride;
             p.wei = wht_w + i_t_overflow * wht_h_stride;
             p.bia = bias_w;
             p.acc_s32 = ws_c;
@@ -235,7 +241,7 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
             p.dst = out1x1_c;     // shoud have ow offset in kernel
             p.scales1x1 = scales1x1;
 
-            kernel_->jit_ker_(&p);
+            jit_ker_(&p);
 
             src_c += src_h_stride * jcp.sh;
             out1x1_c += out1x1_h_stride;
@@ -259,23 +265,25 @@ void op_conv<dst_data_t>::infer_conv0conv1() {
   }
 }
 
-template <typename dst_data_t>
-bool op_conv<dst_data_t>::init_conf(jit::jit_conv_conf_t &conf,
-                                    const std::unique_ptr<memory> &src,
-                                    const std::unique_ptr<memory> &wei,
-                                    const std::unique_ptr<memory> &bia,
-                                    int ngroups,
-                                    std::array<int, 2> sz_stride,
-                                    std::array<int, 2> sz_padding,
-                                    std::unique_ptr<memory> &dst,
-                                    std::vector<float> conv0_scales,
-                                    std::vector<float> conv1_scales,
-                                    const std::unique_ptr<memory> &wei1x1,
-                                    const std::unique_ptr<memory> &bia1x1,
-                                    bool conv0_relu,
-                                    bool conv1_relu,
-                                    round_mode conv0_round_mode,
-                                    round_mode conv1_round_mode) {
+template <typename dst_data_t, typename src_data_t>
+bool op_conv<dst_data_t, src_data_t>::init_conf(
+    jit::jit_conv_conf_t &conf,
+    const std::unique_ptr<memory> &src,
+    const std::unique_ptr<memory> &wei,
+    const std::unique_ptr<memory> &bia,
+    int ngroups,
+    std::array<int, 2> sz_stride,
+    std::array<int, 2> sz_padding,
+    std::array<int, 2> sz_dilation,
+    std::unique_ptr<memory> &dst,
+    std::vector<float> conv0_scales,
+    std::vector<float> conv1_scales,
+    const std::unique_ptr<memory> &wei1x1,
+    const std::unique_ptr<memory> &bia1x1,
+    bool conv0_relu,
+    bool conv1_relu,
+    round_mode conv0_round_mode,
+    round_mode conv1_round_mode) {
   using namespace utils;
   // check data type
   if (dst->data_type() != type2dtype<dst_data_t>::dtype) {
@@ -288,10 +296,16 @@ bool op_conv<dst_data_t>::init_conf(jit::jit_conv_conf_t &conf,
   auto src_dims = src->std_dims();    // nchw
   auto wei_dims = wei->std_dims();    // oihw
   auto dst_dims = dst->std_dims();    // nchw
-  for (size_t i = 0; i < 2; ++i) {
-    if (dst_dims[i + 2] !=
-        conv_output_size(
-            src_dims[i + 2], wei_dims[i + 2], sz_stride[i], sz_padding[i])) {
+  for (int i = 0; i < 2; ++i) {
+    if (sz_dilation[i] < 1) {
+      info("Dilation should be 1 at least: %d", i);
+      return false;
+    }
+    if (dst_dims[i + 2] != conv_output_size(src_dims[i + 2],
+                                            wei_dims[i + 2],
+                                            sz_stride[i],
+                                            sz_padding[i],
+                                            sz_dilation[i])) {
       info("Output image size do not match: %d", i);
       return false;
     }
@@ -346,27 +360,36 @@ bool op_conv<dst_data_t>::init_conf(jit::jit_conv_conf_t &conf,
   }
 
   check_eq(ngroups, 1);  // only verified gp==1 yet
-  return jit::jit_conv_kernel::init_conf(conf,
-                                         src,
-                                         wei,
-                                         bia,
-                                         ngroups,
-                                         sz_stride,
-                                         sz_padding,
-                                         dst,
-                                         conv0_scales,
-                                         conv1_scales,
-                                         wei1x1,
-                                         bia1x1,
-                                         conv0_relu,
-                                         conv1_relu,
-                                         conv0_round_mode,
-                                         conv1_round_mode);
+  auto kernel_init_conf = is_f32 ? jit::jit_conv_f32_kernel::init_conf
+                          : isa_ == jit::avx512_core
+                              ? jit::jit_conv_kernel::init_conf
+                              : jit::jit_conv_avx2_kernel::init_conf;
+  return kernel_init_conf(conf,
+                          src,
+                          wei,
+                          bia,
+                          ngroups,
+                          sz_stride,
+                          sz_padding,
+                          sz_dilation,
+                          dst,
+                          conv0_scales,
+                          conv1_scales,
+                          wei1x1,
+                          bia1x1,
+                          conv0_relu,
+                          conv1_relu,
+                          conv0_round_mode,
+                          conv1_round_mode);
 }
 
 template class op_conv<f32>;
 template class op_conv<s32>;
 template class op_conv<s8>;
 template class op_conv<u8>;
+template class op_conv<f32, f32>;
+template class op_conv<bf16, f32>;
+template class op_conv<f32, bf16>;
+template class op_conv<bf16, bf16>;
 
 }
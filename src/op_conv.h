@@ -17,18 +17,23 @@
 #pragma once
 
 #include <deepfusion.h>
+#include <type_traits>
+#include "jit_conv_avx2_kernel.h"
+#include "jit_conv_f32_kernel.h"
 #include "jit_conv_kernel.h"
 #include "log.h"
 #include "omp_thread.h"
 
 namespace deepfusion {
 
-template <typename dst_data_t>
+// int8 conv of u8 src and s8 weights, or f32 conv of f32 weights, whose src
+// and dst can be stored in bf16
+template <typename dst_data_t, typename src_data_t = u8>
 class op_conv : public op {
-  typedef u8 src_data_t;
-  typedef s8 wei_data_t;
-  // typedef s32 bia_data_t;
-  typedef s32 acc_data_t;
+  static constexpr bool is_f32 = std::is_same<src_data_t, f32>::value ||
+                                 std::is_same<src_data_t, bf16>::value;
+  typedef typename std::conditional<is_f32, f32, s8>::type wei_data_t;
+  typedef typename std::conditional<is_f32, f32, s32>::type acc_data_t;
 
 public:
   explicit op_conv(const std::unique_ptr<memory> &src,
@@ -36,6 +41,7 @@ public:
                    const std::unique_ptr<memory> &bia,
                    std::array<int, 2> sz_stride,
                    std::array<int, 2> sz_padding,
+                   std::array<int, 2> sz_dilation,
                    std::unique_ptr<memory> &dst,
                    // TODO: change to const &
                    std::vector<float> conv0_scales = {1.f},
@@ -47,6 +53,20 @@ public:
                    round_mode conv0_round_mode = round_mode::nearest,
                    round_mode conv1_round_mode = round_mode::nearest)
       : op(), fuse_conv1x1_(wei1x1 != nullptr) {
+    // pick kernel by runtime ISA
+    if (is_f32) {
+      if (!jit::mayiuse(jit::avx512_core)) {
+        error_and_exit("F32 Conv op requires AVX512!");
+      }
+      isa_ = jit::avx512_core;
+    } else if (jit::mayiuse(jit::avx512_core)) {
+      isa_ = jit::avx512_core;
+    } else if (jit::mayiuse(jit::avx2)) {
+      isa_ = jit::avx2;
+    } else {
+      error_and_exit("Conv op requires AVX2 or AVX512!");
+    }
+
     jit::jit_conv_conf_t conf;
     if (!init_conf(conf,
                    src,
@@ -55,6 +75,7 @@ public:
                    1,
                    sz_stride,
                    sz_padding,
+                   sz_dilation,
                    dst,
                    conv0_scales,
                    conv1_scales,
@@ -67,16 +88,58 @@ public:
       error_and_exit("Init Conv op failed!");
     }
 
-    kernel_ = new jit::jit_conv_kernel(conf);
-    const auto &jcp = kernel_->jcp;
+    if (is_f32) {
+      auto kernel = new jit::jit_conv_f32_kernel(conf);
+      jit_ker_ = kernel->jit_ker_;
+      kernel_ = kernel;
+    } else if (isa_ == jit::avx512_core) {
+      auto kernel = new jit::jit_conv_kernel(conf);
+      jit_ker_ = kernel->jit_ker_;
+      kernel_ = kernel;
+    } else {
+      auto kernel = new jit::jit_conv_avx2_kernel(conf);
+      jit_ker_ = kernel->jit_ker_;
+      kernel_ = kernel;
+    }
+    jcp_ = conf;
+    const auto &jcp = jcp_;
     const int nthreads = omp_get_max_threads();
-    ws_per_thread_ = jcp.oh * jcp.ow * jcp.oc_block * jcp.nb_oc_blocking;
-    ws_ = (acc_data_t *)utils::aligned_malloc(
-        nthreads * ws_per_thread_ * sizeof(acc_data_t), 4096);  // page align here
+    nthreads_ = nthreads;
+    // workspace of each thread is in whole pages, 2MB ones for huge pages
+    ws_page_ = memory::page_default;
+    ws_per_thread_ =
+        utils::page_slice_size((size_t)jcp.oh * jcp.ow * jcp.oc_block *
+                                   jcp.nb_oc_blocking * sizeof(acc_data_t),
+                               ws_page_) /
+        sizeof(acc_data_t);
+    ws_ = (acc_data_t *)utils::page_malloc(
+        nthreads * ws_per_thread_ * sizeof(acc_data_t),
+        utils::page_size,
+        ws_page_);
     // acc format (h, oc/16, ow, 16o)
-    ws1x1_per_thread_ = jcp.oh * jcp.ow * jcp.oc1x1;
-    ws1x1_ = (acc_data_t *)utils::aligned_malloc(
-        nthreads * ws1x1_per_thread_ * sizeof(acc_data_t), 4096);  // page align here
+    ws1x1_page_ = memory::page_default;
+    ws1x1_per_thread_ =
+        utils::page_slice_size(
+            (size_t)jcp.oh * jcp.ow * jcp.oc1x1 * sizeof(acc_data_t),
+            ws1x1_page_) /
+        sizeof(acc_data_t);
+    ws1x1_ = (acc_data_t *)utils::page_malloc(
+        nthreads * ws1x1_per_thread_ * sizeof(acc_data_t),
+        utils::page_size,
+        ws1x1_page_);
+    // first touched by its own thread, to be on the node (socket) using it
+    #pragma omp parallel
+    {
+      const int ithr = omp_get_thread_num();
+      if (ithr < nthreads) {
+        memset(ws_ + ithr * ws_per_thread_,
+               0,
+               ws_per_thread_ * sizeof(acc_data_t));
+        memset(ws1x1_ + ithr * ws1x1_per_thread_,
+               0,
+               ws1x1_per_thread_ * sizeof(acc_data_t));
+      }
+    }
 
     // TODO enable update data handle from outside
     src_data_ = reinterpret_cast<const src_data_t *>(src->data());
@@ -90,14 +153,19 @@ public:
     bia1x1_data_ = bia1x1 != nullptr
                        ? reinterpret_cast<const void *>(bia1x1->data())
                        : NULL;
-    // TODO: do not save pointor, save buffer instead
-    conv0_scales_data_ = reinterpret_cast<const float *>(conv0_scales.data());
-    conv1_scales_data_ = reinterpret_cast<const float *>(conv1_scales.data());
+    // keep a copy, the vectors given are temporaries
+    conv0_scales_ = conv0_scales;
+    conv1_scales_ = conv1_scales;
+    conv0_scales_data_ = conv0_scales_.data();
+    conv1_scales_data_ = conv1_scales_.data();
   }
 
   ~op_conv() {
-    utils::aligned_free(ws_);
-    utils::aligned_free(ws1x1_);
+    utils::page_free(
+        ws_, nthreads_ * ws_per_thread_ * sizeof(acc_data_t), ws_page_);
+    utils::page_free(ws1x1_,
+                     nthreads_ * ws1x1_per_thread_ * sizeof(acc_data_t),
+                     ws1x1_page_);
     delete kernel_;
   }
 
@@ -109,6 +177,7 @@ protected:
                  int ngroups,  // only enabled on conv0
                  std::array<int, 2> sz_stride,
                  std::array<int, 2> sz_padding,
+                 std::array<int, 2> sz_dilation,
                  std::unique_ptr<memory> &dst,
                  std::vector<float> conv0_scales,
                  std::vector<float> conv1_scales,
@@ -129,13 +198,19 @@ private:
   const src_data_t *src_data_;
   const wei_data_t *wei_data_, *wei1x1_data_;
   const void *bia_data_, *bia1x1_data_;
+  std::vector<float> conv0_scales_, conv1_scales_;
   const float *conv0_scales_data_, *conv1_scales_data_;
   dst_data_t *dst_data_;
-  jit::jit_conv_kernel *kernel_;
+  jit::cpu_isa_t isa_;
+  jit::jit_generator *kernel_;
+  jit::jit_conv_conf_t jcp_;
+  void (*jit_ker_)(jit::jit_conv_call_t *);
   size_t ws_per_thread_;
   size_t ws1x1_per_thread_;
   acc_data_t *ws_;
   acc_data_t *ws1x1_;
+  memory::page_mode ws_page_, ws1x1_page_;
+  int nthreads_;  // workspace allocated for
 };
 
 }
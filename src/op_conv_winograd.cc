@@ -0,0 +1,226 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "op_conv_winograd.h"
+#include "deepfusion_utils.h"
+#include "trace.h"
+
+namespace deepfusion {
+
+template <typename dst_data_t>
+op_conv_winograd<dst_data_t>::op_conv_winograd(
+    const std::unique_ptr<memory> &src,
+    const std::unique_ptr<memory> &wei,
+    const std::unique_ptr<memory> &bia,
+    std::array<int, 2> sz_stride,
+    std::array<int, 2> sz_padding,
+    std::unique_ptr<memory> &dst,
+    std::vector<float> scales,
+    bool relu,
+    round_mode rmode)
+    : op() {
+  if (dst->data_type() != utils::type2dtype<dst_data_t>::dtype) {
+    error_and_exit("Dst data type do not match");
+  }
+  if (!jit::winograd_init_conf(jcp_,
+                               src,
+                               wei,
+                               bia,
+                               sz_stride,
+                               sz_padding,
+                               dst,
+                               scales,
+                               relu,
+                               rmode)) {
+    error_and_exit("Init Winograd Conv op failed!");
+  }
+  const auto &jcp = jcp_;
+  src_trans_ = new jit::jit_wino_src_trans_kernel(jcp);
+  gemm_ = new jit::jit_wino_gemm_kernel(jcp);
+  dst_trans_ = new jit::jit_wino_dst_trans_kernel(jcp);
+
+  wino_wei_ = (int16_t *)utils::aligned_malloc(
+      16 * jcp.oc * jcp.ic * sizeof(int16_t), 64);
+  transform_weights(reinterpret_cast<const s8 *>(wei->data()));
+  zeros_ = (u8 *)utils::aligned_malloc(jcp.ic, 64);
+  memset(zeros_, 0, jcp.ic);
+
+  const int nthreads = omp_get_max_threads();
+  nthreads_ = nthreads;
+  ws_src_size_ = 16 * jcp.tile_w * jcp.ic * sizeof(int16_t);
+  ws_dst_size_ =
+      16 * jcp.tile_w * jcp.nb_oc_chunk * jcp.oc_block * sizeof(s32);
+  // in whole pages, 2MB ones for huge pages
+  ws_page_ = memory::page_default;
+  ws_per_thread_ = utils::page_slice_size(
+      ws_src_size_ + ws_dst_size_ + jcp.oc * jcp.typesize_out, ws_page_);
+  ws_ = (char *)utils::page_malloc(
+      nthreads * ws_per_thread_, utils::page_size, ws_page_);
+  // first touched by its own thread, to be on the node (socket) using it
+  #pragma omp parallel
+  {
+    const int ithr = omp_get_thread_num();
+    if (ithr < nthreads) {
+      memset(ws_ + ithr * ws_per_thread_, 0, ws_per_thread_);
+    }
+  }
+
+  src_data_ = reinterpret_cast<const u8 *>(src->data());
+  dst_data_ = reinterpret_cast<dst_data_t *>(dst->data());
+  bia_data_ =
+      bia != nullptr ? reinterpret_cast<const void *>(bia->data()) : NULL;
+  scales_ = scales;
+}
+
+template <typename dst_data_t>
+op_conv_winograd<dst_data_t>::~op_conv_winograd() {
+  utils::page_free(ws_, nthreads_ * ws_per_thread_, ws_page_);
+  utils::aligned_free(wino_wei_);
+  utils::aligned_free(zeros_);
+  delete src_trans_;
+  delete gemm_;
+  delete dst_trans_;
+}
+
+// U = G g G' of each oc and ic, from OIhw4i16o4i to (16, oc/16, ic/2, 16o, 2i)
+template <typename dst_data_t>
+void op_conv_winograd<dst_data_t>::transform_weights(const s8 *wei) {
+  const auto &jcp = jcp_;
+  const int ic = jcp.ic, oc = jcp.oc;
+
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int o = 0; o < oc; ++o) {
+    for (int i = 0; i < ic; ++i) {
+      int g[3][3], t[4][3], u[4][4];
+      for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+          size_t blk = ((size_t)(o / 16) * (ic / 16) + i / 16) * 9 + y * 3 + x;
+          g[y][x] = wei[blk * 256 + (i % 16 / 4 * 16 + o % 16) * 4 + i % 4];
+        }
+      }
+      // G g, on rows
+      for (int x = 0; x < 3; ++x) {
+        t[0][x] = 2 * g[0][x];
+        t[1][x] = g[0][x] + g[1][x] + g[2][x];
+        t[2][x] = g[0][x] - g[1][x] + g[2][x];
+        t[3][x] = 2 * g[2][x];
+      }
+      // (G g) G', on columns
+      for (int a = 0; a < 4; ++a) {
+        u[a][0] = 2 * t[a][0];
+        u[a][1] = t[a][0] + t[a][1] + t[a][2];
+        u[a][2] = t[a][0] - t[a][1] + t[a][2];
+        u[a][3] = 2 * t[a][2];
+      }
+      for (int k = 0; k < 16; ++k) {
+        size_t idx =
+            (((size_t)k * jcp.nb_oc + o / 16) * (ic / 2) + i / 2) * 16 + o % 16;
+        wino_wei_[idx * 2 + i % 2] = u[k / 4][k % 4];
+      }
+    }
+  }
+}
+
+template <typename dst_data_t>
+void op_conv_winograd<dst_data_t>::infer() {
+  using namespace utils;
+  const auto &jcp = jcp_;
+  const int oc_chunk = jcp.nb_oc_chunk * jcp.oc_block;
+
+  #pragma omp parallel
+  {
+    trace_scope trace("conv_winograd_thread");
+    int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
+    int start{0}, end{0};
+    int work_amount = jcp.bs * jcp.tile_h * jcp.oc_chunks;
+    balance211(work_amount, nthr, ithr, start, end);
+
+    auto ws_l = ws_ + ithr * ws_per_thread_;
+    auto wino_src = reinterpret_cast<int16_t *>(ws_l);
+    auto wino_dst = reinterpret_cast<s32 *>(ws_l + ws_src_size_);
+    auto scratch = ws_l + ws_src_size_ + ws_dst_size_;
+    const void *src_pix[16], *dst_pix[4];
+    jit::jit_wino_call_t p = {0};
+    p.src = src_pix;
+    p.dst = dst_pix;
+
+    // the chunks of oc of a tile row go on the same thread, which transforms
+    // its src only once
+    int n{0}, ty{0}, occ{0}, src_n_done{-1}, src_ty_done{-1};
+    nd_iterator_init(start, n, jcp.bs, ty, jcp.tile_h, occ, jcp.oc_chunks);
+    for (int iwork = start; iwork < end; ++iwork) {
+      // src and dst are nhwc
+      const int oc = occ * oc_chunk;
+      auto src_n = src_data_ + (size_t)n * jcp.ih * jcp.iw * jcp.ic;
+      auto dst_n = dst_data_ + (size_t)n * jcp.oh * jcp.ow * jcp.oc + oc;
+      p.bia = bia_data_ == NULL
+                  ? NULL
+                  : (const char *)bia_data_ + oc * jcp.typesize_bia;
+      p.scales = scales_.data() + (jcp.multi_oc_scale ? oc : 0);
+
+      // 4x4 input of each tile, the pixels in padding are zeros
+      if (n != src_n_done || ty != src_ty_done) {
+        for (int tx = 0; tx < jcp.tile_w; ++tx) {
+          for (int i = 0; i < 4; ++i) {
+            int ih = ty * 2 - jcp.t_pad + i;
+            for (int j = 0; j < 4; ++j) {
+              int iw = tx * 2 - jcp.l_pad + j;
+              bool in = ih >= 0 && ih < jcp.ih && iw >= 0 && iw < jcp.iw;
+              src_pix[i * 4 + j] =
+                  in ? src_n + ((size_t)ih * jcp.iw + iw) * jcp.ic : zeros_;
+            }
+          }
+          p.wino_src = wino_src + (size_t)tx * jcp.ic;
+          src_trans_->jit_ker_(&p);
+        }
+        src_n_done = n;
+        src_ty_done = ty;
+      }
+
+      for (int k = 0; k < 16; ++k) {
+        p.wino_src = wino_src + (size_t)k * jcp.tile_w * jcp.ic;
+        p.wino_wei = wino_wei_ + ((size_t)k * jcp.oc + oc) * jcp.ic;
+        p.wino_dst = wino_dst + (size_t)k * jcp.tile_w * oc_chunk;
+        gemm_->jit_ker_(&p);
+      }
+
+      // 2x2 output of each tile, the pixels out of image go to scratch
+      for (int tx = 0; tx < jcp.tile_w; ++tx) {
+        for (int i = 0; i < 2; ++i) {
+          int oh = ty * 2 + i;
+          for (int j = 0; j < 2; ++j) {
+            int ow = tx * 2 + j;
+            bool in = oh < jcp.oh && ow < jcp.ow;
+            dst_pix[i * 2 + j] =
+                in ? dst_n + ((size_t)oh * jcp.ow + ow) * jcp.oc
+                   : (const void *)scratch;
+          }
+        }
+        p.wino_dst = wino_dst + (size_t)tx * oc_chunk;
+        dst_trans_->jit_ker_(&p);
+      }
+
+      nd_iterator_step(n, jcp.bs, ty, jcp.tile_h, occ, jcp.oc_chunks);
+    }
+  }
+}
+
+template class op_conv_winograd<f32>;
+template class op_conv_winograd<s32>;
+template class op_conv_winograd<s8>;
+template class op_conv_winograd<u8>;
+
+}
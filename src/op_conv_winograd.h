@@ -0,0 +1,68 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include <deepfusion.h>
+#include "jit_conv_winograd_kernel.h"
+#include "log.h"
+#include "omp_thread.h"
+
+namespace deepfusion {
+
+// int8 winograd F(2x2, 3x3) conv of u8 src and s8 weights, 3x3 stride 1 only.
+// The weights are transformed once when created.
+template <typename dst_data_t>
+class op_conv_winograd : public op {
+public:
+  explicit op_conv_winograd(const std::unique_ptr<memory> &src,
+                            const std::unique_ptr<memory> &wei,
+                            const std::unique_ptr<memory> &bia,
+                            std::array<int, 2> sz_stride,
+                            std::array<int, 2> sz_padding,
+                            std::unique_ptr<memory> &dst,
+                            std::vector<float> scales = {1.f},
+                            bool relu = false,
+                            round_mode rmode = round_mode::nearest);
+  ~op_conv_winograd();
+
+protected:
+  void infer() override;
+  void transform_weights(const s8 *wei);
+
+  const char *name() { return "conv_winograd"; }
+
+private:
+  const u8 *src_data_;
+  const void *bia_data_;
+  std::vector<float> scales_;
+  dst_data_t *dst_data_;
+  jit::jit_wino_conf_t jcp_;
+  jit::jit_wino_src_trans_kernel *src_trans_;
+  jit::jit_wino_gemm_kernel *gemm_;
+  jit::jit_wino_dst_trans_kernel *dst_trans_;
+  int16_t *wino_wei_;  // (16, oc/16, ic/2, 16o, 2i)
+  u8 *zeros_;          // ic of zeros, the src pixel in padding
+  // workspace of each thread, in bytes: the transformed src (s16) of a tile
+  // row and its gemm output (s32) of a chunk of oc, then the scratch of dst
+  // pixels out of image
+  size_t ws_src_size_, ws_dst_size_, ws_per_thread_;
+  char *ws_;
+  memory::page_mode ws_page_;
+  int nthreads_;  // workspace allocated for
+};
+
+}
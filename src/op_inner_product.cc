@@ -0,0 +1,155 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "op_inner_product.h"
+#include "deepfusion_utils.h"
+#include "trace.h"
+
+namespace deepfusion {
+
+template <typename dst_data_t>
+op_inner_product<dst_data_t>::op_inner_product(
+    const std::unique_ptr<memory> &src,
+    const std::unique_ptr<memory> &wei,
+    const std::unique_ptr<memory> &bia,
+    std::unique_ptr<memory> &dst,
+    std::vector<float> scales,
+    bool relu,
+    round_mode rmode)
+    : op(), kernels_() {
+  if (!jit::mayiuse(jit::avx512_core)) {
+    error_and_exit("InnerProduct op requires AVX512!");
+  }
+  if (!init_conf(jcp_, src, wei, bia, dst, scales, relu, rmode)) {
+    error_and_exit("Init InnerProduct op failed!");
+  }
+  for (int n_tail = 0; n_tail < 2; ++n_tail) {
+    for (int oc_tail = 0; oc_tail < 2; ++oc_tail) {
+      if ((n_tail && jcp_.ur_n_tail == 0) || (oc_tail && jcp_.oc_tail == 0)) {
+        continue;
+      }
+      kernels_[n_tail][oc_tail] = new jit::jit_inner_product_kernel(
+          jcp_, n_tail ? jcp_.ur_n_tail : jcp_.ur_n, oc_tail);
+    }
+  }
+
+  src_data_ = reinterpret_cast<const u8 *>(src->data());
+  wei_data_ = reinterpret_cast<const s8 *>(wei->data());
+  dst_data_ = reinterpret_cast<dst_data_t *>(dst->data());
+  bia_data_ =
+      bia != nullptr ? reinterpret_cast<const void *>(bia->data()) : NULL;
+  scales_ = scales;
+}
+
+template <typename dst_data_t>
+op_inner_product<dst_data_t>::~op_inner_product() {
+  for (auto &k : kernels_) {
+    delete k[0];
+    delete k[1];
+  }
+}
+
+template <typename dst_data_t>
+bool op_inner_product<dst_data_t>::init_conf(
+    jit::jit_ip_conf_t &conf,
+    const std::unique_ptr<memory> &src,
+    const std::unique_ptr<memory> &wei,
+    const std::unique_ptr<memory> &bia,
+    std::unique_ptr<memory> &dst,
+    const std::vector<float> &scales,
+    bool relu,
+    round_mode rmode) {
+  using namespace utils;
+  if (dst->data_type() != type2dtype<dst_data_t>::dtype) {
+    info("Dst data type do not match");
+    return false;
+  }
+
+  constexpr int C = 1, H = 2, W = 3;  // channel, height, width
+  auto src_dims = src->std_dims();    // nchw
+  auto wei_dims = wei->std_dims();    // oihw
+  auto dst_dims = dst->std_dims();    // nchw
+  if (src_dims[C] != wei_dims[C]) {
+    info("Input channel do not match");
+    return false;
+  }
+  if (src_dims[H] != wei_dims[H] || src_dims[W] != wei_dims[W]) {
+    info("Weights size do not match input image");
+    return false;
+  }
+  if (src_dims[0] != dst_dims[0]) {
+    info("Batch size do not equal");
+    return false;
+  }
+  if (dst_dims[C] != wei_dims[0] || dst_dims[H] != 1 || dst_dims[W] != 1) {
+    info("Output channel do not match");
+    return false;
+  }
+  if (bia != nullptr && bia->std_dims()[0] != wei_dims[0]) {
+    info("Bias channel do not match");
+    return false;
+  }
+  if (!one_of(scales.size(), 1UL, size_t(dst_dims[C]))) {
+    return false;
+  }
+
+  return jit::jit_inner_product_kernel::init_conf(
+      conf, src, wei, bia, dst, scales, relu, rmode);
+}
+
+template <typename dst_data_t>
+void op_inner_product<dst_data_t>::infer() {
+  using namespace utils;
+  const auto &jcp = jcp_;
+  const int n_chunks = div_up(jcp.bs, jcp.ur_n);
+  const int oc_chunks = jcp.nb_oc / jcp.nb_oc_blocking;
+  const size_t src_row = (size_t)jcp.ih * jcp.iw * jcp.ic;
+
+  #pragma omp parallel
+  {
+    trace_scope trace("inner_product_thread");
+    int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
+    int start{0}, end{0};
+    balance211(n_chunks * oc_chunks, nthr, ithr, start, end);
+
+    jit::jit_ip_call_t p = {0};
+    int occ{0}, nc{0};
+    // the rows of a chunk of oc go on the same thread, to reuse its weights
+    nd_iterator_init(start, occ, oc_chunks, nc, n_chunks);
+    for (int iwork = start; iwork < end; ++iwork) {
+      const int n = nc * jcp.ur_n;
+      const int oc = occ * jcp.nb_oc_blocking * jcp.oc_block;
+      p.src = src_data_ + n * src_row;
+      p.wei = wei_data_ + oc * src_row;
+      p.dst = dst_data_ + (size_t)n * jcp.oc + oc;
+      p.bia = bia_data_ == NULL
+                  ? NULL
+                  : (const char *)bia_data_ + oc * jcp.typesize_bia;
+      p.scales = scales_.data() + (jcp.multi_oc_scale ? oc : 0);
+      const bool n_tail = jcp.ur_n_tail > 0 && nc == n_chunks - 1;
+      const bool oc_tail = jcp.oc_tail > 0 && occ == oc_chunks - 1;
+      kernels_[n_tail][oc_tail]->jit_ker_(&p);
+      nd_iterator_step(occ, oc_chunks, nc, n_chunks);
+    }
+  }
+}
+
+template class op_inner_product<f32>;
+template class op_inner_product<s32>;
+template class op_inner_product<s8>;
+template class op_inner_product<u8>;
+
+}
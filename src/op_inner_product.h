@@ -0,0 +1,66 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include <deepfusion.h>
+#include "jit_inner_product_kernel.h"
+#include "log.h"
+#include "omp_thread.h"
+
+namespace deepfusion {
+
+// int8 inner product (fully connected) of u8 src and s8 weights, on AVX512.
+// The weights have the same h and w as src, so it's a conv of 1x1 output.
+template <typename dst_data_t>
+class op_inner_product : public op {
+public:
+  explicit op_inner_product(const std::unique_ptr<memory> &src,
+                            const std::unique_ptr<memory> &wei,
+                            const std::unique_ptr<memory> &bia,
+                            std::unique_ptr<memory> &dst,
+                            std::vector<float> scales = {1.f},
+                            bool relu = false,
+                            round_mode rmode = round_mode::nearest);
+  ~op_inner_product();
+
+protected:
+  void infer() override;
+
+  const char *name() { return "inner_product"; }
+
+private:
+  bool init_conf(jit::jit_ip_conf_t &conf,
+                 const std::unique_ptr<memory> &src,
+                 const std::unique_ptr<memory> &wei,
+                 const std::unique_ptr<memory> &bia,
+                 std::unique_ptr<memory> &dst,
+                 const std::vector<float> &scales,
+                 bool relu,
+                 round_mode rmode);
+
+  const u8 *src_data_;
+  const s8 *wei_data_;
+  const void *bia_data_;
+  std::vector<float> scales_;
+  dst_data_t *dst_data_;
+  jit::jit_ip_conf_t jcp_;
+  // of [the last bs % ur_n rows][the last oc chunk with oc tail], NULL if
+  // not needed
+  jit::jit_inner_product_kernel *kernels_[2][2];
+};
+
+}
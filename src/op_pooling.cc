@@ -0,0 +1,147 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "op_pooling.h"
+#include <algorithm>
+#include "deepfusion_utils.h"
+#include "trace.h"
+
+namespace deepfusion {
+
+template <typename dtype>
+op_pooling<dtype>::op_pooling(const std::unique_ptr<memory> &src,
+                              std::unique_ptr<memory> &dst,
+                              std::array<int, 2> sz_kernel,
+                              std::array<int, 2> sz_stride,
+                              std::array<int, 2> sz_padding,
+                              pooling_algorithm alg,
+                              round_mode rmode)
+    : op() {
+  jit::jit_pooling_conf_t conf;
+  if (!init_conf(
+          conf, src, dst, sz_kernel, sz_stride, sz_padding, alg, rmode)) {
+    error_and_exit("Init Pooling op failed!");
+  }
+  kernel_ = new jit::jit_pooling_kernel(conf);
+  src_data_ = reinterpret_cast<const dtype *>(src->data());
+  dst_data_ = reinterpret_cast<dtype *>(dst->data());
+}
+
+template <typename dtype>
+op_pooling<dtype>::~op_pooling() {
+  delete kernel_;
+}
+
+template <typename dtype>
+bool op_pooling<dtype>::init_conf(jit::jit_pooling_conf_t &conf,
+                                  const std::unique_ptr<memory> &src,
+                                  const std::unique_ptr<memory> &dst,
+                                  std::array<int, 2> sz_kernel,
+                                  std::array<int, 2> sz_stride,
+                                  std::array<int, 2> sz_padding,
+                                  pooling_algorithm alg,
+                                  round_mode rmode) {
+  using namespace utils;
+  if (dst->data_type() != type2dtype<dtype>::dtype) {
+    info("Dst data type do not match");
+    return false;
+  }
+
+  auto src_dims = src->std_dims();  // nchw
+  auto dst_dims = dst->std_dims();  // nchw
+  if (src_dims[0] != dst_dims[0]) {
+    info("Batch size do not equal");
+    return false;
+  }
+  if (src_dims[1] != dst_dims[1]) {
+    info("Channel do not match");
+    return false;
+  }
+  for (int i = 0; i < 2; ++i) {
+    const int in = src_dims[i + 2], out = dst_dims[i + 2];
+    if (sz_kernel[i] < 1 || sz_stride[i] < 1) {
+      info("Kernel and stride should be 1 at least: %d", i);
+      return false;
+    }
+    if (sz_padding[i] < 0 || sz_padding[i] >= sz_kernel[i]) {
+      info("Padding should be less than kernel: %d", i);
+      return false;
+    }
+    // rounded down as conv, or up as caffe
+    const int k = sz_kernel[i], s = sz_stride[i], p = sz_padding[i];
+    if (out != conv_output_size(in, k, s, p, 1) &&
+        out != pool_output_size(in, k, s, p)) {
+      info("Output image size do not match: %d", i);
+      return false;
+    }
+    // the last window should not be all in padding
+    if ((out - 1) * s - p >= in) {
+      info("Last pooling window is out of image: %d", i);
+      return false;
+    }
+  }
+
+  return jit::jit_pooling_kernel::init_conf(
+      conf, src, dst, sz_kernel, sz_stride, sz_padding, alg, rmode);
+}
+
+template <typename dtype>
+void op_pooling<dtype>::infer() {
+  using namespace utils;
+  const auto &jcp = kernel_->jcp_;
+  // the channels are split too, for global pooling of small batch
+  const int c_chunks = jcp.nb_c / jcp.ur_c;
+  const int c_chunk = jcp.ur_c * jcp.block;
+  const int work_amount = jcp.bs * jcp.oh * jcp.ow * c_chunks;
+
+  #pragma omp parallel
+  {
+    trace_scope trace("pooling_thread");
+    int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
+    int start{0}, end{0};
+    balance211(work_amount, nthr, ithr, start, end);
+
+    jit::jit_pooling_call_t p = {0};
+    int n{0}, oh{0}, ow{0}, cc{0};
+    nd_iterator_init(
+        start, n, jcp.bs, oh, jcp.oh, ow, jcp.ow, cc, c_chunks);
+    for (int iwork = start; iwork < end; ++iwork) {
+      // the window clipped to the image
+      const int h0 = oh * jcp.sh - jcp.t_pad, w0 = ow * jcp.sw - jcp.l_pad;
+      const int ih_s = std::max(h0, 0), ih_e = std::min(h0 + jcp.kh, jcp.ih);
+      const int iw_s = std::max(w0, 0), iw_e = std::min(w0 + jcp.kw, jcp.iw);
+      p.kh = ih_e - ih_s;
+      p.kw = iw_e - iw_s;
+      p.divisor = jcp.alg == pooling_avg_include_padding
+                      ? (float)(jcp.kh * jcp.kw)
+                      : (float)(p.kh * p.kw);
+      // src and dst are nhwc
+      size_t src_pix = ((size_t)n * jcp.ih + ih_s) * jcp.iw + iw_s;
+      size_t dst_pix = ((size_t)n * jcp.oh + oh) * jcp.ow + ow;
+      p.src = src_data_ + src_pix * jcp.c + cc * c_chunk;
+      p.dst = dst_data_ + dst_pix * jcp.c + cc * c_chunk;
+      kernel_->jit_ker_(&p);
+      nd_iterator_step(n, jcp.bs, oh, jcp.oh, ow, jcp.ow, cc, c_chunks);
+    }
+  }
+}
+
+template class op_pooling<f32>;
+template class op_pooling<s32>;
+template class op_pooling<s8>;
+template class op_pooling<u8>;
+
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#pragma once
+
+#include <deepfusion.h>
+#include "jit_pooling_kernel.h"
+#include "log.h"
+#include "omp_thread.h"
+
+namespace deepfusion {
+
+// max or avg pooling of nhwc, src and dst in the same data type
+template <typename dtype>
+class op_pooling : public op {
+public:
+  explicit op_pooling(const std::unique_ptr<memory> &src,
+                      std::unique_ptr<memory> &dst,
+                      std::array<int, 2> sz_kernel,
+                      std::array<int, 2> sz_stride,
+                      std::array<int, 2> sz_padding,
+                      pooling_algorithm alg = pooling_max,
+                      round_mode rmode = round_mode::nearest);
+  ~op_pooling();
+
+protected:
+  bool init_conf(jit::jit_pooling_conf_t &conf,
+                 const std::unique_ptr<memory> &src,
+                 const std::unique_ptr<memory> &dst,
+                 std::array<int, 2> sz_kernel,
+                 std::array<int, 2> sz_stride,
+                 std::array<int, 2> sz_padding,
+                 pooling_algorithm alg,
+                 round_mode rmode);
+
+  void infer() override;
+
+  const char *name() { return "pooling"; }
+
+private:
+  jit::jit_pooling_kernel *kernel_;
+  const dtype *src_data_;
+  dtype *dst_data_;
+};
+
+}
@@ -152,3 +152,186 @@ INSTANTIATE_TEST_CASE_P(TestConcat, test_concat_u8, ::testing::Values(
     BASIC_TEST_CASES
 ));
 
+// bf16 is only moved, relu clears the negative ones by the sign bit
+class test_concat_bf16 : public ::testing::TestWithParam<test_concat_params> {
+protected:
+  virtual void SetUp() {
+    test_concat_params p = ::testing::TestWithParam<test_concat_params>::GetParam();
+    std::vector<std::unique_ptr<memory>> srcs(p.srcs_dims.size());
+    std::unique_ptr<memory> dst;
+    for (size_t i = 0; i < p.srcs_dims.size(); ++i) {
+      srcs[i].reset(new memory(p.srcs_dims[i], format::nhwc, memory::dtype::bf16));
+      testutils::fill_data<bf16>((bf16*)srcs[i]->data(), srcs[i]->size());
+    }
+    dst.reset(new memory(p.dst_dims, format::nhwc, memory::dtype::bf16));
+
+    for (bool post_relu : {true, false}) {
+      auto c = concat(srcs, dst, post_relu);
+      c->submit();
+      const int oc = p.dst_dims[1];
+      const size_t nhw = (size_t)p.dst_dims[0] * p.dst_dims[2] * p.dst_dims[3];
+      std::vector<bf16> ref(dst->size());
+      for (size_t n = 0; n < nhw; ++n) {
+        int c_off = 0;
+        for (size_t i = 0; i < srcs.size(); ++i) {
+          const int ic = p.srcs_dims[i][1];
+          for (int k = 0; k < ic; ++k) {
+            bf16 v = ((bf16*)srcs[i]->data())[n * ic + k];
+            ref[n * oc + c_off + k] = post_relu && (v & 0x8000) ? 0 : v;
+          }
+          c_off += ic;
+        }
+      }
+      testutils::compare_array<bf16>((bf16*)dst->data(), ref.data(), dst->size());
+    }
+  }
+};
+
+TEST_P(test_concat_bf16, TestsConcat) {}
+
+// bf16 should support 8x, 16x or 32x of ic
+INSTANTIATE_TEST_CASE_P(TestConcat, test_concat_bf16, ::testing::Values(
+    BASIC_TEST_CASES,
+    test_concat_params{{{2, 8, 4, 4}, {2, 24, 4, 4}}, {2, 32, 4, 4}}
+));
+
+
+// requantize each input by its own scale, inputs can have different data type
+struct test_concat_requant_params {
+  std::vector<memory::nchw_dims> srcs_dims;
+  std::vector<memory::dtype>     srcs_dt;
+  std::vector<float>             scales;
+  memory::nchw_dims              dst_dims;
+};
+
+template <typename dtype>
+class test_concat_requant
+    : public ::testing::TestWithParam<test_concat_requant_params> {
+  static float load_f32(const std::unique_ptr<memory>& m, size_t i) {
+    switch (m->data_type()) {
+      case memory::dtype::f32: return ((f32*)m->data())[i];
+      case memory::dtype::s32: return (float)((s32*)m->data())[i];
+      case memory::dtype::s8:  return (float)((s8*)m->data())[i];
+      case memory::dtype::u8:  return (float)((u8*)m->data())[i];
+      case memory::dtype::bf16:
+        return utils::bf16_to_f32(((bf16*)m->data())[i]);
+      default: assert(!"bad data type");
+    }
+    return 0.f;
+  }
+
+  static void fill(const std::unique_ptr<memory>& m) {
+    switch (m->data_type()) {
+#define CASE(tp)                                                        \
+      case memory::dtype::tp:                                           \
+        testutils::fill_data<tp>((tp*)m->data(), m->size()); break
+      CASE(f32);
+      CASE(s32);
+      CASE(s8);
+      CASE(u8);
+      CASE(bf16);
+#undef CASE
+      default: assert(!"bad data type");
+    }
+  }
+
+  void check_result(const test_concat_requant_params& pm,
+                    const std::vector<std::unique_ptr<memory>>& srcs,
+                    const std::unique_ptr<memory>& dst,
+                    bool post_relu,
+                    round_mode rmode) {
+    const auto dt = dst->data_type();
+    const int oc = pm.dst_dims[1];
+    const size_t nhw = (size_t)pm.dst_dims[0] * pm.dst_dims[2] * pm.dst_dims[3];
+    std::vector<dtype> ref(dst->size());
+    for (size_t p = 0; p < nhw; ++p) {
+      int c_off = 0;
+      for (size_t i = 0; i < srcs.size(); ++i) {
+        const int ic = pm.srcs_dims[i][1];
+        for (int c = 0; c < ic; ++c) {
+          float v = load_f32(srcs[i], p * ic + c) * pm.scales[i];
+          if (post_relu || dt == memory::dtype::u8) {
+            v = std::max(v, 0.f);
+          }
+          if (dt == memory::dtype::bf16) {
+            ref[p * oc + c_off + c] = utils::f32_to_bf16(v);
+            continue;
+          }
+          if (dt != memory::dtype::f32) {
+            v = rmode == round_mode::nearest ? std::nearbyint(v) : std::floor(v);
+            v = std::min(v, (float)std::numeric_limits<dtype>::max());
+            v = std::max(v, (float)std::numeric_limits<dtype>::lowest());
+          }
+          ref[p * oc + c_off + c] = (dtype)v;
+        }
+        c_off += ic;
+      }
+    }
+    testutils::compare_array<dtype>((dtype*)dst->data(), ref.data(), dst->size());
+  }
+
+protected:
+  virtual void SetUp() {
+    test_concat_requant_params p =
+        ::testing::TestWithParam<test_concat_requant_params>::GetParam();
+    auto dt = utils::type2dtype<dtype>::dtype;
+    std::vector<std::unique_ptr<memory>> srcs(p.srcs_dims.size());
+    std::unique_ptr<memory> dst;
+    memory::format fmt = format::nhwc;
+    for (size_t i = 0; i < p.srcs_dims.size(); ++i) {
+      srcs[i].reset(new memory(p.srcs_dims[i], fmt, p.srcs_dt[i]));
+      fill(srcs[i]);
+    }
+    dst.reset(new memory(p.dst_dims, fmt, dt));
+
+    for (bool post_relu : {true, false}) {
+      for (round_mode rmode : {round_mode::nearest, round_mode::down}) {
+        auto c = concat(srcs, dst, post_relu, p.scales, rmode);
+        c->submit();
+        check_result(p, srcs, dst, post_relu, rmode);
+      }
+    }
+  }
+};
+
+using test_concat_requant_f32 = test_concat_requant<f32>;
+using test_concat_requant_s32 = test_concat_requant<s32>;
+using test_concat_requant_s8 = test_concat_requant<s8>;
+using test_concat_requant_u8 = test_concat_requant<u8>;
+using test_concat_requant_bf16 = test_concat_requant<bf16>;
+
+TEST_P(test_concat_requant_f32, TestsConcatRequant) {}
+TEST_P(test_concat_requant_s32, TestsConcatRequant) {}
+TEST_P(test_concat_requant_s8, TestsConcatRequant) {}
+TEST_P(test_concat_requant_u8, TestsConcatRequant) {}
+TEST_P(test_concat_requant_bf16, TestsConcatRequant) {}
+
+#define REQUANT_TEST_CASES                                                   \
+      test_concat_requant_params{{{2, 16, 4, 4}, {2, 32, 4, 4}},             \
+                                 {memory::dtype::s8, memory::dtype::s8},     \
+                                 {0.5f, 2.f}, {2, 48, 4, 4}},                \
+      test_concat_requant_params{{{2, 64, 7, 7}, {2, 32, 7, 7}},             \
+                                 {memory::dtype::u8, memory::dtype::s8},     \
+                                 {1.3f, 0.7f}, {2, 96, 7, 7}},               \
+      test_concat_requant_params{{{1, 32, 3, 3}, {1, 16, 3, 3},              \
+                                  {1, 48, 3, 3}},                            \
+                                 {memory::dtype::s32, memory::dtype::f32,    \
+                                  memory::dtype::u8},                        \
+                                 {0.25f, 3.f, 1.f}, {1, 96, 3, 3}},          \
+      test_concat_requant_params{{{2, 128, 14, 14}, {2, 256, 14, 14}},       \
+                                 {memory::dtype::s8, memory::dtype::u8},     \
+                                 {1.f, 1.f}, {2, 384, 14, 14}},              \
+      test_concat_requant_params{{{2, 32, 5, 5}, {2, 16, 5, 5}},             \
+                                 {memory::dtype::bf16, memory::dtype::f32},  \
+                                 {0.5f, 3.f}, {2, 48, 5, 5}}
+
+INSTANTIATE_TEST_CASE_P(TestConcatRequant, test_concat_requant_f32,
+                        ::testing::Values(REQUANT_TEST_CASES));
+INSTANTIATE_TEST_CASE_P(TestConcatRequant, test_concat_requant_s32,
+                        ::testing::Values(REQUANT_TEST_CASES));
+INSTANTIATE_TEST_CASE_P(TestConcatRequant, test_concat_requant_s8,
+                        ::testing::Values(REQUANT_TEST_CASES));
+INSTANTIATE_TEST_CASE_P(TestConcatRequant, test_concat_requant_u8,
+                        ::testing::Values(REQUANT_TEST_CASES));
+INSTANTIATE_TEST_CASE_P(TestConcatRequant, test_concat_requant_bf16,
+                        ::testing::Values(REQUANT_TEST_CASES));
@@ -15,6 +15,9 @@
 *******************************************************************************/
 
 #include "test_utils.h"
+#include "src/op_conv_winograd.h"
+
+using format = deepfusion::memory::format;
 
 namespace deepfusion {
 
@@ -33,7 +36,9 @@ struct test_conv_params {
                    int padw,
                    int strh,
                    int strw,
-                   int oc1x1)
+                   int oc1x1,
+                   int dilh = 1,
+                   int dilw = 1)
       : mb(mb),
         ng(ng),
         ic(ic),
@@ -48,7 +53,9 @@ struct test_conv_params {
         pw(padw),
         sh(strh),
         sw(strw),
-        oc1x1(oc1x1) {}
+        oc1x1(oc1x1),
+        dh(dilh),
+        dw(dilw) {}
   int mb;
   int ng;
   int ic, ih, iw;
@@ -57,26 +64,190 @@ struct test_conv_params {
   int ph, pw;
   int sh, sw;
   int oc1x1;
+  int dh, dw;  // dilation, 1 if dense
 };
 
 template <typename src_dt, typename wei_dt, typename bia_dt, typename dst_dt>
 class test_conv : public ::testing::TestWithParam<test_conv_params> {
+  // f32 conv has f32 weights in OIhw16i16o, and f32 output of conv0, the src
+  // and dst can be bf16
+  static constexpr bool is_f32 = std::is_same<src_dt, f32>::value ||
+                                 std::is_same<src_dt, bf16>::value;
+  typedef typename std::conditional<is_f32, f32, s32>::type acc_dt;
+  typedef typename std::conditional<is_f32, f32, u8>::type out0_dt;
+
+  // index of oihw in OIhw4i16o4i, or OIhw16i16o
+  static size_t wei_index(int o, int i, int y, int x, int ic, int kh, int kw) {
+    size_t blk = (((size_t)(o / 16) * (ic / 16) + i / 16) * kh + y) * kw + x;
+    if (is_f32) {
+      return blk * 256 + i % 16 * 16 + o % 16;
+    }
+    return blk * 256 + (i % 16 / 4 * 16 + o % 16) * 4 + i % 4;
+  }
+
+  // src to acc, bf16 is widened to f32
+  static acc_dt widen(bf16 v) { return utils::bf16_to_f32(v); }
+  template <typename T>
+  static acc_dt widen(T v) {
+    return (acc_dt)v;
+  }
+
+  // acc to dt as the kernel: add bias, scale, relu, round and saturate
+  template <typename T>
+  static T cvt(acc_dt acc, float bias, float scale, bool relu,
+               round_mode rmode) {
+    float v = ((float)acc + bias) * scale;
+    if (relu || std::is_same<T, u8>::value) {
+      v = std::max(v, 0.f);
+    }
+    if (std::is_same<T, bf16>::value) {
+      return (T)utils::f32_to_bf16(v);
+    }
+    if (!std::is_same<T, f32>::value) {
+      v = rmode == round_mode::nearest ? std::nearbyint(v) : std::floor(v);
+      v = std::min(v, (float)std::numeric_limits<T>::max());
+      v = std::max(v, (float)std::numeric_limits<T>::lowest());
+    }
+    return (T)v;
+  }
+
+  // naive direct conv, the output of conv0 is u8 (or f32 in f32 conv) as src
+  // of conv1x1 if fused
   void check_result(const test_conv_params& pm,
                     const std::unique_ptr<memory>& src,
+                    const std::unique_ptr<memory>& wei,
+                    const std::unique_ptr<memory>& bia,
+                    const std::unique_ptr<memory>& wei1x1,
+                    const std::unique_ptr<memory>& bia1x1,
                     const std::unique_ptr<memory>& dst,
+                    const std::vector<float>& scales,
+                    const std::vector<float>& scales1x1,
                     bool post_relu) {
-    mkldnn::engine eng = mkldnn::engine(mkldnn::engine::cpu, 0);
+    const bool fused = pm.oc1x1 > 0;
+    const int dst_oc = fused ? pm.oc1x1 : pm.oc;
+    const size_t nhw = (size_t)pm.mb * pm.oh * pm.ow;
+    auto p_src = (const src_dt*)src->data();
+    auto p_wei = (const wei_dt*)wei->data();
+    auto p_bia = (const bia_dt*)bia->data();
+    std::vector<dst_dt> ref(nhw * dst_oc);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t p = 0; p < nhw; ++p) {
+      const int n = p / (pm.oh * pm.ow);
+      const int oh = p / pm.ow % pm.oh, ow = p % pm.ow;
+      std::vector<out0_dt> out0(pm.oc);
+      for (int o = 0; o < pm.oc; ++o) {
+        acc_dt acc = 0;
+        for (int y = 0; y < pm.kh; ++y) {
+          const int ih = oh * pm.sh - pm.ph + y * pm.dh;
+          if (ih < 0 || ih >= pm.ih) continue;
+          for (int x = 0; x < pm.kw; ++x) {
+            const int iw = ow * pm.sw - pm.pw + x * pm.dw;
+            if (iw < 0 || iw >= pm.iw) continue;
+            const src_dt* s =
+                p_src + (((size_t)n * pm.ih + ih) * pm.iw + iw) * pm.ic;
+            for (int i = 0; i < pm.ic; ++i) {
+              acc += widen(s[i]) *
+                     (acc_dt)p_wei[wei_index(o, i, y, x, pm.ic, pm.kh, pm.kw)];
+            }
+          }
+        }
+        const float scale = scales[scales.size() == 1 ? 0 : o];
+        if (fused) {
+          out0[o] = cvt<out0_dt>(acc, (float)p_bia[o], scale, true,
+                                 round_mode::nearest);
+        } else {
+          ref[p * dst_oc + o] = cvt<dst_dt>(acc, (float)p_bia[o], scale,
+                                            post_relu, round_mode::nearest);
+        }
+      }
+      if (!fused) continue;
+      auto p_wei1x1 = (const wei_dt*)wei1x1->data();
+      auto p_bia1x1 = (const bia_dt*)bia1x1->data();
+      for (int o = 0; o < pm.oc1x1; ++o) {
+        acc_dt acc = 0;
+        for (int i = 0; i < pm.oc; ++i) {
+          acc += (acc_dt)out0[i] *
+                 (acc_dt)p_wei1x1[wei_index(o, i, 0, 0, pm.oc, 1, 1)];
+        }
+        const float scale = scales1x1[scales1x1.size() == 1 ? 0 : o];
+        ref[p * dst_oc + o] = cvt<dst_dt>(acc, (float)p_bia1x1[o], scale,
+                                          post_relu, round_mode::nearest);
+      }
+    }
+    testutils::compare_array<dst_dt>(
+        (dst_dt*)dst->data(), ref.data(), dst->size());
   }
 
 protected:
+  virtual conv_algorithm algo() { return conv_algorithm::direct; }
+  // check the op created is of the algorithm asked
+  virtual void check_op(const std::unique_ptr<op>& c) {}
+
   virtual void SetUp() {
     test_conv_params p = ::testing::TestWithParam<test_conv_params>::GetParam();
-    // TODO: do not compare multi channel scales, MKLDNN should have bugs
+    ASSERT_EQ(p.oh, utils::conv_output_size(p.ih, p.kh, p.sh, p.ph, p.dh));
+    ASSERT_EQ(p.ow, utils::conv_output_size(p.iw, p.kw, p.sw, p.pw, p.dw));
+    const bool fused = p.oc1x1 > 0;
+    memory::nchw_dims src_dims = {{p.mb, p.ic * p.ng, p.ih, p.iw}};
+    memory::nchw_dims wei_dims = {{p.oc * p.ng, p.ic, p.kh, p.kw}};
+    memory::nchw_dims dst_dims = {
+        {p.mb, fused ? p.oc1x1 : p.oc * p.ng, p.oh, p.ow}};
+    const auto wdt = utils::type2dtype<wei_dt>::dtype;
+    const auto wfmt = is_f32 ? format::OIhw16i16o : format::OIhw4i16o4i;
+    const auto bdt = utils::type2dtype<bia_dt>::dtype;
+    std::unique_ptr<memory> src, wei, bia, wei1x1, bia1x1, dst;
+    src.reset(new memory(src_dims, format::nhwc,
+                         utils::type2dtype<src_dt>::dtype));
+    wei.reset(new memory(wei_dims, wfmt, wdt));
+    bia.reset(new memory(memory::dims({p.oc}), format::x, bdt));
+    dst.reset(new memory(dst_dims, format::nhwc,
+                         utils::type2dtype<dst_dt>::dtype));
+    testutils::fill_data<src_dt>((src_dt*)src->data(), src->size());
+    testutils::fill_data<wei_dt>((wei_dt*)wei->data(), wei->size());
+    testutils::fill_data<bia_dt>((bia_dt*)bia->data(), bia->size());
+
+    // per oc scales, small enough to keep the results in range mostly
+    std::vector<float> scales(p.oc), scales1x1(std::max(p.oc1x1, 1));
+    for (size_t i = 0; i < scales.size(); ++i) {
+      scales[i] = 0.02f + 0.002f * (i % 7);
+    }
+    for (size_t i = 0; i < scales1x1.size(); ++i) {
+      scales1x1[i] = 0.01f + 0.001f * (i % 5);
+    }
+
+    if (fused) {
+      memory::nchw_dims wei1x1_dims = {{p.oc1x1, p.oc, 1, 1}};
+      wei1x1.reset(new memory(wei1x1_dims, wfmt, wdt));
+      bia1x1.reset(new memory(memory::dims({p.oc1x1}), format::x, bdt));
+      testutils::fill_data<wei_dt>((wei_dt*)wei1x1->data(), wei1x1->size());
+      testutils::fill_data<bia_dt>((bia_dt*)bia1x1->data(), bia1x1->size());
+    }
+
+    for (bool post_relu : {true, false}) {
+      std::unique_ptr<op> c;
+      if (fused) {
+        c = conv(src, wei, bia, {{p.sh, p.sw}}, {{p.ph, p.pw}},
+                 {{p.dh, p.dw}}, wei1x1, bia1x1, dst, true, scales,
+                 round_mode::nearest, post_relu, scales1x1);
+      } else if (algo() != conv_algorithm::direct) {
+        c = conv(src, wei, bia, {{p.sh, p.sw}}, {{p.ph, p.pw}}, dst,
+                 post_relu, scales, round_mode::nearest, algo());
+      } else {
+        c = conv(src, wei, bia, {{p.sh, p.sw}}, {{p.ph, p.pw}},
+                 {{p.dh, p.dw}}, dst, post_relu, scales);
+      }
+      check_op(c);
+      c->submit();
+      check_result(p, src, wei, bia, wei1x1, bia1x1, dst, scales, scales1x1,
+                   post_relu);
+    }
   }
 };
 
 // @note: the srcs, wei and dst are always given as nchw
-// TODO: add more test cases
+// covers stride 2, 7x7 with padding 3, 1x1 and dilation, with and without
+// conv1x1 fused
 #define test_conv_case(src, wei, bia, dst)                              \
   using test_conv_##src##wei##bia##dst = test_conv<src, wei, bia, dst>; \
   TEST_P(test_conv_##src##wei##bia##dst, TestsConv) {}                  \
@@ -85,11 +256,29 @@ protected:
       test_conv_##src##wei##bia##dst,                                   \
       ::testing::Values(                                                \
           test_conv_params{                                             \
-              2, 1, 32, 13, 13, 32, 12, 12, 3, 3, 0, 0, 1, 1, 64},      \
+              2, 1, 32, 13, 13, 32, 11, 11, 3, 3, 0, 0, 1, 1, 64},      \
+          test_conv_params{                                             \
+              2, 1, 32, 13, 13, 32, 13, 13, 3, 3, 1, 1, 1, 1, 32},      \
+          test_conv_params{                                             \
+              2, 1, 32, 120, 360, 64, 120, 360, 3, 3, 1, 1, 1, 1, 32},  \
+          test_conv_params{                                             \
+              2, 1, 32, 13, 13, 32, 13, 13, 3, 3, 1, 1, 1, 1, 0},       \
+          test_conv_params{                                             \
+              2, 1, 32, 28, 28, 64, 14, 14, 3, 3, 1, 1, 2, 2, 0},       \
+          test_conv_params{                                             \
+              2, 1, 32, 27, 27, 32, 14, 14, 3, 3, 1, 1, 2, 2, 64},      \
           test_conv_params{                                             \
-              2, 1, 32, 13, 13, 32, 11, 11, 3, 3, 1, 1, 1, 1, 32},      \
+              1, 1, 16, 56, 56, 64, 28, 28, 7, 7, 3, 3, 2, 2, 0},       \
           test_conv_params{                                             \
-              2, 1, 32, 120, 360, 64, 120, 360, 3, 3, 1, 1, 1, 1, 32}))
+              2, 1, 16, 7, 7, 32, 7, 7, 7, 7, 3, 3, 1, 1, 0},           \
+          test_conv_params{                                             \
+              2, 1, 64, 14, 14, 32, 7, 7, 1, 1, 0, 0, 2, 2, 0},         \
+          test_conv_params{                                             \
+              2, 1, 32, 33, 33, 32, 33, 33, 3, 3, 2, 2, 1, 1, 0, 2, 2}, \
+          test_conv_params{                                             \
+              1, 1, 32, 20, 30, 64, 20, 30, 3, 3, 4, 4, 1, 1, 32, 4, 4},\
+          test_conv_params{                                             \
+              2, 1, 16, 12, 12, 32, 10, 3, 3, 3, 2, 0, 1, 2, 0, 3, 3}))
 
 // data type src, weight, bias, dst
 test_conv_case(u8, s8, s8, u8);
@@ -100,4 +289,121 @@ test_conv_case(u8, s8, s32, u8);
 test_conv_case(u8, s8, s32, s8);
 test_conv_case(u8, s8, s32, s32);
 test_conv_case(u8, s8, s32, f32);
+test_conv_case(f32, f32, f32, f32);
+test_conv_case(bf16, f32, f32, bf16);
+
+// winograd gives the same results with direct conv, the shapes cover odd
+// output size, padding, nb_oc of 3 and 4, and oc split into chunks for the
+// few tile rows
+template <typename dst_dt>
+class test_conv_winograd : public test_conv<u8, s8, s32, dst_dt> {
+protected:
+  conv_algorithm algo() override { return conv_algorithm::winograd; }
+  void check_op(const std::unique_ptr<op>& c) override {
+    // not falling back to direct conv
+    ASSERT_NE(dynamic_cast<op_conv_winograd<dst_dt>*>(c.get()), nullptr);
+  }
+  void SetUp() override {
+    if (!jit::mayiuse(jit::avx512_core)) {
+      info("Skip winograd conv, which requires AVX512");
+      return;
+    }
+    test_conv<u8, s8, s32, dst_dt>::SetUp();
+  }
+};
+
+#define test_conv_winograd_case(dst)                                    \
+  using test_conv_winograd_##dst = test_conv_winograd<dst>;             \
+  TEST_P(test_conv_winograd_##dst, TestsConv) {}                        \
+  INSTANTIATE_TEST_CASE_P(                                              \
+      TestConvWinograd,                                                 \
+      test_conv_winograd_##dst,                                         \
+      ::testing::Values(                                                \
+          test_conv_params{                                             \
+              2, 1, 32, 13, 13, 48, 11, 11, 3, 3, 0, 0, 1, 1, 0},       \
+          test_conv_params{                                             \
+              2, 1, 64, 13, 15, 64, 13, 15, 3, 3, 1, 1, 1, 1, 0},       \
+          test_conv_params{                                             \
+              1, 1, 64, 56, 56, 64, 56, 56, 3, 3, 1, 1, 1, 1, 0},       \
+          test_conv_params{                                             \
+              1, 1, 32, 6, 7, 32, 6, 7, 3, 3, 1, 1, 1, 1, 0},           \
+          test_conv_params{                                             \
+              1, 1, 32, 4, 4, 128, 4, 4, 3, 3, 1, 1, 1, 1, 0}))
+
+test_conv_winograd_case(u8);
+test_conv_winograd_case(s8);
+test_conv_winograd_case(s32);
+test_conv_winograd_case(f32);
+
+// conv with batch norm folded gives the same as conv, then batch norm and
+// relu in f32; the folded bias in s32 is rounded, by half of the scale at most
+TEST(TestConvBatchNorm, FoldBatchNorm) {
+  const int mb = 2, ic = 32, ih = 13, iw = 13, oc = 48;
+  memory::nchw_dims src_dims = {{mb, ic, ih, iw}};
+  memory::nchw_dims wei_dims = {{oc, ic, 3, 3}};
+  memory::nchw_dims dst_dims = {{mb, oc, ih, iw}};
+  std::unique_ptr<memory> src, wei, acc, dst, no_bia;
+  src.reset(new memory(src_dims, format::nhwc, memory::dtype::u8));
+  wei.reset(new memory(wei_dims, format::OIhw4i16o4i, memory::dtype::s8));
+  acc.reset(new memory(dst_dims, format::nhwc, memory::dtype::s32));
+  dst.reset(new memory(dst_dims, format::nhwc, memory::dtype::f32));
+  testutils::fill_data<u8>((u8*)src->data(), src->size());
+  testutils::fill_data<s8>((s8*)wei->data(), wei->size());
+  conv(src, wei, no_bia, {{1, 1}}, {{1, 1}}, acc)->submit();
+
+  const float eps = 1e-5f;
+  std::vector<float> bias(oc), scales(oc), mean(oc), var(oc), gamma(oc),
+      beta(oc);
+  for (int o = 0; o < oc; ++o) {
+    bias[o] = o % 21 - 10;
+    scales[o] = 0.02f + 0.002f * (o % 7);
+    mean[o] = 0.5f * (o % 7) - 1.f;
+    var[o] = 0.5f + 0.1f * (o % 5);
+    gamma[o] = (o % 3 == 0 ? -1.f : 1.f) * (0.5f + 0.05f * (o % 11));
+    beta[o] = 0.1f * (o % 9) - 0.4f;
+  }
+
+  for (auto bdt : {memory::dtype::f32, memory::dtype::s32}) {
+    for (bool relu : {true, false}) {
+      std::unique_ptr<memory> bia(
+          new memory(memory::dims({oc}), format::x, bdt));
+      for (int o = 0; o < oc; ++o) {
+        if (bdt == memory::dtype::f32) {
+          ((f32*)bia->data())[o] = bias[o];
+        } else {
+          ((s32*)bia->data())[o] = bias[o];
+        }
+      }
+      // the second op from the same bia does not fold twice
+      for (int rebuild = 0; rebuild < 2; ++rebuild) {
+        auto c = conv(src, wei, bia, {{1, 1}}, {{1, 1}}, dst, mean, var,
+                      gamma, beta, eps, relu, scales);
+        c->submit();
+        ASSERT_EQ(bia->data_type(), bdt);
+
+        const s32* a = (const s32*)acc->data();
+        const f32* d = (const f32*)dst->data();
+        for (size_t i = 0; i < dst->size(); ++i) {
+          const int o = i % oc;
+          const float s = gamma[o] / std::sqrt(var[o] + eps);
+          float ref = ((a[i] + bias[o]) * scales[o] - mean[o]) * s + beta[o];
+          if (relu) {
+            ref = std::max(ref, 0.f);
+          }
+          float tol = 1e-3f * std::max(1.f, std::fabs(ref));
+          EXPECT_NEAR(d[i], ref, tol) << "Index: " << i;
+        }
+      }
+    }
+  }
+}
+
+// ctest runs this file again as test_conv_avx2 with DEEPFUSION_MAX_ISA=avx2,
+// make sure the int8 cases above really went through the avx2 kernel then
+TEST(TestConvMaxIsa, CappedByEnv) {
+  const char *isa = getenv("DEEPFUSION_MAX_ISA");
+  if (isa != nullptr && std::string(isa) == "avx2") {
+    EXPECT_FALSE(jit::mayiuse(jit::avx512_common));
+  }
+}
 }
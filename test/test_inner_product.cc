@@ -0,0 +1,128 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "test_utils.h"
+
+using namespace deepfusion;
+
+using format = deepfusion::memory::format;
+
+struct test_inner_product_params {
+  memory::nchw_dims src_dims;
+  int oc;
+  bool with_bias;
+  bool relu;
+  bool multi_scales;
+};
+
+// naive inner product, the same order of post ops with the kernel:
+// (acc + bias) * scale, relu, then rounded to nearest and saturated
+template <typename dst_data_t>
+class test_inner_product
+    : public ::testing::TestWithParam<test_inner_product_params> {
+protected:
+  virtual void SetUp() {
+    auto p = ::testing::TestWithParam<test_inner_product_params>::GetParam();
+    const int bs = p.src_dims[0], ic = p.src_dims[1];
+    const int ih = p.src_dims[2], iw = p.src_dims[3], oc = p.oc;
+    auto dst_dt = utils::type2dtype<dst_data_t>::dtype;
+    memory::nchw_dims wei_dims = {{oc, ic, ih, iw}};
+    memory::nchw_dims dst_dims = {{bs, oc, 1, 1}};
+    std::unique_ptr<memory> src, wei, bia, dst;
+    src.reset(new memory(p.src_dims, format::nhwc, memory::dtype::u8));
+    wei.reset(new memory(wei_dims, format::OIhw4i16o4i, memory::dtype::s8));
+    dst.reset(new memory(dst_dims, format::nhwc, dst_dt));
+    testutils::fill_data<u8>((u8*)src->data(), src->size());
+    testutils::fill_data<s8>((s8*)wei->data(), wei->size());
+    if (p.with_bias) {
+      bia.reset(new memory(memory::dims({oc}), format::x, memory::dtype::s32));
+      testutils::fill_data<s32>((s32*)bia->data(), bia->size());
+    }
+    std::vector<float> scales(p.multi_scales ? oc : 1);
+    for (size_t i = 0; i < scales.size(); ++i) {
+      scales[i] = std::is_same<dst_data_t, f32>::value ? 0.5f + 0.125f * (i % 5)
+                                                       : 1.f / (1 + i % 3);
+    }
+
+    auto ip = inner_product(src, wei, bia, dst, p.relu, scales);
+    ip->submit();
+
+    const u8* s = (const u8*)src->data();
+    const s8* w = (const s8*)wei->data();
+    std::vector<dst_data_t> ref(dst->size());
+    for (int n = 0; n < bs; ++n) {
+      for (int o = 0; o < oc; ++o) {
+        s32 acc = 0;
+        for (int y = 0; y < ih; ++y) {
+          for (int x = 0; x < iw; ++x) {
+            for (int i = 0; i < ic; ++i) {
+              size_t blk = (((size_t)(o / 16) * (ic / 16) + i / 16) * ih + y) *
+                               iw + x;
+              s8 wv = w[blk * 256 + (i % 16 / 4 * 16 + o % 16) * 4 + i % 4];
+              u8 sv = s[(((size_t)n * ih + y) * iw + x) * ic + i];
+              acc += (s32)sv * wv;
+            }
+          }
+        }
+        f32 v = (f32)acc;
+        if (p.with_bias) {
+          v += (f32)((const s32*)bia->data())[o];
+        }
+        v *= scales[p.multi_scales ? o : 0];
+        if (p.relu || std::is_same<dst_data_t, u8>::value) {
+          v = std::max(v, 0.f);
+        }
+        if (!std::is_same<dst_data_t, f32>::value) {
+          v = std::nearbyint(v);
+          v = std::min(v, (f32)std::numeric_limits<dst_data_t>::max());
+          v = std::max(v, (f32)std::numeric_limits<dst_data_t>::min());
+        }
+        ref[(size_t)n * oc + o] = (dst_data_t)v;
+      }
+    }
+    testutils::compare_array<dst_data_t>(
+        (dst_data_t*)dst->data(), ref.data(), dst->size());
+  }
+};
+
+// bs 1 is the latency case, others cover the tail rows of ur_n, and oc of
+// 1000 and 24 the tail oc block
+using ip_params = test_inner_product_params;
+#define INNER_PRODUCT_TEST_CASES                      \
+  ip_params{{1, 64, 1, 1}, 16, false, false, false},  \
+  ip_params{{1, 256, 1, 1}, 1008, true, true, true},  \
+  ip_params{{1, 512, 1, 1}, 1000, true, true, true},  \
+  ip_params{{3, 32, 2, 2}, 24, true, true, false},    \
+  ip_params{{1, 512, 7, 7}, 256, true, false, true},  \
+  ip_params{{2, 128, 1, 1}, 64, true, true, false},   \
+  ip_params{{7, 48, 3, 3}, 32, false, true, true},    \
+  ip_params{{16, 256, 1, 1}, 512, true, false, true}, \
+  ip_params{{13, 64, 7, 7}, 128, true, true, true}
+
+#define test_inner_product_case(dst)                        \
+  using test_inner_product_##dst = test_inner_product<dst>; \
+  TEST_P(test_inner_product_##dst, TestsInnerProduct) {}    \
+  INSTANTIATE_TEST_CASE_P(TestInnerProduct,                 \
+                          test_inner_product_##dst,         \
+                          ::testing::Values(INNER_PRODUCT_TEST_CASES))
+
+test_inner_product_case(f32);
+test_inner_product_case(s32);
+test_inner_product_case(s8);
+test_inner_product_case(u8);
@@ -0,0 +1,242 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "weights_file.h"
+
+namespace deepfusion {
+
+TEST(TestMemory, test_numa_policy) {
+  using namespace utils;
+  EXPECT_GE(numa_num_nodes(), 1);
+
+  const memory::numa_policy policies[] = {memory::numa_default,
+                                          memory::numa_local,
+                                          memory::numa_interleave,
+                                          memory::numa_bind,
+                                          memory::numa_first_touch};
+  for (auto policy : policies) {
+    memory::nchw_dims dm = {{2, 17, 5, 3}};
+    std::unique_ptr<memory> mem(new memory(
+        dm, memory::format::nhwc, memory::dtype::f32, 64, policy, 0));
+    EXPECT_EQ(mem->size(), 2 * 17 * 5 * 3);
+    auto data = (f32 *)mem->data();
+    if (policy != memory::numa_default) {
+      EXPECT_EQ((size_t)data % page_size, 0);
+    }
+    if (policy == memory::numa_first_touch) {
+      for (size_t i = 0; i < mem->size(); ++i) {
+        EXPECT_EQ(data[i], 0.f);
+      }
+    }
+    for (size_t i = 0; i < mem->size(); ++i) {
+      data[i] = i;
+    }
+    EXPECT_EQ(data[mem->size() - 1], mem->size() - 1);
+  }
+}
+
+TEST(TestMemory, test_first_touch) {
+  std::vector<char> buf(1000, 1);
+  // rows not dividing the size, and more rows than the size
+  for (int rows : {1, 3, 7, 2000}) {
+    std::fill(buf.begin(), buf.end(), 1);
+    utils::first_touch(buf.data(), buf.size(), rows);
+    for (auto v : buf) {
+      EXPECT_EQ(v, 0);
+    }
+  }
+}
+
+TEST(TestMemory, test_huge_page) {
+  using namespace utils;
+  // small buffers do not use huge pages by default
+  memory::page_mode mode = memory::page_default;
+  void *p = page_malloc(4096, 64, mode);
+  EXPECT_EQ(mode, memory::page_small);
+  page_free(p, 4096, mode);
+
+  const memory::page_mode modes[] = {memory::page_default,
+                                     memory::page_small,
+                                     memory::page_thp,
+                                     memory::page_hugetlb};
+  for (auto page : modes) {
+    // 3MB, not a multiple of huge page
+    memory::nchw_dims dm = {{1, 64, 96, 128}};
+    std::unique_ptr<memory> mem(new memory(dm,
+                                           memory::format::nhwc,
+                                           memory::dtype::u8,
+                                           4096,
+                                           memory::numa_default,
+                                           0,
+                                           page));
+    auto data = (u8 *)mem->data();
+    if (page == memory::page_thp || page == memory::page_hugetlb) {
+      // hugetlb falls back to thp if no huge pages reserved
+      EXPECT_EQ((size_t)data % huge_page_size, 0);
+    }
+    memset(data, 1, mem->buffer_size());
+    EXPECT_EQ(data[mem->buffer_size() - 1], 1);
+  }
+}
+
+TEST(TestMemory, test_weights_file) {
+  const int oc = 32, ic = 16, kh = 3, kw = 3;
+  memory::nchw_dims dims = {{oc, ic, kh, kw}};
+  std::vector<s8> oihw(oc * ic * kh * kw);
+  for (size_t i = 0; i < oihw.size(); ++i) {
+    oihw[i] = (s8)(i * 7 % 255 - 127);
+  }
+  const std::string file = "test_weights_file.dfw";
+  ASSERT_TRUE(save_weights(file, oihw.data(), dims));
+  {
+    std::unique_ptr<memory> wei(new memory(file));
+    EXPECT_EQ(wei->dim_format(), memory::format::OIhw4i16o4i);
+    EXPECT_EQ(wei->data_type(), memory::dtype::s8);
+    EXPECT_EQ(wei->std_dims(), dims);
+    EXPECT_EQ(wei->size(), oihw.size());
+    EXPECT_EQ((size_t)wei->data() % utils::page_size, 0);
+    // [O/16][I/16][h][w][4i][16o][4i]
+    auto packed = (const s8 *)wei->data();
+    for (int o = 0; o < oc; ++o) {
+      for (int i = 0; i < ic; ++i) {
+        for (int h = 0; h < kh; ++h) {
+          for (int w = 0; w < kw; ++w) {
+            size_t blk = ((o / 16 * (ic / 16) + i / 16) * kh + h) * kw + w;
+            size_t idx = blk * 256 + (i % 16 / 4 * 16 + o % 16) * 4 + i % 4;
+            EXPECT_EQ(packed[idx], oihw[((o * ic + i) * kh + h) * kw + w]);
+          }
+        }
+      }
+    }
+  }
+  remove(file.c_str());
+
+  memory::nchw_dims bad_dims = {{oc, 3, kh, kw}};
+  EXPECT_FALSE(save_weights(file, oihw.data(), bad_dims));
+
+  // only s8 OIhw4i16o4i of 4 dims can be mapped
+  utils::weights_file_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.format = memory::format::nhwc;
+  hdr.dtype = memory::dtype::s8;
+  hdr.ndims = 4;
+  for (int i = 0; i < 4; ++i) {
+    hdr.dims[i] = dims[i];
+  }
+  hdr.data_size = oihw.size();
+  for (int bad = 0; bad < 2; ++bad) {
+    if (bad == 1) {
+      hdr.format = memory::format::OIhw4i16o4i;
+      hdr.ndims = 2;
+      hdr.data_size = oc * ic;
+    }
+    ASSERT_TRUE(utils::write_weights_file(file.c_str(), hdr, oihw.data()));
+    void *map = NULL;
+    size_t map_size = 0;
+    utils::weights_file_header out;
+    EXPECT_EQ(utils::map_weights_file(file.c_str(), out, map, map_size),
+              nullptr);
+    EXPECT_EQ(map, nullptr);
+    remove(file.c_str());
+  }
+}
+
+TEST(TestMemory, test_memory_pool) {
+  if (utils::memory_pool_limit() == 0) {
+    return;  // disabled
+  }
+  release_memory_pool();
+  auto base = get_memory_pool_stats();
+  memory::nchw_dims dm = {{1, 64, 28, 28}};
+  void *data = NULL;
+  {
+    std::unique_ptr<memory> mem(
+        new memory(dm, memory::format::nhwc, memory::dtype::u8));
+    data = mem->data();
+    EXPECT_EQ((size_t)data % utils::page_size, 0);
+    auto stats = get_memory_pool_stats();
+    EXPECT_EQ(stats.misses, base.misses + 1);
+    EXPECT_GE(stats.bytes_in_use, base.bytes_in_use + mem->buffer_size());
+    EXPECT_GE(stats.peak_bytes_in_use, stats.bytes_in_use);
+  }
+  auto stats = get_memory_pool_stats();
+  EXPECT_EQ(stats.bytes_in_use, base.bytes_in_use);
+  EXPECT_GT(stats.bytes_held, base.bytes_held);
+  EXPECT_LE(stats.bytes_held, utils::memory_pool_total_limit());
+
+  // reused by the same size class, which is a bit larger
+  memory::nchw_dims dm1 = {{1, 63, 28, 28}};
+  {
+    std::unique_ptr<memory> mem(
+        new memory(dm1, memory::format::nhwc, memory::dtype::u8));
+    EXPECT_EQ(mem->data(), data);
+    EXPECT_EQ(get_memory_pool_stats().hits, base.hits + 1);
+  }
+
+  // not pooled with numa policy
+  {
+    std::unique_ptr<memory> mem(new memory(dm,
+                                           memory::format::nhwc,
+                                           memory::dtype::u8,
+                                           4096,
+                                           memory::numa_local));
+    EXPECT_EQ(get_memory_pool_stats().misses, base.misses + 1);
+    EXPECT_EQ(get_memory_pool_stats().hits, base.hits + 1);
+  }
+
+  release_memory_pool();
+  EXPECT_EQ(get_memory_pool_stats().bytes_held, base.bytes_held);
+}
+
+TEST(TestMemory, test_wrap_buffer) {
+  memory::nchw_dims dm = {{2, 32, 7, 7}};
+  const size_t size = 2 * 32 * 7 * 7;
+  std::unique_ptr<f32, void (*)(void *)> buf(
+      (f32 *)utils::aligned_malloc((size + 1) * sizeof(f32), 64),
+      utils::aligned_free);
+  // aligned and unaligned
+  for (f32 *data : {buf.get(), buf.get() + 1}) {
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = i;
+    }
+    {
+      std::unique_ptr<memory> mem(new memory(
+          dm, memory::format::nhwc, memory::dtype::f32, (void *)data));
+      EXPECT_FALSE(mem->owns_data());
+      EXPECT_EQ(mem->data(), data);
+      EXPECT_EQ(mem->size(), size);
+      EXPECT_EQ(mem->std_dims(), dm);
+      EXPECT_EQ(mem->actual_dims(), memory::dims({2, 7, 7, 32}));
+    }
+    // not freed by memory
+    for (size_t i = 0; i < size; ++i) {
+      EXPECT_EQ(data[i], i);
+    }
+  }
+
+  memory::dims x_dims = {32};
+  std::unique_ptr<memory> bias(new memory(
+      x_dims, memory::format::x, memory::dtype::f32, (void *)buf.get()));
+  EXPECT_EQ(bias->size(), 32);
+  EXPECT_EQ(bias->std_dims()[0], 32);
+
+  std::unique_ptr<memory> owned(
+      new memory(dm, memory::format::nhwc, memory::dtype::f32));
+  EXPECT_TRUE(owned->owns_data());
+}
+
+}
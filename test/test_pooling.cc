@@ -0,0 +1,123 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "test_utils.h"
+
+using namespace deepfusion;
+
+using format = deepfusion::memory::format;
+
+struct test_pooling_params {
+  memory::nchw_dims src_dims;
+  int oh, ow;
+  memory::pair_dims kernel;
+  memory::pair_dims stride;
+  memory::pair_dims padding;
+};
+
+// naive pooling as MKL-DNN: avg including padding always divides by the
+// kernel size, and int results are rounded to nearest
+template <typename dtype>
+class test_pooling : public ::testing::TestWithParam<test_pooling_params> {
+protected:
+  virtual void SetUp() {
+    auto p = ::testing::TestWithParam<test_pooling_params>::GetParam();
+    const int bs = p.src_dims[0], c = p.src_dims[1];
+    const int ih = p.src_dims[2], iw = p.src_dims[3];
+    auto dt = utils::type2dtype<dtype>::dtype;
+    memory::nchw_dims dst_dims = {{bs, c, p.oh, p.ow}};
+    std::unique_ptr<memory> src, dst;
+    src.reset(new memory(p.src_dims, format::nhwc, dt));
+    dst.reset(new memory(dst_dims, format::nhwc, dt));
+    testutils::fill_data<dtype>((dtype*)src->data(), src->size());
+    const dtype* s = (const dtype*)src->data();
+
+    for (auto alg : {pooling_max,
+                     pooling_avg_include_padding,
+                     pooling_avg_exclude_padding}) {
+      auto pool = pooling(src, dst, p.kernel, p.stride, p.padding, alg);
+      pool->submit();
+
+      std::vector<dtype> ref(dst->size());
+      for (int n = 0; n < bs; ++n) {
+        for (int oh = 0; oh < p.oh; ++oh) {
+          for (int ow = 0; ow < p.ow; ++ow) {
+            int h0 = oh * p.stride[0] - p.padding[0];
+            int w0 = ow * p.stride[1] - p.padding[1];
+            int hs = std::max(h0, 0), he = std::min(h0 + p.kernel[0], ih);
+            int ws = std::max(w0, 0), we = std::min(w0 + p.kernel[1], iw);
+            for (int k = 0; k < c; ++k) {
+              dtype mx = std::numeric_limits<dtype>::lowest();
+              // sum in the order of kernel, s32 for int
+              typename std::conditional<std::is_same<dtype, f32>::value,
+                                        f32,
+                                        s32>::type sum = 0;
+              for (int y = hs; y < he; ++y) {
+                for (int x = ws; x < we; ++x) {
+                  dtype v = s[(((size_t)n * ih + y) * iw + x) * c + k];
+                  mx = std::max(mx, v);
+                  sum += v;
+                }
+              }
+              dtype out = mx;
+              if (alg != pooling_max) {
+                f32 num = alg == pooling_avg_include_padding
+                              ? p.kernel[0] * p.kernel[1]
+                              : (he - hs) * (we - ws);
+                f32 v = (f32)sum / num;
+                if (!std::is_same<dtype, f32>::value) {
+                  v = std::nearbyint(v);
+                }
+                out = (dtype)v;
+              }
+              ref[(((size_t)n * p.oh + oh) * p.ow + ow) * c + k] = out;
+            }
+          }
+        }
+      }
+      testutils::compare_array<dtype>(
+          (dtype*)dst->data(), ref.data(), dst->size());
+    }
+  }
+};
+
+// rounded down and up output sizes, the padding of the last window is larger
+// than the given one when rounded up, and global pooling of 7x7
+#define POOLING_TEST_CASES                                                 \
+  test_pooling_params{{2, 64, 8, 8}, 4, 4, {{2, 2}}, {{2, 2}}, {{0, 0}}},  \
+  test_pooling_params{{2, 32, 9, 9}, 5, 5, {{3, 3}}, {{2, 2}}, {{1, 1}}},  \
+  test_pooling_params{{1, 64, 112, 112}, 56, 56, {{3, 3}}, {{2, 2}},       \
+                      {{1, 1}}},                                           \
+  test_pooling_params{{1, 16, 10, 10}, 5, 5, {{3, 3}}, {{2, 2}}, {{0, 0}}}, \
+  test_pooling_params{{2, 48, 7, 9}, 7, 9, {{3, 3}}, {{1, 1}}, {{1, 1}}},  \
+  test_pooling_params{{1, 2048, 7, 7}, 1, 1, {{7, 7}}, {{1, 1}}, {{0, 0}}}, \
+  test_pooling_params{{3, 256, 14, 14}, 1, 1, {{14, 14}}, {{1, 1}},        \
+                      {{0, 0}}}
+
+#define test_pooling_case(dt)                                  \
+  using test_pooling_##dt = test_pooling<dt>;                  \
+  TEST_P(test_pooling_##dt, TestsPooling) {}                   \
+  INSTANTIATE_TEST_CASE_P(TestPooling,                         \
+                          test_pooling_##dt,                   \
+                          ::testing::Values(POOLING_TEST_CASES))
+
+test_pooling_case(f32);
+test_pooling_case(s32);
+test_pooling_case(s8);
+test_pooling_case(u8);
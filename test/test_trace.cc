@@ -0,0 +1,55 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "omp_thread.h"
+#include "trace.h"
+
+namespace deepfusion {
+
+TEST(TestTrace, trace) {
+  using namespace utils;
+  const char *file = "test_trace.json";
+  trace_enable(file);
+  EXPECT_TRUE(trace_enabled());
+
+  {
+    trace_scope trace("test_outer");
+    #pragma omp parallel
+    {
+      trace_scope trace("test_thread");
+    }
+  }
+  EXPECT_TRUE(trace_dump());
+
+  std::ifstream ifs(file);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  auto json = ss.str();
+  EXPECT_EQ(json.find("{\"traceEvents\":["), 0UL);
+  EXPECT_NE(json.find("\"name\":\"test_outer\",\"ph\":\"X\""), std::string::npos);
+  // one event of each omp thread
+  size_t n = 0;
+  for (size_t pos = json.find("test_thread"); pos != std::string::npos;
+       pos = json.find("test_thread", pos + 1)) {
+    ++n;
+  }
+  EXPECT_EQ(n, size_t(omp_get_max_threads()));
+  remove(file);
+}
+
+}
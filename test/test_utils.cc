@@ -20,7 +20,6 @@
 namespace deepfusion {
 namespace testutils {
 
-#ifdef WITH_COLD_CACHE
 dummy_memory::dummy_memory(size_t num_bytes) {
   int max_nthr = omp_get_max_threads();
   debug("Max OMP threads: %d", max_nthr);
@@ -41,12 +40,10 @@ void dummy_memory::clear_cache() {
 //      L2: 1MB
 //      L1: 32KB
 constexpr size_t PAGE_2MB = 2 * 1024 * 1024;
-static dummy_memory dummy_mem(PAGE_2MB);
-void clear_cache() { dummy_mem.clear_cache(); }
-#else
-// hot cache, do nothing
-void clear_cache() { ; }
-#endif
+void clear_cache() {
+  static dummy_memory dummy_mem(PAGE_2MB);
+  dummy_mem.clear_cache();
+}
 
 const char* dtype2str(memory::dtype dt) {
   using dtype = memory::dtype;
@@ -59,6 +56,8 @@ const char* dtype2str(memory::dtype dt) {
       return "s8";
     case dtype::u8:
       return "u8";
+    case dtype::bf16:
+      return "bf16";
     default:
       error_and_exit("Unknow data type");
       return NULL;
@@ -75,6 +74,8 @@ memory::dtype str2dtype(const std::string& str) {
     return dtype::s8;
   } else if (str == "u8") {
     return dtype::u8;
+  } else if (str == "bf16") {
+    return dtype::bf16;
   } else {
     error_and_exit("Unknow data type %s", str.c_str());
     return dtype::f32;
@@ -25,9 +25,10 @@
 namespace deepfusion {
 namespace testutils {
 
+// flush the cache by touching a buffer larger than cache on all threads,
+// the buffer is allocated at first call
 void clear_cache();
 
-#ifdef WITH_COLD_CACHE
 struct dummy_memory {
 public:
   void clear_cache();
@@ -39,7 +40,6 @@ private:
   size_t size_;
   DISABLE_COPY_AND_ASSIGN(dummy_memory);
 };
-#endif
 
 const char* dtype2str(memory::dtype dt);
 memory::dtype str2dtype(const std::string& str);
@@ -57,6 +57,9 @@ static inline data_t set_value(size_t index) {
     return data_t(rand() % 21 - 10);
   } else if (utils::type2dtype<data_t>::dtype == data_type::u8) {
     return data_t(rand() % 17);
+  } else if (utils::type2dtype<data_t>::dtype == data_type::bf16) {
+    // exact in bf16, and some negative for relu
+    return data_t(utils::f32_to_bf16(float(rand() % 33 - 16) / 8));
   } else {
     return data_t(0);
   }
@@ -78,6 +81,11 @@ void compare_array(T* dst, T* ref, size_t sz) {
       f32 diff = dst[i] - ref[i];
       f32 e = (std::fabs(ref[i]) > (f32)1e-4) ? diff / ref[i] : diff;
       EXPECT_NEAR(e, 0.f, (f32)1e-4) << "Index: " << i << " Total: " << sz;
+    } else if (std::is_same<T, bf16>::value) {
+      // bf16 keeps 8 bits of mantissa, the sum in f32 may round to the next
+      f32 d = utils::bf16_to_f32(dst[i]), r = utils::bf16_to_f32(ref[i]);
+      f32 e = (std::fabs(r) > (f32)1e-2) ? (d - r) / r : d - r;
+      EXPECT_NEAR(e, 0.f, (f32)1e-2) << "Index: " << i << " Total: " << sz;
     } else {
       EXPECT_EQ(dst[i], ref[i]) << "Index: " << i << " Total: " << sz;
     }
@@ -0,0 +1,76 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Pack plain s8 oihw weights to a file, which can be mapped read-only by
+// deepfusion::memory(weights_file) and shared by processes.
+// Usage: pack_weights <oihw.bin> <oc> <ic> <kh> <kw> <packed.dfw>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "deepfusion.h"
+
+int main(int argc, char **argv) {
+  using namespace deepfusion;
+  if (argc != 7) {
+    fprintf(stderr,
+            "Usage: %s <oihw.bin> <oc> <ic> <kh> <kw> <packed.dfw>\n"
+            "  oihw.bin is the raw s8 weights in oihw, oc and ic should be "
+            "multiple of 16\n",
+            argv[0]);
+    return 1;
+  }
+  memory::nchw_dims dims = {
+      {atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5])}};
+  for (int d : dims) {
+    if (d <= 0) {
+      fprintf(stderr,
+              "bad dims %d %d %d %d\n",
+              dims[0],
+              dims[1],
+              dims[2],
+              dims[3]);
+      return 1;
+    }
+  }
+  const size_t size = (size_t)dims[0] * dims[1] * dims[2] * dims[3];
+
+  FILE *fp = fopen(argv[1], "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "failed to open %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<s8> oihw(size);
+  size_t n = fread(oihw.data(), 1, size, fp);
+  // should be exactly the size of dims
+  bool bad_size = n != size || fgetc(fp) != EOF;
+  fclose(fp);
+  if (bad_size) {
+    fprintf(stderr, "size of %s is not %zu bytes\n", argv[1], size);
+    return 1;
+  }
+
+  if (!save_weights(argv[6], oihw.data(), dims)) {
+    return 1;
+  }
+  printf("packed %dx%dx%dx%d to %s\n",
+         dims[0],
+         dims[1],
+         dims[2],
+         dims[3],
+         argv[6]);
+  return 0;
+}
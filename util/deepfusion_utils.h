@@ -53,6 +53,10 @@ template <>
 struct type2dtype<s32> {
   static const auto dtype = memory::dtype::s32;
 };
+template <>
+struct type2dtype<bf16> {
+  static const auto dtype = memory::dtype::bf16;
+};
 
 // deepfusion::memory::dtype to type(float, int8...)
 template <memory::dtype>
@@ -73,10 +77,38 @@ template <>
 struct dtype2type<memory::dtype::u8> {
   typedef u8 type;
 };
+template <>
+struct dtype2type<memory::dtype::bf16> {
+  typedef bf16 type;
+};
 
 size_t dtype_size(memory::dtype dt);
 
-int conv_output_size(int image, int kernel, int stride, int padding);
+// bf16 is the upper half of f32, rounded to nearest even, as the JIT kernels
+// convert in software. NaN is kept as quiet NaN.
+inline bf16 f32_to_bf16(f32 v) {
+  uint32_t u;
+  memcpy(&u, &v, sizeof(u));
+  if ((u & 0x7fffffff) > 0x7f800000) {
+    return (bf16)((u | 0x00400000) >> 16);
+  }
+  u += 0x7fff + ((u >> 16) & 1);
+  return (bf16)(u >> 16);
+}
+
+inline f32 bf16_to_f32(bf16 v) {
+  uint32_t u = (uint32_t)v << 16;
+  f32 out;
+  memcpy(&out, &u, sizeof(out));
+  return out;
+}
+
+// dilation 1 is dense, the kernel spans (kernel - 1) * dilation + 1 pixels
+int conv_output_size(int image,
+                     int kernel,
+                     int stride,
+                     int padding,
+                     int dilation = 1);
 int pool_output_size(int image, int kernel, int stride, int padding);
 
 template <typename T>
@@ -261,11 +293,49 @@ inline double get_current_ms() {
 };
 
 int _getenv(char *value, const char *name, int length);
+int getenv_int(const char *name, int default_value);
 bool is_profiling();
 bool jit_dump_code();
+// -1: auto by dst size, 0: never, 1: always
+int streaming_store_mode();
+void set_streaming_store_mode(int mode);
 
 void *aligned_malloc(size_t size, int alignment);
 void aligned_free(void *p);
 
+const size_t huge_page_size = 2 * 1024 * 1024;
+// page mode of page_default, by env DEEPFUSION_HUGE_PAGE:
+// 0 or unset: page_small, 1: page_thp, 2: page_hugetlb
+memory::page_mode huge_page_mode();
+void set_huge_page_mode(memory::page_mode mode);
+// Allocate by the page mode, page_default is resolved by huge_page_mode(),
+// and mode is updated to the one actually used after fallback.
+// Should be freed by page_free with the same size and the updated mode.
+void *page_malloc(size_t size, int alignment, memory::page_mode &mode);
+void page_free(void *p, size_t size, memory::page_mode mode);
+// Bytes of each thread's slice of a workspace, in whole pages of the mode, so
+// no page spans two threads and each slice is first touched on the node of
+// its own thread. page_default is resolved by the slice size here.
+size_t page_slice_size(size_t bytes, memory::page_mode &mode);
+
+// bytes cached by each thread at most, 0 if the pool is disabled
+size_t memory_pool_limit();
+// bytes cached by all threads at most
+size_t memory_pool_total_limit();
+// page aligned, size is updated to the size class actually allocated
+void *pool_malloc(size_t &size);
+// size should be the size class returned by pool_malloc
+void pool_free(void *p, size_t size);
+
+const int page_size = 4096;
+// number of online numa nodes, 1 if unknown
+int numa_num_nodes();
+// set numa policy of the pages in [p, p + size), p should be page aligned,
+// the pages not faulted yet are placed by the policy when first touched
+bool numa_place(void *p, size_t size, memory::numa_policy policy, int node);
+// zero [p, p + size) by all omp threads, each on its own rows, so that
+// the pages are on the node of the thread which will use them
+void first_touch(void *p, size_t size, int rows);
+
 }
 }
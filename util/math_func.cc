@@ -19,8 +19,9 @@
 namespace deepfusion {
 namespace utils {
 
-int conv_output_size(int image, int kernel, int stride, int padding) {
-  return (image + 2 * padding - kernel) / stride + 1;
+int conv_output_size(
+    int image, int kernel, int stride, int padding, int dilation) {
+  return (image + 2 * padding - ((kernel - 1) * dilation + 1)) / stride + 1;
 }
 
 int pool_output_size(int image, int kernel, int stride, int padding) {
@@ -14,6 +14,18 @@
 * limitations under the License.
 *******************************************************************************/
 #include "deepfusion_utils.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// mempolicy modes and flags of linux/mempolicy.h, not to depend on libnuma
+#define DEEPFUSION_MPOL_PREFERRED 1
+#define DEEPFUSION_MPOL_BIND 2
+#define DEEPFUSION_MPOL_INTERLEAVE 3
+#define DEEPFUSION_MPOL_MF_MOVE (1 << 1)
 
 namespace deepfusion {
 namespace utils {
@@ -39,6 +51,153 @@ void aligned_free(void *p) {
 #endif
 }
 
+void *page_malloc(size_t size, int alignment, memory::page_mode &mode) {
+  if (mode == memory::page_default) {
+    // not worth a huge page for small buffers
+    mode = size >= huge_page_size ? huge_page_mode() : memory::page_small;
+  }
+#ifdef _WIN32
+  mode = memory::page_small;
+#else
+  if (mode == memory::page_hugetlb) {
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL,
+                   div_up(size, huge_page_size) * huge_page_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0);
+    if (p != MAP_FAILED) {
+      return p;
+    }
+#endif
+    // no huge pages reserved, see /proc/sys/vm/nr_hugepages
+    mode = memory::page_thp;
+  }
+  if (mode == memory::page_thp) {
+    size_t sz = div_up(size, huge_page_size) * huge_page_size;
+    void *p = aligned_malloc(sz, std::max(alignment, (int)huge_page_size));
+    if (p == NULL) {
+      mode = memory::page_small;
+    } else {
+#ifdef MADV_HUGEPAGE
+      // fails if THP is disabled, then it's still 2MB aligned small pages
+      madvise(p, sz, MADV_HUGEPAGE);
+#endif
+      return p;
+    }
+  }
+#endif
+  return aligned_malloc(size, alignment);
+}
+
+void page_free(void *p, size_t size, memory::page_mode mode) {
+#ifndef _WIN32
+  if (mode == memory::page_hugetlb) {
+    munmap(p, div_up(size, huge_page_size) * huge_page_size);
+    return;
+  }
+#endif
+  aligned_free(p);
+}
+
+size_t page_slice_size(size_t bytes, memory::page_mode &mode) {
+  if (mode == memory::page_default) {
+    // not worth a huge page for each thread of small slices
+    mode = bytes >= huge_page_size ? huge_page_mode() : memory::page_small;
+  }
+  const size_t page =
+      mode == memory::page_small ? (size_t)page_size : huge_page_size;
+  return div_up(bytes, page) * page;
+}
+
+int numa_num_nodes() {
+  static int nodes = []() {
+    // like "0-1" or "0,2-3", nodes are numbered from 0
+    int max_node = 0;
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    if (fp == NULL) {
+      return 1;
+    }
+    char buf[256] = {0};
+    if (fgets(buf, sizeof(buf), fp) != NULL) {
+      for (char *s = buf; *s != '\0';) {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if (end == s) {
+          ++s;
+          continue;
+        }
+        max_node = v > max_node ? (int)v : max_node;
+        s = end;
+      }
+    }
+    fclose(fp);
+    return max_node + 1;
+  }();
+  return nodes;
+}
+
+bool numa_place(void *p, size_t size, memory::numa_policy policy, int node) {
+#if defined(_WIN32) || !defined(SYS_mbind)
+  return false;
+#else
+  const int nodes = numa_num_nodes();
+  if (nodes <= 1) {
+    return true;  // nothing to place
+  }
+  const int bits = 8 * sizeof(unsigned long);
+  unsigned long mask[1024 / bits] = {0};
+  int mode;
+  switch (policy) {
+    case memory::numa_local:
+      // preferred with empty mask is the local node
+      mode = DEEPFUSION_MPOL_PREFERRED;
+      break;
+    case memory::numa_interleave:
+      mode = DEEPFUSION_MPOL_INTERLEAVE;
+      for (int i = 0; i < nodes && i < 1024; ++i) {
+        mask[i / bits] |= 1UL << (i % bits);
+      }
+      break;
+    case memory::numa_bind:
+      if (node < 0 || node >= nodes || node >= 1024) {
+        return false;
+      }
+      mode = DEEPFUSION_MPOL_BIND;
+      mask[node / bits] |= 1UL << (node % bits);
+      break;
+    default:
+      return false;
+  }
+  // move the pages already faulted as well
+  long rc = syscall(SYS_mbind,
+                    p,
+                    size,
+                    mode,
+                    mask,
+                    sizeof(mask) * 8,
+                    DEEPFUSION_MPOL_MF_MOVE);
+  return rc == 0;
+#endif
+}
+
+void first_touch(void *p, size_t size, int rows) {
+  rows = rows > 0 ? rows : 1;
+  size_t row_size = div_up(size, (size_t)rows);
+  #pragma omp parallel
+  {
+    int ithr = omp_get_thread_num(), nthr = omp_get_num_threads();
+    int start{0}, end{0};
+    balance211(rows, nthr, ithr, start, end);
+    size_t s = std::min(size, start * row_size);
+    size_t e = std::min(size, end * row_size);
+    if (e > s) {
+      memset((char *)p + s, 0, e - s);
+    }
+  }
+}
+
 size_t dtype_size(memory::dtype dt) {
   switch (dt) {
 #define CASE(tp) \
@@ -48,6 +207,7 @@ size_t dtype_size(memory::dtype dt) {
     CASE(memory::dtype::s32);
     CASE(memory::dtype::s8);
     CASE(memory::dtype::u8);
+    CASE(memory::dtype::bf16);
 #undef CASE
     default:
       assert(!"Unkown data type");
@@ -0,0 +1,153 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "deepfusion_utils.h"
+
+namespace deepfusion {
+namespace utils {
+
+static std::atomic<size_t> pool_hits(0);
+static std::atomic<size_t> pool_misses(0);
+static std::atomic<size_t> bytes_in_use(0);
+static std::atomic<size_t> peak_bytes_in_use(0);
+static std::atomic<size_t> bytes_held(0);
+
+// 4 classes in each power of 2, so at most 25% wasted
+static size_t size_class(size_t size) {
+  if (size <= (size_t)page_size) {
+    return page_size;
+  }
+  size_t base = page_size;
+  while (base * 2 < size) {
+    base *= 2;
+  }
+  size_t step = base / 4;
+  return div_up(size, step) * step;
+}
+
+// free lists of the thread, by size class
+class pool_cache {
+public:
+  ~pool_cache() { release(); }
+
+  void *get(size_t size) {
+    auto it = lists_.find(size);
+    if (it == lists_.end() || it->second.empty()) {
+      return NULL;
+    }
+    void *p = it->second.back();
+    it->second.pop_back();
+    held_ -= size;
+    bytes_held -= size;
+    return p;
+  }
+
+  bool put(void *p, size_t size) {
+    if (held_ + size > memory_pool_limit()) {
+      return false;
+    }
+    // buffers freed on other threads than allocated are never reused by
+    // the allocating one, so all threads share a total limit
+    if (bytes_held.fetch_add(size) + size > memory_pool_total_limit()) {
+      bytes_held -= size;
+      return false;
+    }
+    lists_[size].push_back(p);
+    held_ += size;
+    return true;
+  }
+
+  void release() {
+    for (auto &it : lists_) {
+      for (void *p : it.second) {
+        aligned_free(p);
+      }
+    }
+    lists_.clear();
+    bytes_held -= held_;
+    held_ = 0;
+  }
+
+private:
+  std::unordered_map<size_t, std::vector<void *>> lists_;
+  size_t held_ = 0;
+};
+
+static pool_cache &thread_pool_cache() {
+  static thread_local pool_cache cache;
+  return cache;
+}
+
+size_t memory_pool_limit() {
+  static size_t limit =
+      (size_t)std::max(getenv_int("DEEPFUSION_MEMORY_POOL_MB", 256), 0) << 20;
+  return limit;
+}
+
+size_t memory_pool_total_limit() {
+  static size_t limit =
+      (size_t)std::max(getenv_int("DEEPFUSION_MEMORY_POOL_TOTAL_MB", 1024), 0)
+      << 20;
+  return limit;
+}
+
+void *pool_malloc(size_t &size) {
+  size = size_class(size);
+  void *p = thread_pool_cache().get(size);
+  if (p != NULL) {
+    ++pool_hits;
+  } else {
+    ++pool_misses;
+    // not touched here, the pages are first touched by the threads of the
+    // ops writing them, on their own nodes
+    p = aligned_malloc(size, page_size);
+    if (p == NULL) {
+      return NULL;
+    }
+  }
+  size_t in_use = bytes_in_use += size;
+  size_t peak = peak_bytes_in_use;
+  while (in_use > peak &&
+         !peak_bytes_in_use.compare_exchange_weak(peak, in_use)) {
+  }
+  return p;
+}
+
+void pool_free(void *p, size_t size) {
+  bytes_in_use -= size;
+  if (!thread_pool_cache().put(p, size)) {
+    aligned_free(p);
+  }
+}
+
+}
+
+memory_pool_stats get_memory_pool_stats() {
+  memory_pool_stats stats;
+  stats.hits = utils::pool_hits;
+  stats.misses = utils::pool_misses;
+  stats.bytes_in_use = utils::bytes_in_use;
+  stats.peak_bytes_in_use = utils::peak_bytes_in_use;
+  stats.bytes_held = utils::bytes_held;
+  return stats;
+}
+
+void release_memory_pool() { utils::thread_pool_cache().release(); }
+
+}
@@ -0,0 +1,263 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "perf_counters.h"
+#include <cpuid.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include "deepfusion_utils.h"
+#include "log.h"
+
+namespace deepfusion {
+namespace utils {
+
+static bool is_intel_cpu() {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  // "GenuineIntel"
+  return ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e;
+}
+
+// fill type and config of the event, return false if not supported
+static bool perf_event_config(int k, perf_event_attr &attr) {
+  switch (k) {
+    case perf_counters::cycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      return true;
+    case perf_counters::instructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      return true;
+    case perf_counters::l1d_misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      return true;
+    case perf_counters::l2_misses:
+      // L2_RQSTS.MISS: event 0x24, umask 0x3f
+      attr.type = PERF_TYPE_RAW;
+      attr.config = 0x3f24;
+      return is_intel_cpu();
+    case perf_counters::llc_misses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      return true;
+    case perf_counters::fp_arith:
+      // FP_ARITH_INST_RETIRED: event 0xc7, all umasks
+      attr.type = PERF_TYPE_RAW;
+      attr.config = 0xffc7;
+      return is_intel_cpu();
+    default:
+      return false;
+  }
+}
+
+static int perf_event_open(perf_event_attr &attr) {
+  // count the calling thread on any cpu
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+perf_counters::perf_counters() {
+  const int nthr = omp_get_max_threads();
+  for (int k = 0; k < n_kinds; ++k) {
+    fds_[k].assign(nthr, -1);
+  }
+  // counters only count the thread which opens them
+  #pragma omp parallel num_threads(nthr)
+  {
+    int ithr = omp_get_thread_num();
+    for (int k = 0; k < n_kinds; ++k) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.disabled = 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      if (perf_event_config(k, attr)) {
+        fds_[k][ithr] = perf_event_open(attr);
+      }
+    }
+  }
+  // one counter is available only when it can be opened on all threads
+  for (int k = 0; k < n_kinds; ++k) {
+    for (int fd : fds_[k]) {
+      if (fd < 0) {
+        for (int f : fds_[k]) {
+          if (f >= 0) close(f);
+        }
+        fds_[k].clear();
+        debug("Perf counter %s is not available", name(k));
+        break;
+      }
+    }
+  }
+  reset();
+}
+
+perf_counters::~perf_counters() {
+  for (int k = 0; k < n_kinds; ++k) {
+    for (int fd : fds_[k]) {
+      close(fd);
+    }
+  }
+}
+
+const char *perf_counters::name(int k) {
+  static const char *names[n_kinds] = {"cycles",
+                                       "instructions",
+                                       "L1D-misses",
+                                       "L2-misses",
+                                       "LLC-misses",
+                                       "FP-arith"};
+  return k >= 0 && k < n_kinds ? names[k] : "unknown";
+}
+
+// sum of all threads, scaled if multiplexed
+uint64_t perf_counters::read_sum(int k) const {
+  uint64_t sum = 0;
+  for (int fd : fds_[k]) {
+    uint64_t data[3] = {0};  // value, time enabled, time running
+    if (read(fd, data, sizeof(data)) != sizeof(data)) {
+      continue;
+    }
+    if (data[2] > 0 && data[2] < data[1]) {
+      data[0] = (uint64_t)((double)data[0] * data[1] / data[2]);
+    }
+    sum += data[0];
+  }
+  return sum;
+}
+
+void perf_counters::start() {
+  for (int k = 0; k < n_kinds; ++k) {
+    start_[k] = available(k) ? read_sum(k) : 0;
+  }
+}
+
+void perf_counters::stop() {
+  for (int k = 0; k < n_kinds; ++k) {
+    if (available(k)) {
+      values_[k] += read_sum(k) - start_[k];
+    }
+  }
+}
+
+void perf_counters::reset() {
+  for (int k = 0; k < n_kinds; ++k) {
+    start_[k] = 0;
+    values_[k] = 0;
+  }
+}
+
+double perf_counters::ipc() const {
+  if (!available(cycles) || !available(instructions) || values_[cycles] == 0) {
+    return 0;
+  }
+  return (double)values_[instructions] / values_[cycles];
+}
+
+// counters summed by op name
+struct op_perf_stats {
+  int64_t n_submits;
+  double ms;
+  uint64_t values[perf_counters::n_kinds];
+};
+
+static std::mutex perf_mutex;
+static std::map<std::string, op_perf_stats> perf_stats;
+static perf_counters *global_counters = nullptr;
+
+static void perf_counters_print_at_exit() {
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  if (global_counters == nullptr) {
+    return;
+  }
+  for (const auto &it : perf_stats) {
+    const auto &st = it.second;
+    std::string line;
+    char buf[128];
+    for (int k = 0; k < perf_counters::n_kinds; ++k) {
+      if (!global_counters->available(k)) continue;
+      snprintf(buf, sizeof(buf), ", %s %.0f", perf_counters::name(k),
+               (double)st.values[k] / st.n_submits);
+      line += buf;
+    }
+    if (global_counters->available(perf_counters::cycles) &&
+        global_counters->available(perf_counters::instructions) &&
+        st.values[perf_counters::cycles] > 0) {
+      snprintf(buf, sizeof(buf), ", IPC %.2f",
+               (double)st.values[perf_counters::instructions] /
+                   st.values[perf_counters::cycles]);
+      line += buf;
+    }
+    info("%s: %ld submits, avg %f ms%s", it.first.c_str(), (long)st.n_submits,
+         st.ms / st.n_submits, line.c_str());
+  }
+}
+
+bool perf_counters_enabled() {
+  static bool initialized = false;
+  static bool enabled = false;
+  if (!initialized) {
+    const int len = 2;
+    char env_dump[len] = {0};
+    enabled = _getenv(env_dump, "DEEPFUSION_PERF_COUNTERS", len) == 1 &&
+              atoi(env_dump) == 1;
+    if (enabled) {
+      global_counters = new perf_counters();
+      atexit(perf_counters_print_at_exit);
+    }
+    initialized = true;
+  }
+  return enabled;
+}
+
+perf_scope::perf_scope(const char *op_name)
+    : op_name_(perf_counters_enabled() ? op_name : nullptr), t_start_(0) {
+  if (op_name_) {
+    global_counters->reset();
+    global_counters->start();
+    t_start_ = get_current_ms();
+  }
+}
+
+perf_scope::~perf_scope() {
+  if (op_name_ == nullptr) {
+    return;
+  }
+  double ms = get_current_ms() - t_start_;
+  global_counters->stop();
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  auto &st = perf_stats[op_name_];
+  st.n_submits++;
+  st.ms += ms;
+  for (int k = 0; k < perf_counters::n_kinds; ++k) {
+    st.values[k] += global_counters->value(k);
+  }
+}
+
+}
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "deepfusion.h"
+
+namespace deepfusion {
+namespace utils {
+
+// Hardware counters by Linux perf_event_open.
+// The counters are opened on every OMP thread, and summed when read.
+// Some counters may be unavailable, e.g. in VM or on non-Intel CPU.
+class perf_counters {
+public:
+  enum kind {
+    cycles = 0,
+    instructions,
+    l1d_misses,
+    l2_misses,   // Intel raw event L2_RQSTS.MISS
+    llc_misses,
+    fp_arith,    // Intel raw event FP_ARITH_INST_RETIRED, all kinds
+    n_kinds,
+  };
+
+  explicit perf_counters();
+  ~perf_counters();
+
+  static const char *name(int k);
+  bool available(int k) const { return !fds_[k].empty(); }
+  // accumulate the counts between start and stop
+  void start();
+  void stop();
+  void reset();
+  uint64_t value(int k) const { return values_[k]; }
+  double ipc() const;
+
+private:
+  uint64_t read_sum(int k) const;
+
+  std::vector<int> fds_[n_kinds];  // one fd per omp thread
+  uint64_t start_[n_kinds];
+  uint64_t values_[n_kinds];
+  DISABLE_COPY_AND_ASSIGN(perf_counters);
+};
+
+// If need hardware counters of each op
+// export DEEPFUSION_PERF_COUNTERS=1
+// then the counters are summed by op name and printed at exit.
+bool perf_counters_enabled();
+
+// count the scope by the global counters, only when enabled
+class perf_scope {
+public:
+  explicit perf_scope(const char *op_name);
+  ~perf_scope();
+
+private:
+  const char *op_name_;
+  double t_start_;
+  DISABLE_COPY_AND_ASSIGN(perf_scope);
+};
+
+}
+}
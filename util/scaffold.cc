@@ -50,6 +50,16 @@ int _getenv(char *value, const char *name, int length) {
   return result;
 }
 
+// Read an integer from env, return default_value if not set
+int getenv_int(const char *name, int default_value) {
+  const int len = 12;
+  char value[len] = {0};
+  if (_getenv(value, name, len) > 0) {
+    return atoi(value);
+  }
+  return default_value;
+}
+
 // If need profiling
 // 1. cmake -DWITH_PROFILE=ON
 // 2. export DEEPFUSION_PROFILE=1
@@ -81,5 +91,46 @@ bool jit_dump_code() {
   return dump_jit_code;
 }
 
+// Whether to use non-temporal store for op dst
+// export DEEPFUSION_STREAMING_STORE=0 to disable, =1 to always enable,
+// otherwise it's decided by the dst size, see jit::use_streaming_store
+static int streaming_store = -2;  // not initialized
+
+int streaming_store_mode() {
+  if (streaming_store == -2) {
+    const int len = 3;
+    char env_nt[len] = {0};
+    streaming_store = -1;
+    if (_getenv(env_nt, "DEEPFUSION_STREAMING_STORE", len) > 0) {
+      streaming_store = atoi(env_nt) == 1 ? 1 : atoi(env_nt) == 0 ? 0 : -1;
+    }
+  }
+  return streaming_store;
+}
+
+void set_streaming_store_mode(int mode) {
+  assert(mode == -1 || mode == 0 || mode == 1);
+  streaming_store = mode;
+}
+
+// Page mode of the buffers not given one, memory::page_default
+// export DEEPFUSION_HUGE_PAGE=1 for transparent huge pages, =2 for hugetlbfs
+static int huge_page = -1;  // not initialized
+
+memory::page_mode huge_page_mode() {
+  if (huge_page == -1) {
+    int mode = getenv_int("DEEPFUSION_HUGE_PAGE", 0);
+    huge_page = mode == 1 ? memory::page_thp
+                          : mode == 2 ? memory::page_hugetlb
+                                      : memory::page_small;
+  }
+  return (memory::page_mode)huge_page;
+}
+
+void set_huge_page_mode(memory::page_mode mode) {
+  assert(mode != memory::page_default);
+  huge_page = mode;
+}
+
 }
 }
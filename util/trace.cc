@@ -0,0 +1,147 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+#include "trace.h"
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "deepfusion_utils.h"
+#include "log.h"
+
+namespace deepfusion {
+namespace utils {
+
+struct trace_event_t {
+  const char *name;
+  int64_t begin_ns;
+  int64_t end_ns;
+};
+
+// events per thread, must be power of 2
+constexpr size_t trace_buffer_size = 1 << 16;
+
+struct trace_buffer_t {
+  trace_event_t events[trace_buffer_size];
+  std::atomic<size_t> count;  // total recorded, only written by owner thread
+  int tid;
+  trace_buffer_t *next;
+};
+
+static std::atomic<trace_buffer_t *> trace_buffers(nullptr);
+static std::atomic<int> trace_nthreads(0);
+static thread_local trace_buffer_t *trace_local_buffer = nullptr;
+static std::string trace_file;
+static std::atomic<bool> trace_on(false);  // can be flipped by trace_enable
+static const auto trace_start = std::chrono::steady_clock::now();
+
+static void trace_dump_at_exit() { trace_dump(); }
+
+// read DEEPFUSION_TRACE once
+static bool trace_init_from_env() {
+  const int len = 1024;
+  char env_file[len] = {0};
+  if (_getenv(env_file, "DEEPFUSION_TRACE", len) > 0) {
+    trace_file = env_file;
+    trace_on.store(true);
+    atexit(trace_dump_at_exit);
+  }
+  return true;
+}
+
+bool trace_enabled() {
+  // function-local static is initialized once, even if the first call is
+  // from the threads of an omp parallel region
+  static const bool initialized = trace_init_from_env();
+  (void)initialized;
+  return trace_on.load(std::memory_order_relaxed);
+}
+
+void trace_enable(const char *file) {
+  trace_enabled();  // init from env first
+  trace_file = file;
+  trace_on.store(true);
+}
+
+int64_t trace_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - trace_start)
+      .count();
+}
+
+// register a new buffer for this thread, lock free
+static trace_buffer_t *trace_new_buffer() {
+  auto buf = new trace_buffer_t;
+  buf->count.store(0, std::memory_order_relaxed);
+  buf->tid = trace_nthreads.fetch_add(1);
+  buf->next = trace_buffers.load(std::memory_order_relaxed);
+  while (!trace_buffers.compare_exchange_weak(
+      buf->next, buf, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+  return buf;
+}
+
+void trace_record(const char *name, int64_t begin_ns, int64_t end_ns) {
+  auto buf = trace_local_buffer;
+  if (buf == nullptr) {
+    buf = trace_local_buffer = trace_new_buffer();
+  }
+  size_t i = buf->count.load(std::memory_order_relaxed);
+  auto &e = buf->events[i & (trace_buffer_size - 1)];
+  e.name = name;
+  e.begin_ns = begin_ns;
+  e.end_ns = end_ns;
+  buf->count.store(i + 1, std::memory_order_release);
+}
+
+bool trace_dump() {
+  if (trace_file.empty()) {
+    return false;
+  }
+  FILE *fp = fopen(trace_file.c_str(), "w");
+  if (fp == nullptr) {
+    warning("Can not open trace file %s", trace_file.c_str());
+    return false;
+  }
+  const int pid = getpid();
+  const char *sep = "";
+  fprintf(fp, "{\"traceEvents\":[\n");
+  for (auto buf = trace_buffers.load(std::memory_order_acquire); buf;
+       buf = buf->next) {
+    fprintf(fp,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"thread %d\"}}",
+            sep, pid, buf->tid, buf->tid);
+    sep = ",\n";
+    size_t n = buf->count.load(std::memory_order_acquire);
+    size_t start = n > trace_buffer_size ? n - trace_buffer_size : 0;
+    for (size_t i = start; i < n; ++i) {
+      const auto &e = buf->events[i & (trace_buffer_size - 1)];
+      // ts and dur are in us
+      fprintf(fp,
+              "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f}",
+              sep, e.name, pid, buf->tid, e.begin_ns * 1e-3,
+              (e.end_ns - e.begin_ns) * 1e-3);
+    }
+  }
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  fclose(fp);
+  return true;
+}
+
+}
+}
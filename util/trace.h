@@ -0,0 +1,58 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include "deepfusion.h"
+
+namespace deepfusion {
+namespace utils {
+
+// Timeline tracer, which dumps Chrome trace_event JSON, can be viewed in
+// chrome://tracing. Enable it by:
+// export DEEPFUSION_TRACE=trace.json
+// then the file is written at exit.
+// Each thread records into its own ring buffer without lock, only the latest
+// records are kept when the buffer is full.
+bool trace_enabled();
+// enable tracing without env, the file is written by trace_dump()
+void trace_enable(const char *file);
+// write all recorded events to the file, should be called when no op running
+bool trace_dump();
+// name must be a string literal, as only the pointer is recorded
+void trace_record(const char *name, int64_t begin_ns, int64_t end_ns);
+int64_t trace_now_ns();
+
+// record the lifetime of the scope as one event
+class trace_scope {
+public:
+  explicit trace_scope(const char *name)
+      : name_(trace_enabled() ? name : nullptr),
+        begin_ns_(name_ ? trace_now_ns() : 0) {}
+  ~trace_scope() {
+    if (name_) {
+      trace_record(name_, begin_ns_, trace_now_ns());
+    }
+  }
+
+private:
+  const char *name_;
+  int64_t begin_ns_;
+  DISABLE_COPY_AND_ASSIGN(trace_scope);
+};
+
+}
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#include "weights_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deepfusion_utils.h"
+#include "log.h"
+
+namespace deepfusion {
+namespace utils {
+
+static const char weights_magic[8] = {'D', 'F', 'W', 'E', 'I', 'G', 'H', 'T'};
+static const int32_t weights_version = 1;
+
+void pack_OIhw4i16o4i(
+    const s8 *oihw, s8 *packed, int oc, int ic, int kh, int kw) {
+  assert(oc % 16 == 0 && ic % 16 == 0);
+  const int nb_oc = oc / 16, nb_ic = ic / 16;
+  #pragma omp parallel for collapse(2)
+  for (int ob = 0; ob < nb_oc; ++ob) {
+    for (int ib = 0; ib < nb_ic; ++ib) {
+      for (int h = 0; h < kh; ++h) {
+        for (int w = 0; w < kw; ++w) {
+          // [O/16][I/16][h][w][4i][16o][4i]
+          size_t blk = ((size_t)ob * nb_ic + ib) * kh * kw + h * kw + w;
+          s8 *out = packed + blk * 256;
+          for (int i_hi = 0; i_hi < 4; ++i_hi) {
+            for (int o_lo = 0; o_lo < 16; ++o_lo) {
+              for (int i_lo = 0; i_lo < 4; ++i_lo) {
+                int o = ob * 16 + o_lo;
+                int i = ib * 16 + i_hi * 4 + i_lo;
+                out[(i_hi * 16 + o_lo) * 4 + i_lo] =
+                    oihw[(((size_t)o * ic + i) * kh + h) * kw + w];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+bool write_weights_file(const char *path,
+                        const weights_file_header &header,
+                        const void *data) {
+  weights_file_header hdr = header;
+  memcpy(hdr.magic, weights_magic, sizeof(hdr.magic));
+  hdr.version = weights_version;
+  hdr.data_offset = div_up(sizeof(hdr), (size_t)page_size) * page_size;
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    warning("failed to open %s", path);
+    return false;
+  }
+  std::vector<char> pad(hdr.data_offset - sizeof(hdr), 0);
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+            fwrite(pad.data(), 1, pad.size(), fp) == pad.size() &&
+            fwrite(data, 1, hdr.data_size, fp) == hdr.data_size;
+  ok = fclose(fp) == 0 && ok;
+  if (!ok) {
+    warning("failed to write %s", path);
+  }
+  return ok;
+}
+
+const void *map_weights_file(const char *path,
+                             weights_file_header &header,
+                             void *&map,
+                             size_t &map_size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    warning("failed to open %s", path);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header)) {
+    close(fd);
+    warning("bad weights file %s", path);
+    return NULL;
+  }
+  map_size = st.st_size;
+  // shared, so all processes mapping it use the same pages of page cache
+  map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    map = NULL;
+    warning("failed to map %s", path);
+    return NULL;
+  }
+  memcpy(&header, map, sizeof(header));
+  // only the s8 OIhw4i16o4i conv weights written by save_weights
+  bool dims_ok = header.format == memory::format::OIhw4i16o4i &&
+                 header.dtype == memory::dtype::s8 && header.ndims == 4 &&
+                 header.dims[0] > 0 && header.dims[0] % 16 == 0 &&
+                 header.dims[1] > 0 && header.dims[1] % 16 == 0 &&
+                 header.dims[2] > 0 && header.dims[3] > 0;
+  size_t elems = dims_ok ? array_product<int32_t>(header.dims, 4) : 0;
+  if (memcmp(header.magic, weights_magic, sizeof(header.magic)) != 0 ||
+      header.version != weights_version || elems == 0 ||
+      header.data_size != elems * dtype_size((memory::dtype)header.dtype) ||
+      header.data_offset % page_size != 0 ||
+      header.data_offset + header.data_size > map_size) {
+    munmap(map, map_size);
+    map = NULL;
+    warning("bad weights file %s", path);
+    return NULL;
+  }
+  return (const char *)map + header.data_offset;
+}
+
+void unmap_weights_file(void *map, size_t map_size) { munmap(map, map_size); }
+
+}
+}
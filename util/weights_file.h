@@ -0,0 +1,55 @@
+/*******************************************************************************
+* Copyright 2017-2018 Intel Corporation
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "deepfusion.h"
+
+namespace deepfusion {
+namespace utils {
+
+// Packed weights file, which is mapped read-only and shared by processes:
+// header, then the data at data_offset, which is page aligned.
+struct weights_file_header {
+  char magic[8];  // "DFWEIGHT"
+  int32_t version;
+  int32_t format;  // memory::format
+  int32_t dtype;   // memory::dtype
+  int32_t ndims;
+  int32_t dims[4];  // actual dims
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+// s8 oihw to OIhw4i16o4i, oc and ic should be multiple of 16
+void pack_OIhw4i16o4i(
+    const s8 *oihw, s8 *packed, int oc, int ic, int kh, int kw);
+
+bool write_weights_file(const char *path,
+                        const weights_file_header &header,
+                        const void *data);
+
+// Map the whole file read-only, return the data and its header,
+// or NULL if the file is bad. Unmap by unmap_weights_file(map, map_size).
+const void *map_weights_file(const char *path,
+                             weights_file_header &header,
+                             void *&map,
+                             size_t &map_size);
+void unmap_weights_file(void *map, size_t map_size);
+
+}
+}